@@ -39,9 +39,15 @@
 #define BRANCH_COLOR QColor(00, 0, 255)
 #define FAST_MOVE_STEPS 10
 #define AUTO_REPLAY_INTERVAL 1300
+#define BOARD_SNAPSHOT_INTERVAL 32
+#define BOARD_SNAPSHOT_MEMORY (8 * 1024 * 1024)
 #define SAVE_NAME "%DT%_%PB%_%PW%"
+#define PARSE_GAMES_AT_ONCE 64
+#define SNAPSHOT_CACHE_FILES 32
 
 
+// declarations of gui application, console tools use definitions above only.
+#ifdef QT_GUI_LIB
 #include <QFileDialog>
 #include <QMap>
 #include "godata.h"
@@ -51,6 +57,7 @@ int replaceSgfProperty(const go::data* data, const QString& in, QString& out, QM
 
 extern QList<QAction*> codecActions;
 extern QList<const char*> codecNames;
+#endif
 
 
 #if defined(Q_WS_WIN)
@@ -0,0 +1,17 @@
+# -------------------------------------------------
+# benchmark of sgf lexer on long comments.
+# build with DEFINES+=SGF_NO_AVX2 or DEFINES+=SGF_NO_SIMD to compare with sse2 or scalar scan.
+# -------------------------------------------------
+TARGET = lexer
+TEMPLATE = app
+QT -= gui
+CONFIG += console
+mac:CONFIG -= app_bundle
+INCLUDEPATH += ../..
+SOURCES += main.cpp \
+    ../../godata.cpp \
+    ../../sgf.cpp \
+    ../../ugf.cpp \
+    ../../gib.cpp \
+    ../../ngf.cpp \
+    ../../readers.cpp
@@ -0,0 +1,150 @@
+/*
+    mugo, sgf editor.
+    Copyright (C) 2009-2010 nsase.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <stdio.h>
+#include <QCoreApplication>
+#include <QStringList>
+#include <QFile>
+#include <QTemporaryFile>
+#include <QTextCodec>
+#include <QTime>
+#include "sgf.h"
+
+/**
+* benchmark of sgf lexer on commentary collection.
+* reads sgf files of arguments, or generated 50 MB collection if there is no argument,
+* and reports time to index games and to parse all of them.
+*
+* scan of values and branches is chosen at build time and by cpu.
+* build with DEFINES+=SGF_NO_AVX2 for sse2, or DEFINES+=SGF_NO_SIMD for scalar loop.
+* node and comment counts must be same in all builds.
+*/
+
+static const int generatedSize  = 50 * 1024 * 1024;
+static const int generatedMoves = 200;
+
+/**
+* write collection of games which have long comment in every move.
+*/
+static bool generate(QFile& file){
+    static const char* const words[] = {
+        "black ", "white ", "should ", "play ", "here ", "to ", "attack ", "the ", "group ",
+        "(joseki) ", "[3-3] ", "invasion ", "is ", "possible\\] ", "\n"
+    };
+    static const int N = sizeof(words) / sizeof(words[0]);
+
+    qsrand(1);
+    int written = 0;
+    while (written < generatedSize){
+        QByteArray s("(;GM[1]FF[4]CA[UTF-8]SZ[19]PB[black]PW[white]");
+        for (int m=0; m<generatedMoves; ++m){
+            s += m % 2 ? ";W[" : ";B[";
+            s += char('a' + qrand() % 19);
+            s += char('a' + qrand() % 19);
+            s += "]C[";
+            int length = 200 + qrand() % 1000;
+            while (length > 0){
+                const char* w = words[qrand() % N];
+                s += w;
+                length -= qstrlen(w);
+            }
+            s += ']';
+            if (m % 50 == 49)
+                s += "(;B[aa]C[variation])";
+        }
+        s += ")\n";
+        if (file.write(s) != s.size())
+            return false;
+        written += s.size();
+    }
+    return file.flush();
+}
+
+/**
+* count nodes and length of comments without recursion.
+*/
+static int countNodes(const go::nodePtr& root, qint64& comments){
+    int count = 0;
+    go::nodeList stack;
+    stack.push_back(root);
+    while (!stack.empty()){
+        go::nodePtr node = stack.back();
+        stack.pop_back();
+        ++count;
+        comments += node->comment().size();
+        foreach(const go::nodePtr& child, node->childNodes())
+            stack.push_back(child);
+    }
+    return count;
+}
+
+static bool bench(const QString& fname){
+    QTextCodec* codec = QTextCodec::codecForName("UTF-8");
+
+    QTime time;
+    time.start();
+    go::sgf sgf;
+    if (!sgf.read(fname, codec, false))
+        return false;
+    go::data data;
+    sgf.get(data);
+    int indexTime = time.elapsed();
+
+    time.restart();
+    foreach(const go::informationPtr& info, data.rootList)
+        info->load();
+    int parseTime = time.elapsed();
+
+    int nodes = 0;
+    qint64 comments = 0;
+    foreach(const go::informationPtr& info, data.rootList)
+        nodes += countNodes(info, comments);
+
+    qint64 size = QFile(fname).size();
+    printf("%s\n", fname.toLocal8Bit().constData());
+    printf("  size %lld bytes, games %d, nodes %d, comments %lld characters\n", size, data.rootList.size(), nodes, comments);
+    printf("  index %d ms, parse %d ms", indexTime, parseTime);
+    if (indexTime + parseTime > 0)
+        printf(", %.1f MB/s", size / 1048576.0 * 1000.0 / (indexTime + parseTime));
+    printf("\n");
+    return true;
+}
+
+int main(int argc, char *argv[]){
+    QCoreApplication a(argc, argv);
+
+    QStringList args = a.arguments();
+    args.removeFirst();
+
+    QTemporaryFile file;
+    if (args.empty()){
+        if (!file.open() || !generate(file)){
+            fprintf(stderr, "can't create test file.\n");
+            return 1;
+        }
+        args.push_back(file.fileName());
+    }
+
+    foreach(const QString& fname, args){
+        if (!bench(fname)){
+            fprintf(stderr, "can't read %s\n", fname.toLocal8Bit().constData());
+            return 1;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,159 @@
+/*
+    mugo, sgf editor.
+    Copyright (C) 2009-2010 nsase.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <stdio.h>
+#include <QCoreApplication>
+#include <QStringList>
+#include <QFile>
+#include <QTemporaryFile>
+#include <QTextCodec>
+#include <QTime>
+#include "sgf.h"
+
+/**
+* benchmark of game tree memory and speed.
+* reads sgf files of arguments, or generated collection if there is no argument,
+* and reports time to read, load and walk all nodes, and memory used by them.
+*
+* to compare with other revision, build this directory in a checkout of it.
+* define MUGO_NO_LAZY_LOAD for revisions which parse all games in read,
+* and MUGO_NO_PROPERTY_TABLE for revisions which keep all properties in node.
+*/
+
+static const int generatedGames = 1000;
+static const int generatedMoves = 250;
+
+/**
+* resident memory of process in KB, -1 if it is unknown.
+*/
+static long residentMemory(){
+    FILE* fp = fopen("/proc/self/statm", "r");
+    if (fp == NULL)
+        return -1;
+
+    long size = 0, resident = 0;
+    int n = fscanf(fp, "%ld %ld", &size, &resident);
+    fclose(fp);
+    return n == 2 ? resident * 4 : -1;
+}
+
+/**
+* write collection of random games, with comment every 20 moves and setup stones in root.
+*/
+static bool generate(QFile& file){
+    qsrand(1);
+    for (int g=0; g<generatedGames; ++g){
+        QByteArray s("(;GM[1]FF[4]CA[UTF-8]SZ[19]PB[black]PW[white]AB[dd][pp]");
+        for (int m=0; m<generatedMoves; ++m){
+            s += m % 2 ? ";W[" : ";B[";
+            s += char('a' + qrand() % 19);
+            s += char('a' + qrand() % 19);
+            s += ']';
+            if (m % 20 == 0)
+                s += "C[comment]";
+        }
+        s += ")\n";
+        if (file.write(s) != s.size())
+            return false;
+    }
+    return file.flush();
+}
+
+/**
+* count nodes of game without recursion.
+*/
+static int countNodes(const go::nodePtr& root, int& sum, int& properties){
+    int count = 0;
+    go::nodeList stack;
+    stack.push_back(root);
+    while (!stack.empty()){
+        go::nodePtr node = stack.back();
+        stack.pop_back();
+        ++count;
+        sum += node->getX();
+#ifndef MUGO_NO_PROPERTY_TABLE
+        if (node->hasProperty())
+            ++properties;
+#endif
+        foreach(const go::nodePtr& child, node->childNodes())
+            stack.push_back(child);
+    }
+    return count;
+}
+
+static bool bench(const QString& fname){
+    QTextCodec* codec = QTextCodec::codecForName("UTF-8");
+    long memory = residentMemory();
+
+    QTime time;
+    time.start();
+    go::sgf sgf;
+    if (!sgf.read(fname, codec, true))
+        return false;
+    go::data data;
+    sgf.get(data);
+    int readTime = time.elapsed();
+
+    time.restart();
+#ifndef MUGO_NO_LAZY_LOAD
+    foreach(const go::informationPtr& info, data.rootList)
+        info->load();
+#endif
+    int loadTime = time.elapsed();
+    long loadedMemory = residentMemory();
+
+    time.restart();
+    int nodes = 0, sum = 0, properties = 0;
+    foreach(const go::informationPtr& info, data.rootList)
+        nodes += countNodes(info, sum, properties);
+    int walkTime = time.elapsed();
+
+    printf("%s\n", fname.toLocal8Bit().constData());
+    printf("  games %d, nodes %d, sizeof(go::node) %d\n", data.rootList.size(), nodes, int(sizeof(go::node)));
+#ifndef MUGO_NO_PROPERTY_TABLE
+    printf("  nodes with property table %d, sizeof(go::nodeProperty) %d\n", properties, int(sizeof(go::nodeProperty)));
+#endif
+    printf("  read %d ms, load %d ms, walk %d ms\n", readTime, loadTime, walkTime);
+    if (memory >= 0 && loadedMemory >= 0 && nodes > 0)
+        printf("  memory %ld KB, %.1f bytes per node\n", loadedMemory - memory, (loadedMemory - memory) * 1024.0 / nodes);
+    return sum != -1;
+}
+
+int main(int argc, char *argv[]){
+    QCoreApplication a(argc, argv);
+
+    QStringList args = a.arguments();
+    args.removeFirst();
+
+    QTemporaryFile file;
+    if (args.empty()){
+        if (!file.open() || !generate(file)){
+            fprintf(stderr, "can't create test file.\n");
+            return 1;
+        }
+        args.push_back(file.fileName());
+    }
+
+    foreach(const QString& fname, args){
+        if (!bench(fname)){
+            fprintf(stderr, "can't read %s\n", fname.toLocal8Bit().constData());
+            return 1;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,16 @@
+# -------------------------------------------------
+# benchmark of game tree memory and speed.
+# -------------------------------------------------
+TARGET = nodes
+TEMPLATE = app
+QT -= gui
+CONFIG += console
+mac:CONFIG -= app_bundle
+INCLUDEPATH += ../..
+SOURCES += main.cpp \
+    ../../godata.cpp \
+    ../../sgf.cpp \
+    ../../ugf.cpp \
+    ../../gib.cpp \
+    ../../ngf.cpp \
+    ../../readers.cpp
@@ -0,0 +1,254 @@
+/*
+    mugo, sgf editor.
+    Copyright (C) 2009-2010 nsase.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "bitboard.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define BITBOARD_SSE2
+#endif
+
+namespace go{
+
+
+namespace{
+
+/**
+* kernels on lanes words of plane.
+* shifts move bits in each word, and bits crossing words are taken from
+* vector loaded one word before or after.
+*/
+#if defined(__AVX2__)
+enum{ lanes = 4 };
+typedef __m256i vector;
+inline vector load(const quint64* p){ return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+inline void store(quint64* p, vector v){ _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v); }
+inline vector zero(){ return _mm256_setzero_si256(); }
+inline vector vand(vector a, vector b){ return _mm256_and_si256(a, b); }
+inline vector vor(vector a, vector b){ return _mm256_or_si256(a, b); }
+inline vector vxor(vector a, vector b){ return _mm256_xor_si256(a, b); }
+inline vector vandNot(vector a, vector b){ return _mm256_andnot_si256(b, a); }
+inline vector shiftLeft(vector a, int n){ return _mm256_slli_epi64(a, n); }
+inline vector shiftRight(vector a, int n){ return _mm256_srli_epi64(a, n); }
+inline bool isZero(vector a){ return _mm256_testz_si256(a, a) != 0; }
+#elif defined(BITBOARD_SSE2)
+enum{ lanes = 2 };
+typedef __m128i vector;
+inline vector load(const quint64* p){ return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); }
+inline void store(quint64* p, vector v){ _mm_storeu_si128(reinterpret_cast<__m128i*>(p), v); }
+inline vector zero(){ return _mm_setzero_si128(); }
+inline vector vand(vector a, vector b){ return _mm_and_si128(a, b); }
+inline vector vor(vector a, vector b){ return _mm_or_si128(a, b); }
+inline vector vxor(vector a, vector b){ return _mm_xor_si128(a, b); }
+inline vector vandNot(vector a, vector b){ return _mm_andnot_si128(b, a); }
+inline vector shiftLeft(vector a, int n){ return _mm_slli_epi64(a, n); }
+inline vector shiftRight(vector a, int n){ return _mm_srli_epi64(a, n); }
+inline bool isZero(vector a){ return _mm_movemask_epi8( _mm_cmpeq_epi8(a, _mm_setzero_si128()) ) == 0xffff; }
+#else
+enum{ lanes = 1 };
+typedef quint64 vector;
+inline vector load(const quint64* p){ return *p; }
+inline void store(quint64* p, vector v){ *p = v; }
+inline vector zero(){ return 0; }
+inline vector vand(vector a, vector b){ return a & b; }
+inline vector vor(vector a, vector b){ return a | b; }
+inline vector vxor(vector a, vector b){ return a ^ b; }
+inline vector vandNot(vector a, vector b){ return a & ~b; }
+inline vector shiftLeft(vector a, int n){ return a << n; }
+inline vector shiftRight(vector a, int n){ return a >> n; }
+inline bool isZero(vector a){ return a == 0; }
+#endif
+
+/**
+* points of words i to i + lanes - 1 of plane and their neighbors.
+*/
+inline vector neighbors(const quint64* bits, int i){
+    vector prev = load(bits + i - 1);
+    vector cur  = load(bits + i);
+    vector next = load(bits + i + 1);
+    return vor( vor( vor(cur, shiftLeft(cur, 1)), vor(shiftRight(prev, 63), shiftRight(cur, 1)) ),
+                vor( vor(shiftLeft(next, 63), shiftLeft(cur, bitboard::stride)),
+                     vor( vor(shiftRight(prev, 64 - bitboard::stride), shiftRight(cur, bitboard::stride)), shiftLeft(next, 64 - bitboard::stride) ) ) );
+}
+
+}
+
+
+/**
+*/
+void bitboard::clear(){
+    for (int i=0; i<words+2; ++i)
+        bits[i] = 0;
+}
+
+/**
+* all points of board of xsize x ysize.
+*/
+void bitboard::setBoard(int xsize, int ysize){
+    clear();
+    for (int y=0; y<ysize; ++y)
+        for (int x=0; x<xsize; ++x)
+            set(x, y);
+}
+
+/**
+*/
+bool bitboard::any() const{
+    vector r = zero();
+    for (int i=1; i<=words; i+=lanes)
+        r = vor(r, load(bits + i));
+    return !isZero(r);
+}
+
+/**
+*/
+int bitboard::count() const{
+    int n = 0;
+    for (int i=1; i<=words; ++i){
+        quint64 w = bits[i];
+        w = w - ((w >> 1) & Q_UINT64_C(0x5555555555555555));
+        w = (w & Q_UINT64_C(0x3333333333333333)) + ((w >> 2) & Q_UINT64_C(0x3333333333333333));
+        w = (w + (w >> 4)) & Q_UINT64_C(0x0f0f0f0f0f0f0f0f);
+        n += int((w * Q_UINT64_C(0x0101010101010101)) >> 56);
+    }
+    return n;
+}
+
+/**
+* coordinates of first point of this plane. returns false if plane is empty.
+*/
+bool bitboard::first(int& x, int& y) const{
+    for (int i=1; i<=words; ++i){
+        quint64 w = bits[i];
+        if (w == 0)
+            continue;
+
+        int b = 0;
+        while ((w & 1) == 0){
+            w >>= 1;
+            ++b;
+        }
+        int p = (i - 1) * 64 + b;
+        x = p % stride;
+        y = p / stride;
+        return true;
+    }
+    return false;
+}
+
+/**
+* plane which has first point of this plane only.
+*/
+bitboard bitboard::lowest() const{
+    bitboard r;
+    for (int i=1; i<=words; ++i){
+        if (bits[i]){
+            r.bits[i] = bits[i] & (~bits[i] + 1);
+            break;
+        }
+    }
+    return r;
+}
+
+/**
+* points and their neighbors.
+* result has points out of board, so it should be masked by other plane.
+*/
+bitboard bitboard::neighbors() const{
+    bitboard r;
+    for (int i=1; i<=words; i+=lanes)
+        store(r.bits + i, go::neighbors(bits, i));
+    return r;
+}
+
+/**
+* points of mask which are points of this plane or their neighbors.
+*/
+bitboard bitboard::neighbors(const bitboard& mask) const{
+    bitboard r;
+    for (int i=1; i<=words; i+=lanes)
+        store(r.bits + i, vand(go::neighbors(bits, i), load(mask.bits + i)));
+    return r;
+}
+
+/**
+* points of mask connected to points of this plane.
+* each step grows points to their neighbors in mask in place, so points
+* grown in lower words are grown again in same step.
+*/
+bitboard bitboard::fill(const bitboard& mask) const{
+    bitboard r = *this & mask;
+
+    // words out of mask stay 0, and only words of rows of mask are grown.
+    int begin = 1, end = words + 1;
+    while (begin < end && mask.bits[begin] == 0)
+        ++begin;
+    while (end > begin && mask.bits[end - 1] == 0)
+        --end;
+    begin = (begin - 1) / lanes * lanes + 1;
+
+    for (;;){
+        vector changed = zero();
+        for (int i=begin; i<end; i+=lanes){
+            vector cur = load(r.bits + i);
+            vector grown = vand(go::neighbors(r.bits, i), load(mask.bits + i));
+            changed = vor(changed, vxor(grown, cur));
+            store(r.bits + i, grown);
+        }
+        if (isZero(changed))
+            return r;
+    }
+}
+
+/**
+*/
+bitboard bitboard::andNot(const bitboard& b) const{
+    bitboard r;
+    for (int i=1; i<=words; i+=lanes)
+        store(r.bits + i, vandNot(load(bits + i), load(b.bits + i)));
+    return r;
+}
+
+/**
+*/
+bitboard& bitboard::operator &=(const bitboard& b){
+    for (int i=1; i<=words; i+=lanes)
+        store(bits + i, vand(load(bits + i), load(b.bits + i)));
+    return *this;
+}
+
+/**
+*/
+bitboard& bitboard::operator |=(const bitboard& b){
+    for (int i=1; i<=words; i+=lanes)
+        store(bits + i, vor(load(bits + i), load(b.bits + i)));
+    return *this;
+}
+
+/**
+*/
+bool bitboard::operator ==(const bitboard& b) const{
+    vector r = zero();
+    for (int i=1; i<=words; i+=lanes)
+        r = vor(r, vxor(load(bits + i), load(b.bits + i)));
+    return isZero(r);
+}
+
+
+}
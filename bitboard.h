@@ -0,0 +1,72 @@
+/*
+    mugo, sgf editor.
+    Copyright (C) 2009-2010 nsase.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __bitboard_h__
+#define __bitboard_h__
+
+#include <QtGlobal>
+
+namespace go{
+
+
+/**
+* bit plane of board up to 52x52, the largest board of sgf.
+* each row has one more bit which is always 0, so points shifted to
+* their neighbors don't wrap around to next row. operations are kernels
+* of shifts, ands and ors on 2 or 4 words at once with sse2 or avx2.
+* go::position keeps stones of each color on planes to find chains,
+* liberties and captures, and final score finds territories on them.
+*/
+class bitboard{
+public:
+    enum{ maxSize = 52, stride = maxSize + 1, words = ((stride * maxSize + 63) / 64 + 3) / 4 * 4 };
+
+    bitboard(){ clear(); }
+
+    static bool fits(int xsize, int ysize){ return xsize <= maxSize && ysize <= maxSize; }
+
+    void clear();
+    void set(int x, int y){ int i = y * stride + x; bits[1 + (i >> 6)] |= quint64(1) << (i & 63); }
+    void reset(int x, int y){ int i = y * stride + x; bits[1 + (i >> 6)] &= ~(quint64(1) << (i & 63)); }
+    bool test(int x, int y) const{ int i = y * stride + x; return (bits[1 + (i >> 6)] >> (i & 63)) & 1; }
+    void setBoard(int xsize, int ysize);
+
+    bool any() const;
+    int count() const;
+    bool first(int& x, int& y) const;
+    bitboard lowest() const;
+    bitboard neighbors() const;
+    bitboard neighbors(const bitboard& mask) const;
+    bitboard fill(const bitboard& mask) const;
+    bitboard andNot(const bitboard& b) const;
+
+    bitboard& operator &=(const bitboard& b);
+    bitboard& operator |=(const bitboard& b);
+    bitboard operator &(const bitboard& b) const{ bitboard r(*this); return r &= b; }
+    bitboard operator |(const bitboard& b) const{ bitboard r(*this); return r |= b; }
+    bool operator ==(const bitboard& b) const;
+    bool operator !=(const bitboard& b) const{ return !(*this == b); }
+
+private:
+    // plane is bits[1] to bits[words], and words on both sides are always 0
+    // so that kernel of neighbors reads words next to each word without checks.
+    quint64 bits[words + 2];
+};
+
+}
+
+#endif
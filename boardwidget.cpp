@@ -137,6 +137,8 @@ BoardWidget::BoardWidget(QWidget *parent) :
     m_ui(new Ui::BoardWidget),
 //    readOnly(false),
     dirty(false),
+    edits(0),
+    journal_(goData),
     capturedBlack(0),
     capturedWhite(0),
     color(go::black),
@@ -156,6 +158,9 @@ BoardWidget::BoardWidget(QWidget *parent) :
     flipBoardVertically_(false),
     playSound(false),
     moveNumberMode(eSequential),
+    recording(NULL),
+    snapshots(BOARD_SNAPSHOT_MEMORY),
+    stackBase(0),
     stoneSound(this),
     playGame(NULL)
 {
@@ -168,6 +173,7 @@ BoardWidget::BoardWidget(QWidget *parent) :
 
     readSettings();
 
+    ++goData.root->pinned;
     setCurrentNode(goData.root);
 }
 
@@ -176,6 +182,9 @@ BoardWidget::BoardWidget(QWidget *parent) :
 */
 BoardWidget::~BoardWidget()
 {
+    // commands release removed nodes to arena of game, which must be still loaded.
+    undoStack.clear();
+    --goData.root->pinned;
     delete m_ui;
 }
 
@@ -324,8 +333,8 @@ void BoardWidget::onLButtonDown(QMouseEvent* e){
         }
     }
     else if (editMode == eAlternateMove){
-        if (moveToClicked && board[boardY][boardX].node)
-            setCurrentNode( board[boardY][boardX].node );
+        if (moveToClicked && board[boardY][boardX].hasNode())
+            setCurrentNode( go::nodePtr( goData.root->arena()->at(board[boardY][boardX].nodeIndex()) ) );
         else
             addStoneNodeCommand(sgfX, sgfY);
     }
@@ -539,11 +548,8 @@ void BoardWidget::print(QPrinter* printer){
 
     QPainter p(printer);
     for (int i=0; i<printer->numCopies(); ++i){
-        board.clear();
-        board.resize(ysize);
-        for(int i=0; i<ysize; ++i)
-            board[i].resize(xsize);
-        BoardBuffer buf = board;
+        resetBoardBuffer();
+        BoardBuffer buf;
 
         print( *printer, p, buf );
     }
@@ -619,22 +625,18 @@ void BoardWidget::printNodeList(QPrinter& printer, QPainter& p, const go::nodeLi
 void BoardWidget::printBranch(QPrinter& printer, QPainter& p, go::nodePtr node, int& page, int& fig, int& startNumber, int& endNumber, int& moveNumberInPage, BoardBuffer& buf, QString& rangai, QStringList& comments){
     printNode(printer, p, node, page, endNumber, moveNumberInPage, buf, rangai, comments);
 
-    go::nodeList::iterator iter = node->childNodes.begin();
-    if (iter == node->childNodes.end())
+    go::childList::iterator iter = node->childNodes().begin();
+    if (iter == node->childNodes().end())
         return;
 
-    bool craeteNewPage = node->childNodes.size() > 1 || (printType == 4 && moveNumberInPage == printMovesPerPage);
-    BoardBuffer board2, buf2;
-    if ( craeteNewPage ){
-        board2 = board;
-        buf2   = buf;
-    }
+    bool craeteNewPage = node->childNodes().size() > 1 || (printType == 4 && moveNumberInPage == printMovesPerPage);
+    int stackSize = moveStack.size();
 
     int startNumber2 = startNumber;
     int endNumber2   = endNumber;
     int moveNumberInPage2 = moveNumberInPage;
 
-    while (++iter != node->childNodes.end()){
+    while (++iter != node->childNodes().end()){
         printRangai(printer, p, page, fig, startNumber, endNumber, moveNumberInPage, rangai, comments);
 
         startNumber = 1;
@@ -645,8 +647,9 @@ void BoardWidget::printBranch(QPrinter& printer, QPainter& p, go::nodePtr node,
         printBoard(printer, p, buf, page, fig);
         printBranch(printer, p, *iter, page, fig, startNumber, endNumber, moveNumberInPage, buf, rangai, comments);
 
-        board = board2;
-        buf   = buf2;
+        // take stones of variation back, buf is drawn again from board by next page.
+        while (moveStack.size() > stackSize)
+            popMove();
     }
 
     if ( craeteNewPage ){
@@ -660,7 +663,7 @@ void BoardWidget::printBranch(QPrinter& printer, QPainter& p, go::nodePtr node,
     endNumber   = endNumber2;
     moveNumberInPage = moveNumberInPage2;
 
-    iter = node->childNodes.begin();
+    iter = node->childNodes().begin();
     printBranch(printer, p, *iter, page, fig, startNumber, endNumber, moveNumberInPage, buf, rangai, comments);
 }
 
@@ -672,11 +675,22 @@ void BoardWidget::printNode(QPrinter& printer, QPainter& p, go::nodePtr node, in
         ++moveNumber;
         ++moveNumberInPage;
 
+        // points changed by stone are recorded, so that variations are taken back by popMove.
+        moveStack.push_back(moveInfo());
+        recording = &moveStack.back();
+        recording->node = node;
+        recording->color = color;
+        recording->moveNumber = currentMoveNumber;
+        recording->capturedBlack = capturedBlack;
+        recording->capturedWhite = capturedWhite;
+
         int bx, by;
-        sgfToBoardCoordinate(node->position.x, node->position.y, bx, by);
+        sgfToBoardCoordinate(node->getX(), node->getY(), bx, by);
+        saveCell(bx, by);
         board[by][bx].color  = node->color;
         board[by][bx].number = moveNumber;
         removeDeadStones(bx, by);
+        recording = NULL;
 
         if (buf[by][bx].empty()){
             drawStone(p, bx, by, node->color);
@@ -705,8 +719,8 @@ void BoardWidget::printNode(QPrinter& printer, QPainter& p, go::nodePtr node, in
         }
     }
 
-    if (printIncludeComments && node->comment.isEmpty() == false)
-        comments.push_back( tr("Move %1: " ).arg(moveNumber).append(node->comment) );
+    if (printIncludeComments && node->comment().isEmpty() == false)
+        comments.push_back( tr("Move %1: " ).arg(moveNumber).append(node->comment()) );
 
     p.restore();
 }
@@ -880,8 +894,8 @@ void BoardWidget::printBoard(QPrinter& printer, QPainter& p, BoardBuffer& buf, i
     drawBoard(p, 14.0, printShowCoordinate);
 
     buf = board;
-    for (int y=0; y<board.size(); ++y){
-        for (int x=0; x<board[y].size(); ++x){
+    for (int y=0; y<board.ysize(); ++y){
+        for (int x=0; x<board.xsize(); ++x){
             if (board[y][x].black())
                 drawStone(p, x, y, go::black);
             else if (board[y][x].white())
@@ -925,6 +939,18 @@ void BoardWidget::setPrintOption(int type, int movesPerPage, bool showCoordinate
     footerRightFormat    = footerRightFormat_;
 }
 
+/**
+* set dirty flag.
+* every modification is made to current game, so it is marked as modified too.
+*/
+void BoardWidget::setDirty(bool dirty){
+    this->dirty = dirty;
+    if (dirty)
+        ++edits;
+    if (dirty && goData.root)
+        goData.root->dirty = true;
+}
+
 /**
 */
 void BoardWidget::clear(){
@@ -932,15 +958,18 @@ void BoardWidget::clear(){
     int ysize = goData.root->ysize;
 
     setDirty(false);
+    undoStack.clear();
+    --goData.root->pinned;
     goData.clear();
+    ++goData.root->pinned;
     goData.root->xsize = xsize;
     goData.root->ysize = ysize;
     nodeList.clear();
+    boardRoot.reset();
     capturedBlack = 0;
     capturedWhite = 0;
     setCurrentNode();
     paintBoard();
-    undoStack.clear();
 
     emit cleared();
 }
@@ -954,8 +983,17 @@ void BoardWidget::getData(go::fileBase& data){
 /**
 */
 void BoardWidget::setData(const go::fileBase& data){
+    go::data d;
+    data.get(d);
+    setData(d);
+}
+
+void BoardWidget::setData(const go::data& data){
     clear();
-    data.get(goData);
+    --goData.root->pinned;
+    goData = data;
+    goData.root->load();
+    ++goData.root->pinned;
     createBoardBuffer();
     paintBoard();
     nodeList.clear();
@@ -977,7 +1015,7 @@ void BoardWidget::insertData(const go::nodePtr node, const go::fileBase& data){
     go::data d;
     data.get(d);
 
-    node->childNodes.push_back( d.root );
+    node->childNodes().push_back( d.root );
     d.root->parent_ = node;
 
     createNodeList();
@@ -986,11 +1024,14 @@ void BoardWidget::insertData(const go::nodePtr node, const go::fileBase& data){
 */
 
 void BoardWidget::setRoot(go::informationPtr& info){
+    undoStack.clear();
+    --goData.root->pinned;
+    info->load();
+    ++info->pinned;
     goData.root = info;
     nodeList.clear();
     setCurrentNode();
     paintBoard();
-    undoStack.clear();
 }
 
 bool BoardWidget::forward(int n){
@@ -1035,11 +1076,8 @@ void BoardWidget::insertStoneNodeCommand(int index, int sgfX, int sgfY){
         if (forward(sgfX, sgfY))
             return;
 
-        board[boardY][boardX].color = color;
-        if (isKill(boardX, boardY) == false && isDead(boardX, boardY) == true){
-            board[boardY][boardX].color = go::empty;
+        if (position_.isSuicide(boardX, boardY, color))
             return;
-        }
     }
 
     go::nodePtr node;
@@ -1075,13 +1113,13 @@ void BoardWidget::addMarkCommand(int sgfX, int sgfY, bool ctrl){
             break;
 
         case eLabelMark:{
-            QString label = createMarkCharacter(currentNode->marks);
+            QString label = createMarkCharacter(currentNode->marks());
             addMarkCommand(currentNode, sgfX, sgfY, go::mark::eCharacter, label);
             break;
         }
 
         case eManualMark:{
-            QString label = createMarkManually(currentNode->marks);
+            QString label = createMarkManually(currentNode->marks());
             addMarkCommand(currentNode, sgfX, sgfY, go::mark::eCharacter, label);
             break;
         }
@@ -1147,19 +1185,19 @@ void BoardWidget::addStoneCommand(go::nodePtr node, int sgfX, int sgfY, go::colo
     sgfToBoardCoordinate(sgfX, sgfY, boardX, boardY);
 
     go::point p(sgfX, sgfY);
-    foreach(const go::stone& stone, node->emptyStones){
+    foreach(const go::stone& stone, node->emptyStones()){
         if (stone.p == p){
             undoStack.push( new DeleteStoneCommand(this, node, sgfX, sgfY) );
             return;
         }
     }
-    foreach(const go::stone& stone, node->blackStones){
+    foreach(const go::stone& stone, node->blackStones()){
         if (stone.p == p){
             undoStack.push( new DeleteStoneCommand(this, node, sgfX, sgfY) );
             return;
         }
     }
-    foreach(const go::stone& stone, node->whiteStones){
+    foreach(const go::stone& stone, node->whiteStones()){
         if (stone.p == p){
             undoStack.push( new DeleteStoneCommand(this, node, sgfX, sgfY) );
             return;
@@ -1169,7 +1207,7 @@ void BoardWidget::addStoneCommand(go::nodePtr node, int sgfX, int sgfY, go::colo
     if (color != go::empty && board[boardY][boardX].empty() == false)
         return;
 
-    go::nodePtr stoneNode( node->isStone() ? go::nodePtr(new go::node(node)) : node );
+    go::nodePtr stoneNode( node->isStone() ? go::createNode(node) : node );
     if (stoneNode != node)
         addNodeCommand(node, stoneNode);
 
@@ -1198,25 +1236,25 @@ void BoardWidget::addMarkCommand(go::nodePtr node, int sgfX, int sgfY, go::mark:
 */
 void BoardWidget::deleteMarkCommand(go::nodePtr node, int sgfX, int sgfY){
     go::point p(sgfX, sgfY);
-    foreach(const go::mark& mark, node->marks){
+    foreach(const go::mark& mark, node->marks()){
         if (mark.p == p){
             undoStack.push( new DeleteMarkCommand(this, node, sgfX, sgfY) );
             return;
         }
     }
-    foreach(const go::stone& stone, node->emptyStones){
+    foreach(const go::stone& stone, node->emptyStones()){
         if (stone.p == p){
             undoStack.push( new DeleteMarkCommand(this, node, sgfX, sgfY) );
             return;
         }
     }
-    foreach(const go::stone& stone, node->blackStones){
+    foreach(const go::stone& stone, node->blackStones()){
         if (stone.p == p){
             undoStack.push( new DeleteMarkCommand(this, node, sgfX, sgfY) );
             return;
         }
     }
-    foreach(const go::stone& stone, node->whiteStones){
+    foreach(const go::stone& stone, node->whiteStones()){
         if (stone.p == p){
             undoStack.push( new DeleteMarkCommand(this, node, sgfX, sgfY) );
             return;
@@ -1245,7 +1283,7 @@ void BoardWidget::unsetMoveNumberCommand(go::nodePtr node){
 /**
 */
 void BoardWidget::setNodeNameCommand(go::nodePtr node, const QString& nodeName){
-    if( node->name == nodeName)
+    if( node->name() == nodeName)
         return;
 
     undoStack.push( new SetNodeNameCommand(this, node, nodeName) );
@@ -1254,12 +1292,19 @@ void BoardWidget::setNodeNameCommand(go::nodePtr node, const QString& nodeName){
 /**
 */
 void BoardWidget::setCommentCommand(go::nodePtr node, const QString& comment){
-    if( node->comment == comment)
+    if( node->comment() == comment)
+        return;
+
+    undoStack.push( new SetCommentCommand(this, node, comment) );
+}
+
+/**
+*/
+void BoardWidget::setAnnotationCommand(go::nodePtr node, quint8 go::nodeProperty::* member, int annotation){
+    if( node->property()->*member == annotation )
         return;
 
-//    undoStack.push( new SetCommentCommand(this, node, comment) );
-    node->comment = comment;
-    modifyNode(node);
+    undoStack.push( new SetAnnotationCommand(this, node, member, annotation) );
 }
 
 void BoardWidget::rotateSgfCommand(){
@@ -1290,8 +1335,12 @@ void BoardWidget::flipSgfVerticallyCommand(){
 * add node at end of child list of parent node.
 */
 void BoardWidget::addNode(go::nodePtr parent, go::nodePtr node, bool select){
-    parent->childNodes.push_back(node);
-    node->parent_ = parent;
+    parent->childNodes().push_back(node);
+    node->updateDepth();
+    if (moveNumberMode != eSequential){
+        dropSnapshots(parent, true);
+        unwindBoardBuffer(parent);
+    }
 
     setDirty(true);
     emit nodeAdded(parent, node, select);
@@ -1303,8 +1352,12 @@ void BoardWidget::addNode(go::nodePtr parent, go::nodePtr node, bool select){
 /**
 */
 void BoardWidget::insertNode(go::nodePtr parent, int index, go::nodePtr node, bool select){
-    parent->childNodes.insert(parent->childNodes.begin() + index, node);
-    node->parent_ = parent;
+    parent->childNodes().insert(index, node);
+    node->updateDepth();
+    if (moveNumberMode != eSequential){
+        dropSnapshots(parent, true);
+        unwindBoardBuffer(parent);
+    }
 
     setDirty(true);
     emit nodeAdded(parent, node, select);
@@ -1319,37 +1372,46 @@ void BoardWidget::deleteNode(go::nodePtr node, bool deleteChildren){
     if( node == goData.root )
         return;
 
+    go::nodeList children = node->childNodes().toList();
     go::nodePtr parent = node->parent();
+    dropSnapshots(node);
     if (parent){
-        if (deleteChildren == false){
-            go::nodeList::iterator iter = qFind(parent->childNodes.begin(), parent->childNodes.end(), node);
-            go::nodeList::iterator iter2 = node->childNodes.begin();
-            while (iter2 != node->childNodes.end()){
-                iter = parent->childNodes.insert(iter, *iter2);
-                (*iter)->parent_ = parent;
-                ++iter;
-                ++iter2;
+        int index = parent->childNodes().indexOf(node);
+        if (index >= 0){
+            parent->childNodes().removeAt(index);
+            if (deleteChildren == false){
+                node->childNodes().clear();
+                foreach(const go::nodePtr& child, children){
+                    parent->childNodes().insert(index++, child);
+                    child->updateDepth();
+                }
             }
         }
-
-        go::nodeList::iterator iter = qFind(parent->childNodes.begin(), parent->childNodes.end(), node);
-        if (iter != parent->childNodes.end())
-            parent->childNodes.erase(iter);
     }
 
+    if (parent && moveNumberMode != eSequential){
+        dropSnapshots(parent, true);
+        unwindBoardBuffer(parent);
+    }
     setCurrentNode(parent);
 
     setDirty(true);
-    emit nodeDeleted(node, deleteChildren);
+    emit nodeDeleted(node, children);
 
     createNodeList();
 }
 
 /**
+* stones and move numbers of node change boards of its subtree only,
+* and other properties are not put on board.
 */
-void BoardWidget::modifyNode(go::nodePtr node, bool recreateBoardBuffer){
-    if (recreateBoardBuffer)
+void BoardWidget::modifyNode(go::nodePtr node, eNodeChange change){
+    if (change == eStoneChange && editMode == eFinalScore)
         createBoardBuffer();
+    else if (change != ePropertyChange){
+        dropSnapshots(node);
+        unwindBoardBuffer(node->parent());
+    }
     paintBoard();
     setDirty(true);
     emit nodeModified(node);
@@ -1384,7 +1446,10 @@ void BoardWidget::setCurrentNode(go::nodePtr node){
     if (iter == nodeList.end())
         createNodeList();
 
-    createBoardBuffer();
+    if (boardRoot != goData.root)
+        createBoardBuffer();
+    else
+        updateBoardBuffer();
 
     if (playSound && node->isStone())
         stoneSound.play();
@@ -1412,23 +1477,26 @@ void BoardWidget::setBoardSize(int xsize, int ysize){
 }
 
 void BoardWidget::rotateSgf(go::nodePtr node, QUndoCommand* command){
-    go::point p = node->position;
-    p.x = goData.root->ysize - node->position.y - 1;
-    p.y = node->position.x;
+    go::point p = node->position();
+    p.x = goData.root->ysize - node->getY() - 1;
+    p.y = node->getX();
     new MovePositionCommand(this, node, p, command);
 
-    go::nodeList::iterator iter = node->childNodes.begin();
-    while (iter != node->childNodes.end()){
+    go::childList::iterator iter = node->childNodes().begin();
+    while (iter != node->childNodes().end()){
         rotateSgf(*iter, command);
         ++iter;
     }
 
-    rotateStoneSgf(node, node->emptyStones, command);
-    rotateStoneSgf(node, node->blackStones, command);
-    rotateStoneSgf(node, node->whiteStones, command);
-    rotateMarkSgf(node, node->marks, command);
-    rotateMarkSgf(node, node->blackTerritories, command);
-    rotateMarkSgf(node, node->whiteTerritories, command);
+    if (node->hasProperty()){
+        go::nodeProperty* property = node->editProperty();
+        rotateStoneSgf(node, property->emptyStones, command);
+        rotateStoneSgf(node, property->blackStones, command);
+        rotateStoneSgf(node, property->whiteStones, command);
+        rotateMarkSgf(node, property->marks, command);
+        rotateMarkSgf(node, property->blackTerritories, command);
+        rotateMarkSgf(node, property->whiteTerritories, command);
+    }
 }
 
 void BoardWidget::rotateStoneSgf(go::nodePtr node, go::stoneList& stoneList, QUndoCommand* command){
@@ -1458,25 +1526,28 @@ void BoardWidget::rotateMarkSgf(go::nodePtr node, go::markList& markList, QUndoC
 }
 
 void BoardWidget::flipSgf(go::nodePtr node, int xsize, int ysize, QUndoCommand* command){
-    go::point p = node->position;
+    go::point p = node->position();
     if (xsize)
         p.x = xsize - p.x - 1;
     if (ysize)
         p.y = ysize - p.y - 1;
     new MovePositionCommand(this, node, p, command);
 
-    go::nodeList::iterator iter = node->childNodes.begin();
-    while (iter != node->childNodes.end()){
+    go::childList::iterator iter = node->childNodes().begin();
+    while (iter != node->childNodes().end()){
         flipSgf(*iter, xsize, ysize, command);
         ++iter;
     }
 
-    flipStoneSgf(node, node->emptyStones, xsize, ysize, command);
-    flipStoneSgf(node, node->blackStones, xsize, ysize, command);
-    flipStoneSgf(node, node->whiteStones, xsize, ysize, command);
-    flipMarkSgf(node, node->marks, xsize, ysize, command);
-    flipMarkSgf(node, node->blackTerritories, xsize, ysize, command);
-    flipMarkSgf(node, node->whiteTerritories, xsize, ysize, command);
+    if (node->hasProperty()){
+        go::nodeProperty* property = node->editProperty();
+        flipStoneSgf(node, property->emptyStones, xsize, ysize, command);
+        flipStoneSgf(node, property->blackStones, xsize, ysize, command);
+        flipStoneSgf(node, property->whiteStones, xsize, ysize, command);
+        flipMarkSgf(node, property->marks, xsize, ysize, command);
+        flipMarkSgf(node, property->blackTerritories, xsize, ysize, command);
+        flipMarkSgf(node, property->whiteTerritories, xsize, ysize, command);
+    }
 }
 
 void BoardWidget::flipStoneSgf(go::nodePtr node, go::stoneList& stoneList, int xsize, int ysize, QUndoCommand* command){
@@ -1553,16 +1624,21 @@ void BoardWidget::resetBoard(){
 /**
 */
 go::nodePtr BoardWidget::findNodeFromMoveNumber(int moveNumber){
-    go::nodeList::iterator iter = nodeList.begin();
-
-    int number = 0;
-    while (iter != nodeList.end()){
-        if ((*iter)->isStone() && ++number == moveNumber)
-            return *iter;
-        ++iter;
+    if (moveNumber <= 0 || nodeList.empty() || nodeList.back()->moveIndex() < moveNumber)
+        return go::nodePtr();
+
+    // nodeList is one line from root, so move index is sorted.
+    int first = 0;
+    int last  = nodeList.size() - 1;
+    while (first < last){
+        int middle = (first + last) / 2;
+        if (nodeList[middle]->moveIndex() < moveNumber)
+            first = middle + 1;
+        else
+            last = middle;
     }
 
-    return go::nodePtr();
+    return nodeList[first];
 }
 
 /**
@@ -1575,8 +1651,8 @@ void BoardWidget::createNodeList(){
         nodeList.push_front(node);
 
     nodeList.push_back( node = currentNode );
-    while (!node->childNodes.empty()){
-        node = node->childNodes.front();
+    while (!node->childNodes().empty()){
+        node = node->childNodes().front();
         nodeList.push_back(node);
     }
 }
@@ -1586,65 +1662,273 @@ void BoardWidget::createNodeList(){
 void BoardWidget::createBoardBuffer(){
     xsize = (rotateBoard_ == 0 || rotateBoard_ == 2) ? goData.root->xsize : goData.root->ysize;
     ysize = (rotateBoard_ == 0 || rotateBoard_ == 2) ? goData.root->ysize : goData.root->xsize;
+    boardRoot = goData.root;
+    snapshots.clear();
+
+    resetBoardBuffer();
+    updateBoardBuffer();
+}
+
+/**
+* make board empty to put nodes from root.
+*/
+void BoardWidget::resetBoardBuffer(){
     capturedBlack = 0;
     capturedWhite = 0;
 
-    board.clear();
-    board.resize(ysize);
-    for (int i=0; i<ysize; ++i)
-        board[i].resize(xsize);
+    board.resize(xsize, ysize);
+    position_.clear(xsize, ysize);
 
+    moveStack.clear();
+    territoryCells.clear();
+    stackBase = 0;
+    baseNode.reset();
     currentMoveNumber = 0;
-    go::nodeList::iterator iter = nodeList.begin();
-    while (iter != nodeList.end()){
-        if ((*iter)->moveNumber > 0){
-            for (int y=0; y<board.size(); ++y)
-                for (int x=0; x<board[y].size(); ++x)
-                    board[y][x].number = 0;
-            currentMoveNumber = (*iter)->moveNumber - 1;
+}
+
+/**
+* put nodes from root to current node on board.
+* board goes to current node by the shortest of taking nodes on board back
+* until common parent, restoring nearest snapshot, or putting all nodes from root.
+*/
+void BoardWidget::updateBoardBuffer(){
+    removeTerritories();
+
+    int last = nodeList.indexOf(currentNode);
+    if (last < 0)
+        last = nodeList.size() - 1;
+
+    // nodes on board and nodeList are lines from root, so they are same until common parent.
+    int top = stackBase + moveStack.size();
+    int common = qMin(top, last + 1);
+    while (common > stackBase && moveStack[common - stackBase - 1].node != nodeList[common - 1])
+        --common;
+
+    // nodes put by snapshot can't be taken back.
+    bool onBoard = common > stackBase || (common == stackBase && (stackBase == 0 || baseNode == nodeList[stackBase - 1]));
+    int steps = last + 2;  // clear board and put all nodes
+    if (onBoard)
+        steps = qMin(steps, (top - common) + (last + 1 - common));
+
+    int snapshot = -1;
+    for (int i = (last + 1) / BOARD_SNAPSHOT_INTERVAL * BOARD_SNAPSHOT_INTERVAL - 1; i >= 0 && last - i + 1 < steps; i -= BOARD_SNAPSHOT_INTERVAL){
+        if (snapshots.contains(nodeList[i].get())){
+            snapshot = i;
+            break;
         }
-        else if ( (*iter)->parent() &&
-                  ( (moveNumberMode == eResetInBranch && (*iter)->parent()->childNodes.size() > 1) ||
-                    (moveNumberMode == eResetInVariation && (*iter)->parent()->childNodes.size() > 1 && *iter != (*iter)->parent()->childNodes.front()) ) ){
-            for (int y=0; y<board.size(); ++y)
-                for (int x=0; x<board[y].size(); ++x)
-                    board[y][x].number = 0;
-            currentMoveNumber = 0;
+    }
+
+    if (snapshot >= 0){
+        restoreSnapshot(nodeList[snapshot], snapshot);
+        common = snapshot + 1;
+    }
+    else if (!onBoard || steps == last + 2){
+        resetBoardBuffer();
+        common = 0;
+    }
+    else{
+        while (stackBase + moveStack.size() > common)
+            popMove();
+    }
+
+    for (int i=common; i<=last; ++i){
+        pushMove(nodeList[i]);
+        if ((i + 1) % BOARD_SNAPSHOT_INTERVAL == 0 && !snapshots.contains(nodeList[i].get()))
+            saveSnapshot(nodeList[i]);
+    }
+
+    putTerritories();
+}
+
+/**
+* put nodes after node again, because they depend on child nodes of node.
+* all nodes are put again if node is NULL.
+* snapshots of changed nodes must be dropped before it.
+*/
+void BoardWidget::unwindBoardBuffer(go::nodePtr node){
+    // territories of final score are not recorded, board is created after it.
+    if (editMode == eFinalScore || !boardRoot)
+        return;
+
+    int i = moveStack.size() - 1;
+    while (i >= 0 && moveStack[i].node != node)
+        --i;
+
+    if (i < 0 && node != baseNode){
+        // nodes put by snapshot can't be taken back.
+        go::nodePtr n = baseNode;
+        while (n != NULL && n != node)
+            n = n->parent();
+        if (n != NULL || node == NULL){
+            resetBoardBuffer();
+            updateBoardBuffer();
         }
+        return;
+    }
 
-        if ((*iter)->isStone())
-            ++currentMoveNumber;
+    if (i == moveStack.size() - 1)
+        return;
 
-        putStone(*iter, currentMoveNumber);
-        putDim(*iter);
+    removeTerritories();
+    while (moveStack.size() > i + 1)
+        popMove();
 
-        if (*iter == currentNode)
-            break;
+    updateBoardBuffer();
+}
 
-        ++iter;
+/**
+* drop snapshots of node and nodes under it, or only of nodes under it if childrenOnly is true.
+* node of each snapshot is taken up to depth of node by its parents.
+*/
+void BoardWidget::dropSnapshots(go::nodePtr node, bool childrenOnly){
+    int depth = node->depth();
+    foreach(go::node* key, snapshots.keys()){
+        const go::node* n = key;
+        int d = n->depth();
+        if (d < depth || (childrenOnly && d == depth))
+            continue;
+
+        while (d-- > depth && n != NULL)
+            n = n->parent().get();
+        if (n == node.get())
+            snapshots.remove(key);
+    }
+}
+
+/**
+* save board after node.
+* buffer is shared with board until either of them is changed, and then it is copied in one block.
+*/
+void BoardWidget::saveSnapshot(go::nodePtr node){
+    boardSnapshot* snapshot = new boardSnapshot;
+    snapshot->board = board;
+    snapshot->color = color;
+    snapshot->moveNumber = currentMoveNumber;
+    snapshot->capturedBlack = capturedBlack;
+    snapshot->capturedWhite = capturedWhite;
+
+    snapshots.insert(node.get(), snapshot, xsize * ysize * sizeof(stoneInfo));
+}
+
+/**
+* restore board after node, which is index-th node from root.
+*/
+void BoardWidget::restoreSnapshot(go::nodePtr node, int index){
+    const boardSnapshot* snapshot = snapshots.object(node.get());
+    board = snapshot->board;
+    color = snapshot->color;
+    currentMoveNumber = snapshot->moveNumber;
+    capturedBlack = snapshot->capturedBlack;
+    capturedWhite = snapshot->capturedWhite;
+
+    position_.clear(xsize, ysize);
+    const BoardBuffer& buf = snapshot->board;
+    for (int y=0; y<buf.ysize(); ++y)
+        for (int x=0; x<buf.xsize(); ++x)
+            if (!buf[y][x].empty())
+                position_.setStone(x, y, buf[y][x].black() ? go::black : go::white);
+
+    moveStack.clear();
+    territoryCells.clear();
+    stackBase = index + 1;
+    baseNode = node;
+}
+
+/**
+* put node on board, and record points changed by it.
+*/
+void BoardWidget::pushMove(go::nodePtr node){
+    moveStack.push_back(moveInfo());
+    recording = &moveStack.back();
+    recording->node = node;
+    recording->color = color;
+    recording->moveNumber = currentMoveNumber;
+    recording->capturedBlack = capturedBlack;
+    recording->capturedWhite = capturedWhite;
+
+    if (node->moveNumber > 0){
+        for (int y=0; y<board.ysize(); ++y)
+            for (int x=0; x<board.xsize(); ++x)
+                if (board[y][x].number != 0){
+                    saveCell(x, y);
+                    board[y][x].number = 0;
+                }
+        currentMoveNumber = node->moveNumber - 1;
+    }
+    else if ( node->parent() &&
+              ( (moveNumberMode == eResetInBranch && node->parent()->childNodes().size() > 1) ||
+                (moveNumberMode == eResetInVariation && node->parent()->childNodes().size() > 1 && node != node->parent()->childNodes().front()) ) ){
+        for (int y=0; y<board.ysize(); ++y)
+            for (int x=0; x<board.xsize(); ++x)
+                if (board[y][x].number != 0){
+                    saveCell(x, y);
+                    board[y][x].number = 0;
+                }
+        currentMoveNumber = 0;
     }
 
-    go::markList::iterator iter2 = currentNode->blackTerritories.begin();
-    while (iter2 != currentNode->blackTerritories.end()){
+    if (node->isStone())
+        ++currentMoveNumber;
+
+    putStone(node, currentMoveNumber);
+    putDim(node);
+
+    recording = NULL;
+}
+
+/**
+* take last node back from board.
+*/
+void BoardWidget::popMove(){
+    const moveInfo& move = moveStack.back();
+    for (int i=move.cells.size()-1; i>=0; --i){
+        const cellInfo& cell = move.cells[i];
+        board[cell.y][cell.x] = cell.info;
+        position_.setStone(cell.x, cell.y, cell.info.black() ? go::black : cell.info.white() ? go::white : go::empty);
+    }
+
+    color = move.color;
+    currentMoveNumber = move.moveNumber;
+    capturedBlack = move.capturedBlack;
+    capturedWhite = move.capturedWhite;
+    moveStack.pop_back();
+}
+
+/**
+* put territories of current node.
+*/
+void BoardWidget::putTerritories(){
+    go::markList::const_iterator iter2 = currentNode->blackTerritories().begin();
+    while (iter2 != currentNode->blackTerritories().end()){
         int boardX, boardY;
         sgfToBoardCoordinate(iter2->p.x, iter2->p.y, boardX, boardY);
         if (boardX >= 0 && boardX < xsize && boardY >= 0 && boardY < ysize){
+            territoryCells.push_back( cellInfo(boardX, boardY, board[boardY][boardX]) );
             board[boardY][boardX].color |= go::blackTerritory;
         }
         ++iter2;
     }
 
-    iter2 = currentNode->whiteTerritories.begin();
-    while (iter2 != currentNode->whiteTerritories.end()){
+    iter2 = currentNode->whiteTerritories().begin();
+    while (iter2 != currentNode->whiteTerritories().end()){
         int boardX, boardY;
         sgfToBoardCoordinate(iter2->p.x, iter2->p.y, boardX, boardY);
         if (boardX >= 0 && boardX < xsize && boardY >= 0 && boardY < ysize){
+            territoryCells.push_back( cellInfo(boardX, boardY, board[boardY][boardX]) );
             board[boardY][boardX].color |= go::whiteTerritory;
         }
         ++iter2;
     }
 }
 
+/**
+*/
+void BoardWidget::removeTerritories(){
+    for (int i=territoryCells.size()-1; i>=0; --i)
+        board[territoryCells[i].y][territoryCells[i].x] = territoryCells[i].info;
+    territoryCells.clear();
+}
+
 void BoardWidget::drawBoard(QPainter& p, qreal pointSize, bool showCoordinates){
     p.save();
 
@@ -1836,10 +2120,10 @@ void BoardWidget::drawStonesAndMarkers(QPainter& p){
 
     p.setRenderHints(QPainter::Antialiasing|QPainter::TextAntialiasing);
 
-    if (currentNode->childNodes.size() > 1)
-        drawBranchMoves(p, currentNode->childNodes.begin(), currentNode->childNodes.end());
+    if (currentNode->childNodes().size() > 1)
+        drawBranchMoves(p, currentNode->childNodes().begin(), currentNode->childNodes().end());
 
-    foreach(const go::mark& m, currentNode->marks){
+    foreach(const go::mark& m, currentNode->marks()){
         if (m.t == go::mark::eCross)
             drawCross(p, m);
         else if (m.t == go::mark::eTriangle)
@@ -1866,8 +2150,8 @@ void BoardWidget::drawStones(QPainter& p){
 
     QFont font( p.font() );
 
-    for (int y=0; y<board.size(); ++y){
-        for (int x=0; x<board[y].size(); ++x){
+    for (int y=0; y<board.ysize(); ++y){
+        for (int x=0; x<board.xsize(); ++x){
             // draw stone
             if (board[y][x].black())
                 drawStone(p, x, y, go::black, board[y][x].whiteTerritory() || board[y][x].dame() ? 0.4 : 1.0);
@@ -1906,7 +2190,7 @@ void BoardWidget::drawStones(QPainter& p){
 
 /**
 */
-void BoardWidget::drawBranchMoves(QPainter& p, go::nodeList::iterator first, go::nodeList::iterator last){
+void BoardWidget::drawBranchMoves(QPainter& p, go::childList::iterator first, go::childList::iterator last){
     if (showBranchMoves == false)
         return;
 
@@ -2240,15 +2524,19 @@ void BoardWidget::putStone(go::nodePtr node, int moveNumber){
     else if (node->nextColor != go::empty)
         color = node->nextColor;
 
-    go::stoneList stones;
-    stones << node->emptyStones << node->blackStones << node->whiteStones;
-    foreach(const go::stone& stone, stones){
-        int boardX, boardY;
-        sgfToBoardCoordinate(stone.p.x, stone.p.y, boardX, boardY);
-        if (boardX >= 0 && boardX < xsize && boardY >= 0 && boardY < ysize){
-            board[boardY][boardX].color  = stone.c;
-            board[boardY][boardX].number = 0;
-            board[boardY][boardX].node   = node;
+    if (node->hasProperty()){
+        go::stoneList stones;
+        stones << node->emptyStones() << node->blackStones() << node->whiteStones();
+        foreach(const go::stone& stone, stones){
+            int boardX, boardY;
+            sgfToBoardCoordinate(stone.p.x, stone.p.y, boardX, boardY);
+            if (boardX >= 0 && boardX < xsize && boardY >= 0 && boardY < ysize){
+                saveCell(boardX, boardY);
+                board[boardY][boardX].color  = stone.c;
+                board[boardY][boardX].number = 0;
+                board[boardY][boardX].setNode(node);
+                position_.setStone(boardX, boardY, stone.c);
+            }
         }
     }
 
@@ -2257,9 +2545,10 @@ void BoardWidget::putStone(go::nodePtr node, int moveNumber){
         sgfToBoardCoordinate(node->getX(), node->getY(), boardX, boardY);
 
         if (boardX >= 0 && boardX < xsize && boardY >= 0 && boardY < ysize){
+            saveCell(boardX, boardY);
             board[boardY][boardX].color  = node->isBlack() ? go::black : go::white;
             board[boardY][boardX].number = moveNumber;
-            board[boardY][boardX].node   = node;
+            board[boardY][boardX].setNode(node);
             removeDeadStones(boardX, boardY);
         }
     }
@@ -2268,140 +2557,52 @@ void BoardWidget::putStone(go::nodePtr node, int moveNumber){
 /**
 */
 void BoardWidget::putDim(go::nodePtr node){
-    foreach(const go::mark& mark, node->dims){
+    foreach(const go::mark& mark, node->dims()){
         int boardX, boardY;
         sgfToBoardCoordinate(mark.p.x, mark.p.y, boardX, boardY);
-        if (boardX >= 0 && boardX < xsize && boardY >= 0 && boardY < ysize)
+        if (boardX >= 0 && boardX < xsize && boardY >= 0 && boardY < ysize){
+            saveCell(boardX, boardY);
             board[boardY][boardX].dim = true;
+        }
     }
 }
 
 /**
+* remove groups captured by stone at x, y.
 */
 void BoardWidget::removeDeadStones(int x, int y){
     if (board[y][x].empty())
         return;
 
-    // check kill enemy
-    int c = board[y][x].black() ? go::white : go::black;
-    int* tmp = new int[xsize * ysize];
-
-    memset(tmp, 0, sizeof(int) * xsize * ysize);
-    if (y > 0 && board[y-1][x].color == c && isDead(tmp, c, x, y - 1))
-        dead(tmp);
-
-    memset(tmp, 0, sizeof(int) * xsize * ysize);
-    if (y < ysize-1 && board[y+1][x].color == c && isDead(tmp, c, x, y + 1))
-        dead(tmp);
-
-    memset(tmp, 0, sizeof(int) * xsize * ysize);
-    if (x > 0 && board[y][x-1].color == c && isDead(tmp, c, x - 1, y))
-        dead(tmp);
-
-    memset(tmp, 0, sizeof(int) * xsize * ysize);
-    if (x < xsize-1 && board[y][x+1].color == c && isDead(tmp, c, x + 1, y))
-        dead(tmp);
-
-
-    // check suicide
-    c = board[y][x].black() ? go::black : go::white;
-
-    memset(tmp, 0, sizeof(int) * xsize * ysize);
-    if (isDead(tmp, c, x, y))
-        dead(tmp);
-
-    delete[] tmp;
-}
-
-/**
-*/
-bool BoardWidget::isDead(int* tmp, int c, int x, int y){
-    if (tmp[y*xsize+x])
-        return true;
-    else if (board[y][x].empty())
-        return false;
-    else if ((board[y][x].color & c) == 0)
-        return true;
-    tmp[y*xsize+x] = board[y][x].color;
-
-    if (y > 0 && !isDead(tmp, c, x, y - 1))
-        return false;
-
-    if (y < ysize-1 && !isDead(tmp, c, x, y + 1))
-        return false;
-
-    if (x > 0 && !isDead(tmp, c, x - 1, y))
-        return false;
-
-    if (x < xsize-1 && !isDead(tmp, c, x + 1, y))
-        return false;
-
-    return true;
-}
-
-/**
-*/
-bool BoardWidget::isDead(int x, int y){
-    int size = xsize * ysize;
-    int* tmp = new int[size];
-    memset(tmp, 0, sizeof(int)*size);
-
-    int c = board[y][x].color;
-    bool dead = isDead(tmp, c, x, y);
-
-    delete[] tmp;
-
-    return dead;
-}
-
-/**
-*/
-bool BoardWidget::isKill(int x, int y){
-    int* tmp = new int[xsize * ysize];
-
-    go::color c = board[y][x].color == go::black ? go::white : go::black;
-
-    memset(tmp, 0, sizeof(int)* xsize * ysize);
-    bool dead = (y > 0 && board[y-1][x].color == c && isDead(tmp, c, x, y - 1));
-
-    memset(tmp, 0, sizeof(int)* xsize * ysize);
-    dead = !dead ? (y < ysize-1 && board[y+1][x].color == c && isDead(tmp, c, x, y + 1)) : true;
-
-    memset(tmp, 0, sizeof(int)* xsize * ysize);
-    dead = !dead ? (x > 0 && board[y][x-1].color == c && isDead(tmp, c, x - 1, y)) : true;
+    QVector<go::point> captured;
+    position_.play(x, y, board[y][x].black() ? go::black : go::white, &captured);
+    foreach(const go::point& p, captured){
+        saveCell(p.x, p.y);
+        stoneInfo& info = board[p.y][p.x];
+        if (info.color == go::black)
+            ++capturedBlack;
 
-    memset(tmp, 0, sizeof(int)* xsize * ysize);
-    dead = !dead ? (x < xsize-1 && board[y][x+1].color == c && isDead(tmp, c, x + 1, y)) : true;
+        if (info.color == go::white)
+            ++capturedWhite;
 
-    delete[] tmp;
-
-    return dead;
+        info.color = go::empty;
+        info.node = 0;
+    }
 }
 
 /**
+* record point before it is changed by node which is put now.
 */
-void BoardWidget::dead(int* tmp){
-    for (int y=0; y<ysize; ++y){
-        for (int x=0; x<xsize; ++x){
-            if (tmp[y*xsize+x]){
-                if (board[y][x].color == go::black)
-                    ++capturedBlack;
-
-                if (board[y][x].color == go::white)
-                    ++capturedWhite;
-
-                board[y][x].color = go::empty;
-                board[y][x].node.reset();
-            }
-        }
-    }
+void BoardWidget::saveCell(int x, int y){
+    if (recording)
+        recording->cells.push_back( cellInfo(x, y, board[y][x]) );
 }
 
 /**
 */
 bool BoardWidget::forward(int sgfX, int sgfY){
-    go::nodeList::iterator iter = currentNode->childNodes.begin();
-    while (iter != currentNode->childNodes.end()){
+    go::childList::iterator iter = currentNode->childNodes().begin();
+    while (iter != currentNode->childNodes().end()){
         if ((*iter)->getX() == sgfX && (*iter)->getY() == sgfY){
             setCurrentNode(*iter);
             return true;
@@ -2412,7 +2613,7 @@ bool BoardWidget::forward(int sgfX, int sgfY){
     return false;
 }
 
-QString BoardWidget::createMarkCharacter(go::markList& markList){
+QString BoardWidget::createMarkCharacter(const go::markList& markList){
     QStringList marks;
     foreach(go::mark m, markList)
         if (m.t == go::mark::eCharacter)
@@ -2451,7 +2652,7 @@ QString BoardWidget::createMarkCharacter(go::markList& markList){
     return s;
 }
 
-QString BoardWidget::createMarkManually(go::markList& markList){
+QString BoardWidget::createMarkManually(const go::markList& markList){
     return QInputDialog::getText(this, QString(), tr("Input Label"));
 }
 
@@ -2473,7 +2674,7 @@ QString BoardWidget::toString(go::nodePtr node) const{
     else if (node->isPass())
         return "Pass";
     else
-        return getXYString(node->position.x, node->position.y);
+        return getXYString(node->getX(), node->getY());
 }
 
 QString BoardWidget::getXString(int x, bool showI) const{
@@ -2587,19 +2788,29 @@ void BoardWidget::whiteFirst(bool whiteFirst){
 }
 
 void BoardWidget::finalScore(){
-    char* tmp = new char[xsize * ysize];
-
-    for (int y=0; y<ysize; ++y){
-        for (int x=0; x<xsize; ++x){
-            memset(tmp, 0, xsize*ysize);
-            int c = go::empty;
-            whichTerritory(x, y, tmp, c);
-            if (board[y][x].empty() && (c & go::blackTerritory || c & go::whiteTerritory))
-                board[y][x].color = c;
-        }
-    }
+    if (!go::bitboard::fits(xsize, ysize))
+        return;
 
-    delete[] tmp;
+    // empty region is territory of color if it touches only stones or territories of the color.
+    const int territories = go::blackTerritory | go::whiteTerritory;
+    go::bitboard empties = colorPlane(0, go::black | go::white | territories);
+    go::bitboard black   = colorPlane(go::black, territories) | colorPlane(go::blackTerritory);
+    go::bitboard white   = colorPlane(go::white, territories) | colorPlane(go::whiteTerritory);
+    go::bitboard blackArea, whiteArea;
+    while (empties.any()){
+        go::bitboard region = empties.lowest().fill(empties);
+        empties = empties.andNot(region);
+
+        go::bitboard border = region.neighbors();
+        bool b = (border & black).any();
+        bool w = (border & white).any();
+        if (b && !w)
+            blackArea |= region;
+        else if (w && !b)
+            whiteArea |= region;
+    }
+    setColor(blackArea, go::blackTerritory, ~0);
+    setColor(whiteArea, go::whiteTerritory, ~0);
 
     for (int y=0; y<ysize; ++y){
         for (int x=0; x<xsize; ++x){
@@ -2651,92 +2862,89 @@ void BoardWidget::estimateScore(){
 
 }
 
-void BoardWidget::whichTerritory(int x, int y, char* tmp, int& c){
-    if (tmp[y*xsize+x] != 0)
+void BoardWidget::reverseTerritory(int x, int y){
+    if (!go::bitboard::fits(xsize, ysize))
         return;
-    tmp[y*xsize+x] = 1;
 
-    if (c == go::dame)
-        return;
-    else if (board[y][x].whiteTerritory()){
-        c = go::whiteTerritory;
-        return;
-    }
-    else if (board[y][x].blackTerritory()){
-        c = go::blackTerritory;
-        return;
-    }
-    else if ((board[y][x].black() && c == go::whiteTerritory) || (board[y][x].white() && c == go::blackTerritory)){
-        c = go::dame;
-        return;
-    }
-    else if (board[y][x].black()){
-        c = go::blackTerritory;
-        return;
-    }
-    else if (board[y][x].white()){
-        c = go::whiteTerritory;
+    toggleTerritory(x, y);
+    finalScore();
+    paintBoard();
+}
+
+/**
+* stones of points which are not in territories become dead, and score is counted once after all of them.
+*/
+void BoardWidget::setDeadStones(const QVector<go::point>& points){
+    if (!go::bitboard::fits(xsize, ysize))
         return;
+
+    foreach(const go::point& p, points){
+        if (p.x < 0 || p.x >= xsize || p.y < 0 || p.y >= ysize)
+            continue;
+
+        const stoneInfo& info = board[p.y][p.x];
+        if (!info.empty() && !info.blackTerritory() && !info.whiteTerritory())
+            toggleTerritory(p.x, p.y);
     }
 
-    if (y > 0)
-        whichTerritory(x, y-1, tmp, c);
-    if (y < ysize-1)
-        whichTerritory(x, y+1, tmp, c);
-    if (x > 0)
-        whichTerritory(x-1, y, tmp, c);
-    if (x < xsize-1)
-        whichTerritory(x+1, y, tmp, c);
+    finalScore();
+    paintBoard();
 }
 
-void BoardWidget::reverseTerritory(int x, int y){
+/**
+* stone at x, y becomes dead, or alive if it is dead.
+*/
+void BoardWidget::toggleTerritory(int x, int y){
     if (board[y][x].white() && !board[y][x].blackTerritory() && !board[y][x].dame())
         setTerritory(x, y, go::blackTerritory);
     else if (board[y][x].black() && !board[y][x].whiteTerritory() && !board[y][x].dame())
         setTerritory(x, y, go::whiteTerritory);
     else if ( (board[y][x].white() || board[y][x].black()) && (board[y][x].blackTerritory() || board[y][x].whiteTerritory() ||  board[y][x].dame()) )
         unsetTerritory(x, y);
-
-    finalScore();
-    paintBoard();
 }
 
+/**
+* points connected to x, y, which are not stones or territories of c, become territories of c.
+*/
 void BoardWidget::setTerritory(int x, int y, int c){
-    if ( c & go::blackTerritory && (board[y][x].black() || board[y][x].blackTerritory()) )
-        return;
-    else if ( c & go::whiteTerritory && (board[y][x].white() || board[y][x].whiteTerritory()) )
-        return;
-
-    board[y][x].color |= c;
-    if (c == go::blackTerritory)
-        board[y][x].color &= ~go::whiteTerritory;
-    else
-        board[y][x].color &= ~go::blackTerritory;
-
-    if (y > 0)
-        setTerritory(x, y-1, c);
-    if (y < ysize-1)
-        setTerritory(x, y+1, c);
-    if (x > 0)
-        setTerritory(x-1, y, c);
-    if (x < xsize-1)
-        setTerritory(x+1, y, c);
+    int own = c == go::blackTerritory ? go::black | go::blackTerritory : go::white | go::whiteTerritory;
+    go::bitboard seed;
+    seed.set(x, y);
+    go::bitboard area = seed.fill( colorPlane(0, own) );
+    setColor(area, c, c == go::blackTerritory ? go::whiteTerritory : go::blackTerritory);
 }
 
+/**
+* territories and dame connected to x, y are removed.
+*/
 void BoardWidget::unsetTerritory(int x, int y){
-    if ( !board[y][x].blackTerritory() && !board[y][x].whiteTerritory() && !board[y][x].dame() )
-        return;
+    go::bitboard seed;
+    seed.set(x, y);
+    go::bitboard area = seed.fill( colorPlane(go::blackTerritory | go::whiteTerritory | go::dame) );
+    setColor(area, 0, ~(go::black | go::white));
+}
 
-    board[y][x].color &= go::black | go::white;
+/**
+* points which have any of colors in any, and none of colors in none.
+* all points have any of colors if any is 0.
+*/
+go::bitboard BoardWidget::colorPlane(int any, int none) const{
+    go::bitboard plane;
+    for (int y=0; y<ysize; ++y)
+        for (int x=0; x<xsize; ++x)
+            if ((any == 0 || board[y][x].color & any) && (board[y][x].color & none) == 0)
+                plane.set(x, y);
+    return plane;
+}
 
-    if (y > 0)
-        unsetTerritory(x, y-1);
-    if (y < ysize-1)
-        unsetTerritory(x, y+1);
-    if (x > 0)
-        unsetTerritory(x-1, y);
-    if (x < xsize-1)
-        unsetTerritory(x+1, y);
+/**
+* set and unset colors of points in area.
+*/
+void BoardWidget::setColor(const go::bitboard& area, int set, int unset){
+    for (int y=0; y<ysize; ++y)
+        for (int x=0; x<xsize; ++x)
+            if (area.test(x, y))
+                board[y][x].color = (board[y][x].color & ~unset) | set;
 }
 
 void BoardWidget::getFinalScore(int& alive_b, int& alive_w, int& dead_b, int& dead_w, int& bt, int& wt){
@@ -2804,37 +3012,12 @@ bool BoardWidget::hasTerritory(int x1, int y1, int x2, int  y2){
     else // if dame
         return true;
 
-    char* tmp = new char[ysize*xsize];
-    memset(tmp, 0, ysize*xsize);
-    tmp[y1*xsize+x1] = true;
-    bool ret = hasTerritory(c1, c2, tmp, x2, y2);
-    delete[] tmp;
-    return ret;
-}
-
-bool BoardWidget::hasTerritory(go::color c1, go::color c2, char* tmp, int x, int  y){
-    if (x < 0 || x >= xsize || y < 0 || y >= ysize)
-        return false;
-
-    if (tmp[y*xsize+x])
-        return false;
-    tmp[y*xsize+x] = true;
-
-    if ((board[y][x].color & c1) == 0 && (board[y][x].color & c2) == 0 && !board[y][x].dame())
-        return false;
-    if (board[y][x].color & c2/* || board[y][x].dame()*/)
-        return true;
-
-    if (hasTerritory(c1, c2, tmp, x, y-1))
-        return true;
-    else if (hasTerritory(c1, c2, tmp, x, y+1))
-        return true;
-    else if (hasTerritory(c1, c2, tmp, x-1, y))
-        return true;
-    else if (hasTerritory(c1, c2, tmp, x+1, y))
-        return true;
-    else
-        return false;
+    // stones connected to x2, y2 through dame, except x1, y1, reach territory.
+    go::bitboard path = colorPlane(c1 | c2 | go::dame);
+    path.reset(x1, y1);
+    go::bitboard seed;
+    seed.set(x2, y2);
+    return (seed.fill(path) & colorPlane(c2)).any();
 }
 
 void BoardWidget::playWithComputer(PlayGame* game){
@@ -25,6 +25,7 @@
 #include <QList>
 #include <QProcess>
 #include <QTimer>
+#include <QCache>
 
 
 #if defined(Q_WS_WIN)
@@ -34,6 +35,9 @@
 #endif
 
 #include "godata.h"
+#include "journal.h"
+#include "position.h"
+#include "bitboard.h"
 #include "playgame.h"
 
 
@@ -66,6 +70,30 @@ public:
 #endif
 };
 
+/**
+* point of board. all members are 0 if point is empty, so buffer is cleared by memset.
+* it is primitive type, so QVector copies it by memcpy and zeroes new points.
+*/
+struct stoneInfo{
+    stoneInfo() : number(0), color(go::empty), dim(false), node(0){}
+    bool empty() const{ return (color & (go::black | go::white)) == 0; }
+    bool black() const{ return color & go::black; }
+    bool white() const{ return color & go::white; }
+    bool territory() const{ return color & (go::blackTerritory | go::whiteTerritory); }
+    bool blackTerritory() const{ return color & go::blackTerritory; }
+    bool whiteTerritory() const{ return color & go::whiteTerritory; }
+    bool dame() const{ return color & go::dame; }
+    bool hasNode() const{ return node != 0; }
+    quint32 nodeIndex() const{ return node - 1; }
+    void setNode(const go::nodePtr& n){ node = n ? n->index() + 1 : 0; }
+
+    int number;
+    int color;
+    bool dim;
+    quint32 node;  // index of node in arena of game + 1, 0 if there is no node
+};
+Q_DECLARE_TYPEINFO(stoneInfo, Q_PRIMITIVE_TYPE);
+
 /**
 * class BoardWidget
 * Qt Widget for goban.
@@ -76,23 +104,30 @@ public:
     enum eEditMode{ eAlternateMove, eAddBlack, eAddWhite, eAddEmpty, eLabelMark, eManualMark, eCrossMark, eCircleMark, eSquareMark, eTriangleMark, eDeleteMarker,
                     eFinalScore, ePlayGame, eTutorBothSides, eTutorOneSide, eAutoReplay };
     enum eMoveNumberMode{ eSequential, eResetInBranch, eResetInVariation };
+    enum eNodeChange{ ePropertyChange, eNumberChange, eStoneChange };
 
-    struct stoneInfo{
-        stoneInfo() : number(0), color(go::empty), dim(false){}
-        bool empty() const{ return (color & (go::black | go::white)) == 0; }
-        bool black() const{ return color & go::black; }
-        bool white() const{ return color & go::white; }
-        bool territory() const{ return color & (go::blackTerritory | go::whiteTerritory); }
-        bool blackTerritory() const{ return color & go::blackTerritory; }
-        bool whiteTerritory() const{ return color & go::whiteTerritory; }
-        bool dame() const{ return color & go::dame; }
-
-        int number;
-        int color;
-        bool dim;
-        go::nodePtr node;
+    typedef ::stoneInfo stoneInfo;
+
+    /**
+    * points of board in one array, row by row.
+    */
+    class BoardBuffer{
+    public:
+        BoardBuffer() : xsize_(0), ysize_(0){}
+
+        int xsize() const{ return xsize_; }
+        int ysize() const{ return ysize_; }
+        void resize(int xsize, int ysize){ xsize_ = xsize; ysize_ = ysize; cells.resize(xsize * ysize); clear(); }
+        void clear(){ qMemSet(cells.data(), 0, cells.size() * sizeof(stoneInfo)); }
+
+        stoneInfo* operator[](int y){ return cells.data() + y * xsize_; }
+        const stoneInfo* operator[](int y) const{ return cells.constData() + y * xsize_; }
+
+    private:
+        int xsize_;
+        int ysize_;
+        QVector<stoneInfo> cells;
     };
-    typedef QVector< QVector<stoneInfo> > BoardBuffer;
 
 
     explicit BoardWidget(QWidget *parent = 0);
@@ -100,6 +135,7 @@ public:
 
     // undo stack
     QUndoStack* getUndoStack(){ return &undoStack; }
+    go::journal& journal(){ return journal_; }
 
     // preference
     void readSettings();
@@ -118,12 +154,14 @@ public:
 
     // dirty flag
     bool isDirty() const{ return dirty; }
-    void setDirty(bool dirty){ this->dirty = dirty; }
+    void setDirty(bool dirty);
+    int editCount() const{ return edits; }
 
     // set/get data
     void clear();
     void getData(go::fileBase& data);
     void setData(const go::fileBase& data);
+    void setData(const go::data& data);
     void addData(const go::fileBase& data);
 //    void insertData(const go::nodePtr node, const go::fileBase& data);
     void setRoot(go::informationPtr& info);
@@ -160,6 +198,7 @@ public:
     void unsetMoveNumberCommand(go::nodePtr node);
     void setNodeNameCommand(go::nodePtr node, const QString& nodeName);
     void setCommentCommand(go::nodePtr node, const QString& comment);
+    void setAnnotationCommand(go::nodePtr node, quint8 go::nodeProperty::* member, int annotation);
     void rotateSgfCommand();
     void flipSgfHorizontallyCommand();
     void flipSgfVerticallyCommand();
@@ -167,7 +206,7 @@ public:
     void addNode(go::nodePtr parent, go::nodePtr node, bool select=true);
     void insertNode(go::nodePtr parent, int index, go::nodePtr node, bool select=true);
     void deleteNode(go::nodePtr node, bool deleteChildren=true);
-    void modifyNode(go::nodePtr node, bool recreateBoardBuffer=false);
+    void modifyNode(go::nodePtr node, eNodeChange change=ePropertyChange);
     void pass();
     void setCurrentNode(go::nodePtr node = go::nodePtr());
 
@@ -181,9 +220,9 @@ public:
     void setShowCoordinatesWithI(bool withI){ showCoordinatesI = withI; paintBoard(); }
     void setShowMarker(bool visible){ showMarker = visible; paintBoard(); }
     void setShowBranchMoves(bool visible){ showBranchMoves = visible; paintBoard(); }
-    void setAnnotation(int annotation){ currentNode->annotation = annotation; modifyNode(currentNode); }
-    void setMoveAnnotation(int annotation){ currentNode->moveAnnotation = annotation; modifyNode(currentNode); }
-    void setNodeAnnotation(int annotation){ currentNode->nodeAnnotation = annotation; modifyNode(currentNode); }
+    void setAnnotation(int annotation){ setAnnotationCommand(currentNode, &go::nodeProperty::annotation, annotation); }
+    void setMoveAnnotation(int annotation){ setAnnotationCommand(currentNode, &go::nodeProperty::moveAnnotation, annotation); }
+    void setNodeAnnotation(int annotation){ setAnnotationCommand(currentNode, &go::nodeProperty::nodeAnnotation, annotation); }
     void setBoardSize(int xsize, int ysize);
     void setMoveToClicked(bool moveMode = true){ moveToClicked = moveMode; }
     int  rotateBoard();
@@ -210,6 +249,7 @@ public:
     bool whiteFirst() const{ return goData.root->nextColor == go::white; }
 
     void createBoardBuffer();
+    void invalidateBoardBuffer(){ boardRoot.reset(); }  // board is changed outside of nodes, so it is created again
     QString toString(go::nodePtr node) const;
     QString getXString(int x) const;
     QString getXString(int x, bool showI) const;
@@ -219,6 +259,7 @@ public:
     void boardToSgfCoordinate(int boardX, int boardY, int& sgfX, int& sgfY);
     void sgfToBoardCoordinate(int sgfX, int sgfY, int& boardX, int& boardY);
     void reverseTerritory(int x, int y);
+    void setDeadStones(const QVector<go::point>& points);
 
     void playWithComputer(PlayGame* game);
     void autoReplay();
@@ -232,7 +273,7 @@ public slots:
 signals:
     void cleared();
     void nodeAdded(go::nodePtr parent, go::nodePtr node, bool select=false);
-    void nodeDeleted(go::nodePtr node, bool deleteChildren);
+    void nodeDeleted(go::nodePtr node, const go::nodeList& children);
     void nodeModified(go::nodePtr node);
     void currentNodeChanged(go::nodePtr node);
     void updateTerritory(int alive_b, int alive_w, int dead_b, int dead_w, int capturedBlack, int capturedWhite, int blackTerritory, int whiteTerritory, double komi);
@@ -258,7 +299,7 @@ protected:
     void drawCoordinates(QPainter& p, bool showCoordinates);
     void drawStonesAndMarkers(QPainter& p);
     void drawStones(QPainter& p);
-    void drawBranchMoves(QPainter& p, go::nodeList::iterator first, go::nodeList::iterator last);
+    void drawBranchMoves(QPainter& p, go::childList::iterator first, go::childList::iterator last);
     void drawCross(QPainter& p, const go::mark& mark);
     void drawTriangle(QPainter& p, const go::mark& mark);
     void drawCircle(QPainter& p, const go::mark& mark);
@@ -293,33 +334,41 @@ protected:
     void newPage(QPrinter& printer, QPainter& p, int& page, int& fig, int& moveNumberInPage);
 
     // buffer
+    void resetBoardBuffer();
+    void updateBoardBuffer();
+    void unwindBoardBuffer(go::nodePtr node);
+    void dropSnapshots(go::nodePtr node, bool childrenOnly=false);
+    void saveSnapshot(go::nodePtr node);
+    void restoreSnapshot(go::nodePtr node, int index);
+    void pushMove(go::nodePtr node);
+    void popMove();
     void putStone(go::nodePtr n, int moveNumber);
     void putDim(go::nodePtr node);
+    void putTerritories();
+    void removeTerritories();
     void removeDeadStones(int x, int y);
-    bool isDead(int* tmp, int c, int x, int y);
-    bool isDead(int x, int y);
-    bool isKill(int x, int y);
-    void dead(int* tmp);
+    void saveCell(int x, int y);
 
     // Score
+    void toggleTerritory(int x, int y);
     void setTerritory(int x, int y, int c);
     void unsetTerritory(int x, int y);
+    go::bitboard colorPlane(int any, int none = 0) const;
+    void setColor(const go::bitboard& area, int set, int unset);
     bool isDame(int x, int  y);
     bool isDame(int c, int x1, int  y1, int x2, int  y2);
 
     // Final Score
     void finalScore();
-    void whichTerritory(int x, int y, char* tmp, int& c);
     void getFinalScore(int& alive_b, int& alive_w, int& dead_b, int& dead_w, int& bt, int& wt);
     bool hasTerritory(int x1, int  y1, int x2, int  y2);
-    bool hasTerritory(go::color c1, go::color c2, char* tmp, int x, int  y);
 
     void setParent(go::nodePtr& parent, go::nodeList& childNodes);
     void createNodeList();
     void addMark(int sgfX, int sgfY, int boardX, int boardY, bool ctrl);
     void addMark(go::markList& markList, const go::mark& mark);
-    QString createMarkCharacter(go::markList& markList);
-    QString createMarkManually(go::markList& markList);
+    QString createMarkCharacter(const go::markList& markList);
+    QString createMarkManually(const go::markList& markList);
     bool removeMark(go::markList& markList, const go::point& p);
     bool removeStone(go::stoneList& stoneList, const go::point& sp, const go::point& bp);
     void rotateSgf(go::nodePtr node, QUndoCommand* command);
@@ -340,7 +389,9 @@ private:
 
     // data
     bool dirty;
+    int  edits;  // number of modifications, to know board is not modified while saving
     go::data goData;
+    go::journal journal_;  // edits not saved yet
     int capturedBlack;
     int capturedWhite;
     go::color color;
@@ -384,6 +435,40 @@ private:
     QList<int> xlines;
     QList<int> ylines;
     BoardBuffer board;
+    go::position position_;  // stones of board, to find captured groups
+
+    // points changed by node, to take it back from board
+    struct cellInfo{
+        cellInfo(){}
+        cellInfo(int x_, int y_, const stoneInfo& info_) : x(x_), y(y_), info(info_){}
+        int x;
+        int y;
+        stoneInfo info;
+    };
+    struct moveInfo{
+        go::nodePtr node;
+        go::color color;
+        int moveNumber;
+        int capturedBlack;
+        int capturedWhite;
+        QVector<cellInfo> cells;
+    };
+    QVector<moveInfo> moveStack;       // nodes on board after snapshot, to current node
+    QVector<cellInfo> territoryCells;  // points before territories of current node are put
+    moveInfo* recording;               // node which is put now
+    go::nodePtr boardRoot;             // root of nodes on board, NULL if board must be created again
+
+    // board after every BOARD_SNAPSHOT_INTERVAL nodes from root, to jump to far node
+    struct boardSnapshot{
+        BoardBuffer board;
+        go::color color;
+        int moveNumber;
+        int capturedBlack;
+        int capturedWhite;
+    };
+    QCache<go::node*, boardSnapshot> snapshots;
+    int stackBase;                     // number of nodes put by snapshot, before moveStack
+    go::nodePtr baseNode;              // last node put by snapshot
 
     // sound
     Sound stoneSound;
@@ -25,19 +25,31 @@
 AddNodeCommand::AddNodeCommand(BoardWidget* _boardWidget, go::nodePtr _parentNode, go::nodePtr _childNode, bool _select, QUndoCommand* parent)
     : QUndoCommand(parent)
     , boardWidget(_boardWidget)
+    , game(_boardWidget->getData().root)
     , parentNode(_parentNode)
     , childNode(_childNode)
     , select(_select)
+    , added(false)
 {
 }
 
+AddNodeCommand::~AddNodeCommand(){
+    // node which is not in tree is owned by this command.
+    if (!added)
+        game->arena()->release(childNode.get());
+}
+
 void AddNodeCommand::redo(){
     setText( tr("Add %1").arg( boardWidget->toString(childNode) ) );
     boardWidget->addNode(parentNode, childNode, select);
+    boardWidget->journal().insertNode(parentNode, parentNode->childNodes().size() - 1, childNode);
+    added = true;
 }
 
 void AddNodeCommand::undo(){
+    boardWidget->journal().deleteNode(childNode, true);
     boardWidget->deleteNode(childNode);
+    added = false;
 }
 
 /**
@@ -46,20 +58,31 @@ void AddNodeCommand::undo(){
 InsertNodeCommand::InsertNodeCommand(BoardWidget* _boardWidget, go::nodePtr _parentNode, int _index, go::nodePtr _childNode, bool _select, QUndoCommand* parent)
     : QUndoCommand(parent)
     , boardWidget(_boardWidget)
+    , game(_boardWidget->getData().root)
     , parentNode(_parentNode)
     , childNode(_childNode)
     , index(_index)
     , select(_select)
+    , inserted(false)
 {
 }
 
+InsertNodeCommand::~InsertNodeCommand(){
+    if (!inserted)
+        game->arena()->release(childNode.get());
+}
+
 void InsertNodeCommand::redo(){
     setText( tr("Insert %1").arg( boardWidget->toString(childNode) ) );
     boardWidget->insertNode(parentNode, index, childNode, select);
+    boardWidget->journal().insertNode(parentNode, index, childNode);
+    inserted = true;
 }
 
 void InsertNodeCommand::undo(){
+    boardWidget->journal().deleteNode(childNode, false);
     boardWidget->deleteNode(childNode, false);
+    inserted = false;
 }
 
 /**
@@ -68,33 +91,45 @@ void InsertNodeCommand::undo(){
 DeleteNodeCommand::DeleteNodeCommand(BoardWidget* _boardWidget, go::nodePtr _node, bool _deleteChildren, QUndoCommand* parent)
     : QUndoCommand(parent)
     , boardWidget(_boardWidget)
+    , game(_boardWidget->getData().root)
     , node(_node)
     , deleteChildren(_deleteChildren)
+    , index(0)
+    , childCount(0)
+    , deleted(false)
 {
 }
 
+DeleteNodeCommand::~DeleteNodeCommand(){
+    if (deleted)
+        game->arena()->release(node.get());
+}
+
 void DeleteNodeCommand::redo(){
     setText( tr("Delete %1").arg( boardWidget->toString(node) ) );
 
-    go::nodeList::iterator beg = node->parent()->childNodes.begin();
-    go::nodeList::iterator del = qFind(node->parent()->childNodes.begin(), node->parent()->childNodes.end(), node);
-    index = std::distance(beg, del);
+    index = node->parent()->childNodes().indexOf(node);
+    childCount = node->childNodes().size();
 
+    boardWidget->journal().deleteNode(node, deleteChildren);
     boardWidget->deleteNode(node, deleteChildren);
+    deleted = true;
 }
 
 void DeleteNodeCommand::undo(){
+    go::nodePtr parent = node->parent();
     if (!deleteChildren){
-        for (int i=0; i<node->childNodes.size(); ++i)
-            node->parent()->childNodes.removeAt(index + i);
-
-        go::nodeList::iterator iter = node->childNodes.begin();
-        while (iter != node->childNodes.end()){
-            (*iter)->parent_ = node;
-            ++iter;
-        }
+        // children were moved to index of parent.
+        for (int i=0; i<childCount; ++i)
+            node->childNodes().push_back( parent->childNodes().takeAt(index) );
     }
-    boardWidget->insertNode(node->parent(), index, node);
+    boardWidget->insertNode(parent, index, node);
+    deleted = false;
+
+    if (deleteChildren)
+        boardWidget->journal().insertNode(parent, index, node);
+    else
+        boardWidget->journal().groupNodes(parent, index, node);
 }
 
 /**
@@ -119,27 +154,27 @@ void AddStoneCommand::redo(){
     }
 */
 
-    go::nodePtr stoneNode( node->isStone() ? go::nodePtr(new go::node(node)) : node );
-
     if (color == go::black)
-        node->blackStones.push_back( go::stone(x, y, color) );
+        node->editBlackStones().push_back( go::stone(x, y, color) );
     else if (color == go::white)
-        node->whiteStones.push_back( go::stone(x, y, color) );
+        node->editWhiteStones().push_back( go::stone(x, y, color) );
     else
-        node->emptyStones.push_back( go::stone(x, y, color) );
+        node->editEmptyStones().push_back( go::stone(x, y, color) );
 
-    boardWidget->modifyNode(node, true);
+    boardWidget->modifyNode(node, BoardWidget::eStoneChange);
+    boardWidget->journal().setNode(node);
 }
 
 void AddStoneCommand::undo(){
     if (color == go::black)
-        node->blackStones.pop_back();
+        node->editBlackStones().pop_back();
     else if (color == go::white)
-        node->whiteStones.pop_back();
+        node->editWhiteStones().pop_back();
     else
-        node->emptyStones.pop_back();
+        node->editEmptyStones().pop_back();
 
-    boardWidget->modifyNode(node, true);
+    boardWidget->modifyNode(node, BoardWidget::eStoneChange);
+    boardWidget->journal().setNode(node);
 }
 
 /**
@@ -156,19 +191,21 @@ DeleteStoneCommand::DeleteStoneCommand(BoardWidget* _boardWidget, go::nodePtr _n
 void DeleteStoneCommand::redo(){
     setText( tr("Delete Stone") );
 
-    remove(node->blackStones, blackEraseList, blackPosList);
-    remove(node->whiteStones, whiteEraseList, whitePosList);
-    remove(node->emptyStones, emptyEraseList, emptyPosList);
+    remove(node->editBlackStones(), blackEraseList, blackPosList);
+    remove(node->editWhiteStones(), whiteEraseList, whitePosList);
+    remove(node->editEmptyStones(), emptyEraseList, emptyPosList);
 
-    boardWidget->modifyNode(node, true);
+    boardWidget->modifyNode(node, BoardWidget::eStoneChange);
+    boardWidget->journal().setNode(node);
 }
 
 void DeleteStoneCommand::undo(){
-    add(node->blackStones, blackEraseList, blackPosList);
-    add(node->whiteStones, whiteEraseList, whitePosList);
-    add(node->emptyStones, emptyEraseList, emptyPosList);
+    add(node->editBlackStones(), blackEraseList, blackPosList);
+    add(node->editWhiteStones(), whiteEraseList, whitePosList);
+    add(node->editEmptyStones(), emptyEraseList, emptyPosList);
 
-    boardWidget->modifyNode(node, true);
+    boardWidget->modifyNode(node, BoardWidget::eStoneChange);
+    boardWidget->journal().setNode(node);
 }
 
 void DeleteStoneCommand::add(go::stoneList& stones, go::stoneList& eraseList, QList<int>& posList){
@@ -223,14 +260,15 @@ void AddMarkCommand::redo(){
 
     bool removeMark = false;
     go::point p(x, y);
-    for (int i=0; i<node->marks.size();){
-        const go::mark& mark = node->marks[i];
+    go::markList& marks = node->editMarks();
+    for (int i=0; i<marks.size();){
+        const go::mark& mark = marks[i];
         if (mark.p == p){
             if (mark.t == type)
                 removeMark = true;
             eraseList.push_back(mark);
             erasePos.push_back(i);
-            node->marks.removeAt(i);
+            marks.removeAt(i);
         }
         else
             ++i;
@@ -238,24 +276,26 @@ void AddMarkCommand::redo(){
 
     if (removeMark == false){
         if (type == go::mark::eCharacter)
-            node->marks.push_back( go::mark(p, label) );
+            marks.push_back( go::mark(p, label) );
         else
-            node->marks.push_back( go::mark(p, type) );
+            marks.push_back( go::mark(p, type) );
         markAdded = true;
     }
     boardWidget->modifyNode(node);
+    boardWidget->journal().setNode(node);
 }
 
 void AddMarkCommand::undo(){
     if (markAdded)
-        node->marks.pop_back();
+        node->editMarks().pop_back();
 
     int i = 0;
     foreach(const go::mark& m, eraseList){
         int pos = erasePos[i];
-        node->marks.insert(pos, m);
+        node->editMarks().insert(pos, m);
     }
     boardWidget->modifyNode(node);
+    boardWidget->journal().setNode(node);
 }
 
 /**
@@ -282,21 +322,23 @@ void DeleteMarkCommand::redo(){
     whiteEraseList.clear();
     whitePosList.clear();
 
-    remove(node->marks, markEraseList, markPosList);
-    remove(node->emptyStones, emptyEraseList, emptyPosList);
-    remove(node->blackStones, blackEraseList, blackPosList);
-    remove(node->whiteStones, whiteEraseList, whitePosList);
+    remove(node->editMarks(), markEraseList, markPosList);
+    remove(node->editEmptyStones(), emptyEraseList, emptyPosList);
+    remove(node->editBlackStones(), blackEraseList, blackPosList);
+    remove(node->editWhiteStones(), whiteEraseList, whitePosList);
 
-    boardWidget->modifyNode(node, true);
+    boardWidget->modifyNode(node, BoardWidget::eStoneChange);
+    boardWidget->journal().setNode(node);
 }
 
 void DeleteMarkCommand::undo(){
-    add(node->marks, markEraseList, markPosList);
-    add(node->emptyStones, emptyEraseList, emptyPosList);
-    add(node->blackStones, blackEraseList, blackPosList);
-    add(node->whiteStones, whiteEraseList, whitePosList);
+    add(node->editMarks(), markEraseList, markPosList);
+    add(node->editEmptyStones(), emptyEraseList, emptyPosList);
+    add(node->editBlackStones(), blackEraseList, blackPosList);
+    add(node->editWhiteStones(), whiteEraseList, whitePosList);
 
-    boardWidget->modifyNode(node, true);
+    boardWidget->modifyNode(node, BoardWidget::eStoneChange);
+    boardWidget->journal().setNode(node);
 }
 
 template<class Container, class EraseList, class PosList>
@@ -341,12 +383,14 @@ SetMoveNumberCommand::SetMoveNumberCommand(BoardWidget* _boardWidget, go::nodePt
 void SetMoveNumberCommand::redo(){
     setText( tr("Set Move Number %1").arg( boardWidget->toString(node) ) );
     node->moveNumber = moveNumber;
-    boardWidget->modifyNode(node);
+    boardWidget->modifyNode(node, BoardWidget::eNumberChange);
+    boardWidget->journal().setNode(node);
 }
 
 void SetMoveNumberCommand::undo(){
     node->moveNumber = oldMoveNumber;
-    boardWidget->modifyNode(node);
+    boardWidget->modifyNode(node, BoardWidget::eNumberChange);
+    boardWidget->journal().setNode(node);
 }
 
 UnsetMoveNumberCommand::UnsetMoveNumberCommand(BoardWidget* _boardWidget, go::nodePtr _node, QUndoCommand* parent)
@@ -360,12 +404,14 @@ UnsetMoveNumberCommand::UnsetMoveNumberCommand(BoardWidget* _boardWidget, go::no
 void UnsetMoveNumberCommand::redo(){
     setText( QString(tr("Unset Move Number %1")).arg( boardWidget->toString(node) ) );
     node->moveNumber = -1;
-    boardWidget->modifyNode(node);
+    boardWidget->modifyNode(node, BoardWidget::eNumberChange);
+    boardWidget->journal().setNode(node);
 }
 
 void UnsetMoveNumberCommand::undo(){
     node->moveNumber = oldMoveNumber;
-    boardWidget->modifyNode(node);
+    boardWidget->modifyNode(node, BoardWidget::eNumberChange);
+    boardWidget->journal().setNode(node);
 }
 
 SetNodeNameCommand::SetNodeNameCommand(BoardWidget* _boardWidget, go::nodePtr _node, const QString& _nodeName, QUndoCommand* parent)
@@ -374,18 +420,20 @@ SetNodeNameCommand::SetNodeNameCommand(BoardWidget* _boardWidget, go::nodePtr _n
     , node(_node)
     , nodeName(_nodeName)
 {
-    oldNodeName = node->name;
+    oldNodeName = node->name();
 }
 
 void SetNodeNameCommand::redo(){
     setText( tr("Set Node Name %1").arg( boardWidget->toString(node) ) );
-    node->name = nodeName;
+    node->setName(nodeName);
     boardWidget->modifyNode(node);
+    boardWidget->journal().setNode(node);
 }
 
 void SetNodeNameCommand::undo(){
-    node->name = oldNodeName;
+    node->setName(oldNodeName);
     boardWidget->modifyNode(node);
+    boardWidget->journal().setNode(node);
 }
 
 SetCommentCommand::SetCommentCommand(BoardWidget* _boardWidget, go::nodePtr _node, const QString& _comment, QUndoCommand* parent)
@@ -394,18 +442,55 @@ SetCommentCommand::SetCommentCommand(BoardWidget* _boardWidget, go::nodePtr _nod
     , node(_node)
     , comment(_comment)
 {
-    oldComment = node->comment;
+    oldComment = node->comment();
 }
 
 void SetCommentCommand::redo(){
     setText( tr("Set Comment %1").arg( boardWidget->toString(node) ) );
-    node->comment = comment;
+    node->setComment(comment);
     boardWidget->modifyNode(node);
+    boardWidget->journal().setNode(node);
 }
 
 void SetCommentCommand::undo(){
-    node->comment = oldComment;
+    node->setComment(oldComment);
+    boardWidget->modifyNode(node);
+    boardWidget->journal().setNode(node);
+}
+
+/**
+* comment is set for each typed character, so edits of same node are undone at once.
+*/
+bool SetCommentCommand::mergeWith(const QUndoCommand* other){
+    const SetCommentCommand* command = static_cast<const SetCommentCommand*>(other);
+    if (command->node != node)
+        return false;
+
+    comment = command->comment;
+    return true;
+}
+
+SetAnnotationCommand::SetAnnotationCommand(BoardWidget* _boardWidget, go::nodePtr _node, quint8 go::nodeProperty::* _member, int _annotation, QUndoCommand* parent)
+    : QUndoCommand(parent)
+    , boardWidget(_boardWidget)
+    , node(_node)
+    , member(_member)
+    , annotation(_annotation)
+{
+    oldAnnotation = node->property()->*member;
+}
+
+void SetAnnotationCommand::redo(){
+    setText( tr("Set Annotation %1").arg( boardWidget->toString(node) ) );
+    node->editProperty()->*member = annotation;
+    boardWidget->modifyNode(node);
+    boardWidget->journal().setNode(node);
+}
+
+void SetAnnotationCommand::undo(){
+    node->editProperty()->*member = oldAnnotation;
     boardWidget->modifyNode(node);
+    boardWidget->journal().setNode(node);
 }
 
 MovePositionCommand::MovePositionCommand(BoardWidget* _boardWidget, go::nodePtr _node, const go::point& _pos, QUndoCommand* parent)
@@ -414,18 +499,16 @@ MovePositionCommand::MovePositionCommand(BoardWidget* _boardWidget, go::nodePtr
     , node(_node)
     , pos(_pos)
 {
-    oldPos = node->position;
+    oldPos = node->position();
 }
 
 void MovePositionCommand::redo(){
     setText( tr("Move Position %1").arg( boardWidget->toString(node) ) );
-    node->position.x = pos.x;
-    node->position.y = pos.y;
+    node->setPosition(pos);
 }
 
 void MovePositionCommand::undo(){
-    node->position.x = oldPos.x;
-    node->position.y = oldPos.y;
+    node->setPosition(oldPos);
 }
 
 MoveStoneCommand::MoveStoneCommand(BoardWidget* _boardWidget, go::nodePtr _node, go::stone* _stone, const go::point& _pos, QUndoCommand* parent)
@@ -469,13 +552,18 @@ void MoveMarkCommand::undo(){
 RotateSgfCommand::RotateSgfCommand(BoardWidget* _boardWidget, const QString& _commandName, QUndoCommand* parent)
     : QUndoCommand(parent)
     , boardWidget(_boardWidget)
+    , root(boardWidget->getData().root)
     , commandName(_commandName)
 {
 }
 
+/**
+* child commands move stones of every node, and they are written as one record.
+*/
 void RotateSgfCommand::redo(){
     QUndoCommand::redo();
     setText(commandName);
+    boardWidget->journal().setTree(root);
 
     boardWidget->createBoardBuffer();
     boardWidget->paintBoard();
@@ -483,6 +571,7 @@ void RotateSgfCommand::redo(){
 
 void RotateSgfCommand::undo(){
     QUndoCommand::undo();
+    boardWidget->journal().setTree(root);
     boardWidget->createBoardBuffer();
     boardWidget->paintBoard();
 }
@@ -31,14 +31,17 @@ class AddNodeCommand : public QUndoCommand{
 
 public:
     AddNodeCommand(BoardWidget* boardWidget, go::nodePtr parentNode, go::nodePtr childNode, bool select, QUndoCommand *parent = 0);
+    virtual ~AddNodeCommand();
     virtual void redo();
     virtual void undo();
 
 private:
     BoardWidget* boardWidget;
+    go::informationPtr game;
     go::nodePtr parentNode;
     go::nodePtr childNode;
     bool select;
+    bool added;
 };
 
 class InsertNodeCommand : public QUndoCommand{
@@ -46,15 +49,18 @@ class InsertNodeCommand : public QUndoCommand{
 
 public:
     InsertNodeCommand(BoardWidget* boardWidget, go::nodePtr parentNode, int index, go::nodePtr childNode, bool select, QUndoCommand *parent = 0);
+    virtual ~InsertNodeCommand();
     virtual void redo();
     virtual void undo();
 
 private:
     BoardWidget* boardWidget;
+    go::informationPtr game;
     go::nodePtr parentNode;
     go::nodePtr childNode;
     int  index;
     bool select;
+    bool inserted;
 };
 
 class DeleteNodeCommand : public QUndoCommand{
@@ -62,14 +68,18 @@ class DeleteNodeCommand : public QUndoCommand{
 
 public:
     DeleteNodeCommand(BoardWidget* boardWidget, go::nodePtr node, bool deleteChildren, QUndoCommand *parent = 0);
+    virtual ~DeleteNodeCommand();
     virtual void redo();
     virtual void undo();
 
 private:
     BoardWidget* boardWidget;
+    go::informationPtr game;
     go::nodePtr node;
     bool deleteChildren;
     int  index;
+    int  childCount;   // number of children moved to parent
+    bool deleted;
 };
 
 class AddStoneCommand : public QUndoCommand{
@@ -212,6 +222,8 @@ public:
     SetCommentCommand(BoardWidget* boardWidget, go::nodePtr node, const QString& comment, QUndoCommand *parent = 0);
     virtual void redo();
     virtual void undo();
+    virtual int  id() const{ return 1; }
+    virtual bool mergeWith(const QUndoCommand* other);
 
 private:
     BoardWidget* boardWidget;
@@ -220,6 +232,22 @@ private:
     QString oldComment;
 };
 
+class SetAnnotationCommand : public QUndoCommand{
+    Q_DECLARE_TR_FUNCTIONS(SetAnnotationCommand)
+
+public:
+    SetAnnotationCommand(BoardWidget* boardWidget, go::nodePtr node, quint8 go::nodeProperty::* member, int annotation, QUndoCommand *parent = 0);
+    virtual void redo();
+    virtual void undo();
+
+private:
+    BoardWidget* boardWidget;
+    go::nodePtr node;
+    quint8 go::nodeProperty::* member;
+    quint8 annotation;
+    quint8 oldAnnotation;
+};
+
 class MovePositionCommand : public QUndoCommand{
     Q_DECLARE_TR_FUNCTIONS(MovePositionCommand)
 
@@ -275,6 +303,7 @@ public:
 
 private:
     BoardWidget* boardWidget;
+    go::nodePtr root;
     QString commandName;
 };
 
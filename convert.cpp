@@ -0,0 +1,213 @@
+/*
+    mugo, sgf editor.
+    Copyright (C) 2009-2010 nsase.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <stdio.h>
+#include <QCoreApplication>
+#include <QStringList>
+#include <QFileInfo>
+#include <QDir>
+#include <QDirIterator>
+#include <QHash>
+#include <QTime>
+#include <QThreadPool>
+#include <QtConcurrentMap>
+#include "appdef.h"
+#include "sgf.h"
+#include "readers.h"
+
+/**
+* mugo-convert, converts ugf, gib and ngf files to sgf without gui.
+*/
+
+static void usage(){
+    fprintf(stderr,
+        "usage: mugo-convert [options] file|directory|pattern...\n"
+        "  -o dir    output directory (default: same directory as input)\n"
+        "  -c codec  codec of sgf (default: UTF-8)\n"
+        "  -i codec  codec of input which has no encoding information (default: locale)\n"
+        "  -j n      number of threads\n"
+        "  -f        overwrite existing files\n");
+}
+
+/**
+* ignore debug messages of readers, output of each file is reported by converter.
+*/
+static void messageHandler(QtMsgType type, const char* msg){
+    if (type != QtDebugMsg)
+        fprintf(stderr, "%s\n", msg);
+}
+
+/**
+* add files of argument, which is file, directory or wildcard pattern.
+*/
+static void addFiles(const QString& arg, QStringList& files){
+    static const QStringList filters = QStringList() << "*.ugf" << "*.ugi" << "*.gib" << "*.ngf";
+
+    QFileInfo fi(arg);
+    if (fi.isDir()){
+        QDirIterator iter(arg, filters, QDir::Files, QDirIterator::Subdirectories);
+        while (iter.hasNext())
+            files.push_back( iter.next() );
+    }
+    else if (arg.contains('*') || arg.contains('?')){
+        QDir dir = fi.dir();
+        foreach(const QString& name, dir.entryList(QStringList(fi.fileName()), QDir::Files))
+            files.push_back( dir.filePath(name) );
+    }
+    else
+        files.push_back(arg);
+}
+
+/**
+* convert one file, returns error message or empty string.
+*/
+class converter{
+public:
+    typedef QString result_type;
+
+    converter() : codec(NULL), inputCodec(NULL), overwrite(false){}
+
+    QString operator()(const QString& fname) const{
+        QTextCodec* readCodec = inputCodec;
+        go::fileBase* reader = go::readFile(fname, readCodec, true);
+        if (reader == NULL)
+            return "can't read";
+
+        go::data data;
+        bool ret = reader->get(data);
+        delete reader;
+        if (!ret)
+            return "can't read";
+
+        QString out = outputName(fname);
+        if (!overwrite && QFile::exists(out))
+            return out + " already exists";
+
+        go::sgf writer;
+        writer.set(data);
+        if (!writer.save(out, codec))
+            return "can't write " + out;
+
+        return QString();
+    }
+
+    /**
+    * returns sgf file name of input file.
+    */
+    QString outputName(const QString& fname) const{
+        QFileInfo fi(fname);
+        QDir dir = outputDir.isEmpty() ? fi.dir() : QDir(outputDir);
+        return dir.filePath(fi.completeBaseName() + ".sgf");
+    }
+
+    QTextCodec* codec;
+    QTextCodec* inputCodec;
+    QString outputDir;
+    bool overwrite;
+};
+
+
+int main(int argc, char** argv){
+    QCoreApplication app(argc, argv);
+    qInstallMsgHandler(messageHandler);
+
+    converter convert;
+    convert.codec = QTextCodec::codecForName("UTF-8");
+    convert.inputCodec = QTextCodec::codecForLocale();
+
+    QStringList args = app.arguments();
+    QStringList files;
+    for (int i=1; i<args.size(); ++i){
+        const QString& arg = args[i];
+        bool hasValue = i + 1 < args.size();
+        if (arg == "-o" && hasValue)
+            convert.outputDir = args[++i];
+        else if (arg == "-c" && hasValue)
+            convert.codec = QTextCodec::codecForName( args[++i].toAscii() );
+        else if (arg == "-i" && hasValue)
+            convert.inputCodec = QTextCodec::codecForName( args[++i].toAscii() );
+        else if (arg == "-j" && hasValue)
+            QThreadPool::globalInstance()->setMaxThreadCount( qMax(1, args[++i].toInt()) );
+        else if (arg == "-f")
+            convert.overwrite = true;
+        else if (arg.startsWith('-')){
+            usage();
+            return 2;
+        }
+        else
+            addFiles(arg, files);
+    }
+
+    if (files.empty() || convert.codec == NULL || convert.inputCodec == NULL){
+        usage();
+        return 2;
+    }
+    if (!convert.outputDir.isEmpty())
+        QDir().mkpath(convert.outputDir);
+
+    // codecs used by readers are created before threads start.
+    const char* const codecs[] = { "Shift_JIS", "Big5", "EUC_KR", "UTF-8", "UTF-16" };
+    for (size_t i=0; i<sizeof(codecs)/sizeof(codecs[0]); ++i)
+        QTextCodec::codecForName(codecs[i]);
+
+    QTime time;
+    time.start();
+
+    // files which have same output name, such as a.gib and a.ugf, would race on checking and writing it.
+    // only first of them is converted, and others are failed before threads start.
+    QList<QString> errors;
+    QStringList targets;
+    QHash<QString, QString> outputs;
+    foreach(const QString& fname, files){
+        QString out = convert.outputName(fname);
+        QString key = QFileInfo(out).absoluteFilePath();
+#if defined(Q_OS_WIN) || defined(Q_OS_MAC)
+        key = key.toLower();
+#endif
+        QHash<QString, QString>::const_iterator iter = outputs.find(key);
+        if (iter != outputs.end())
+            errors.push_back( out + " is also output of " + iter.value() );
+        else{
+            outputs.insert(key, fname);
+            targets.push_back(fname);
+            errors.push_back( QString() );
+        }
+    }
+
+    QList<QString> results = QtConcurrent::blockingMapped(targets, convert);
+    for (int i=0, j=0; i<files.size(); ++i){
+        if (errors[i].isEmpty())
+            errors[i] = results[j++];
+    }
+
+    int failed = 0;
+    qint64 bytes = 0;
+    for (int i=0; i<files.size(); ++i){
+        if (errors[i].isEmpty())
+            bytes += QFileInfo(files[i]).size();
+        else{
+            fprintf(stderr, "%s: %s\n", qPrintable(files[i]), qPrintable(errors[i]));
+            ++failed;
+        }
+    }
+
+    double sec = qMax(time.elapsed(), 1) / 1000.0;
+    fprintf(stderr, "%d files converted, %d failed in %.2f sec (%.1f files/sec, %.2f MB/sec)\n",
+        files.size() - failed, failed, sec, (files.size() - failed) / sec, bytes / sec / (1024 * 1024));
+
+    return failed == 0 ? 0 : 1;
+}
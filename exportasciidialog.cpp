@@ -79,19 +79,19 @@ void ExportAsciiDialog::createEnglishAscii(){
     m_ui->asciiTextEdit->setFont(f);
 
     QByteArray s;
-    s.reserve(boardBuffer.size() + 2 * boardBuffer[0].size() * 3);
+    s.reserve(boardBuffer.ysize() + 2 * boardBuffer.xsize() * 3);
 
     s.append("  ");
-    for (int i=0; i<boardBuffer[0].size(); ++i){
+    for (int i=0; i<boardBuffer.xsize(); ++i){
         s.push_back(' ');
         s.push_back( 'A' + (i > 7 ? i+1 : i) );
     }
     s.push_back('\n');
 
-    for (int y=0; y<boardBuffer.size(); ++y){
-        s.append( QString("%1").arg(boardBuffer.size() - y, 2) );
+    for (int y=0; y<boardBuffer.ysize(); ++y){
+        s.append( QString("%1").arg(boardBuffer.ysize() - y, 2) );
 
-        for (int x=0; x<boardBuffer[y].size(); ++x){
+        for (int x=0; x<boardBuffer.xsize(); ++x){
             if (boardBuffer[y][x].black())
                 s.append(" #");
             else if (boardBuffer[y][x].white())
@@ -102,11 +102,11 @@ void ExportAsciiDialog::createEnglishAscii(){
                 s.append(" .");
         }
 
-        s.append( QString(" %1\n").arg(boardBuffer.size() - y, 2) );
+        s.append( QString(" %1\n").arg(boardBuffer.ysize() - y, 2) );
     }
 
     s.append("  ");
-    for (int i=0; i<boardBuffer[0].size(); ++i){
+    for (int i=0; i<boardBuffer.xsize(); ++i){
         s.push_back(' ');
         s.push_back( 'A' + (i > 7 ? i+1 : i) );
     }
@@ -131,7 +131,7 @@ void ExportAsciiDialog::createJapaneseAscii(bool isMono){
 qDebug() << f.family();
 
     QByteArray s;
-    s.reserve(boardBuffer.size() + 2 * boardBuffer[0].size() * 3);
+    s.reserve(boardBuffer.ysize() + 2 * boardBuffer.xsize() * 3);
 
     const char* top[]    = {"\xe2\x94\x8f","\xe2\x94\xaf","\xe2\x94\x93"};
     const char* center[] = {"\xe2\x94\xa0","\xe2\x94\xbc","\xe2\x94\xa8"};
@@ -145,7 +145,7 @@ qDebug() << f.family();
     else
         s.append("\xef\xbc\xbf");
 
-    for (int i=0, j=0; i<boardBuffer[0].size(); ++i, ++j){
+    for (int i=0, j=0; i<boardBuffer.xsize(); ++i, ++j){
         if (j >= headerNum)
             j = 0;
         s.push_back( header[j] );
@@ -155,15 +155,15 @@ qDebug() << f.family();
 
     s.push_back('\n');
 
-    for (int y=0; y<boardBuffer.size(); ++y){
+    for (int y=0; y<boardBuffer.ysize(); ++y){
         if (isMono)
-            s.append( QString().sprintf("%2d", boardBuffer.size() - y) );
+            s.append( QString().sprintf("%2d", boardBuffer.ysize() - y) );
         else
-            s.append( QString().sprintf("%02d", boardBuffer.size() - y) );
+            s.append( QString().sprintf("%02d", boardBuffer.ysize() - y) );
 
-        const char** b = y == 0 ? top : y == boardBuffer.size() - 1 ? bottom : center;
+        const char** b = y == 0 ? top : y == boardBuffer.ysize() - 1 ? bottom : center;
 
-        for (int x=0; x<boardBuffer[y].size(); ++x){
+        for (int x=0; x<boardBuffer.xsize(); ++x){
             if (boardBuffer[y][x].black())
                 s.append("\xe2\x97\x8f");
             else if (boardBuffer[y][x].white())
@@ -171,7 +171,7 @@ qDebug() << f.family();
             else{
                 if (x == 0)
                     s.append(b[0]);
-                else if (x == boardBuffer[y].size() - 1)
+                else if (x == boardBuffer.xsize() - 1)
                     s.append(b[2]);
                 else if (isStar(x, y))
                     s.append("\xe2\x95\x8b");
@@ -181,9 +181,9 @@ qDebug() << f.family();
         }
 
         if (isMono)
-            s.append( QString().sprintf("%2d\n", boardBuffer.size() - y) );
+            s.append( QString().sprintf("%2d\n", boardBuffer.ysize() - y) );
         else
-            s.append( QString().sprintf("%02d\n", boardBuffer.size() - y) );
+            s.append( QString().sprintf("%02d\n", boardBuffer.ysize() - y) );
     }
 
     // 2byte space
@@ -192,7 +192,7 @@ qDebug() << f.family();
     else
         s.append("\xef\xbc\xbf");
 
-    for (int i=0, j=0; i<boardBuffer[0].size(); ++i, ++j){
+    for (int i=0, j=0; i<boardBuffer.xsize(); ++i, ++j){
         if (j >= headerNum)
             j = 0;
         s.push_back( header[j] );
@@ -204,8 +204,8 @@ qDebug() << f.family();
 }
 
 bool ExportAsciiDialog::isStar(int x, int y){
-    int  ysize = boardBuffer.size();
-    int  xsize = boardBuffer[0].size();
+    int  ysize = boardBuffer.ysize();
+    int  xsize = boardBuffer.xsize();
     return isStar2(xsize, x) && isStar2(ysize, y);
 }
 
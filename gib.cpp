@@ -24,14 +24,14 @@ namespace go{
 
 
 
-bool gib::readStream(QString::iterator& first, QString::iterator last){
+bool gib::readText(textReader& reader){
 //    dataList_.push_back( data() );
-    while (first != last){
-        QString s = readLine(first, last);
+    while (!reader.atEnd()){
+        QString s = reader.readLine();
         if (s == "\\HS")
-            readHeader(first, last);
+            readHeader(reader);
         else if (s == "\\GS")
-            readGame(first, last);
+            readGame(reader);
     }
 
     return true;
@@ -41,6 +41,18 @@ bool gib::saveStream(QTextStream& /*stream*/){
     return false;
 }
 
+/**
+* returns confidence (0-100) that head of file is gib.
+*/
+int gib::probe(const QByteArray& head){
+    if (head.mid(headStart(head), 3) == "\\HS")
+        return 100;
+    else if (head.contains("\\HS") && head.contains("\\["))
+        return 60;
+    else
+        return 0;
+}
+
 QTextCodec* gib::getCodec(const QByteArray& a) const{
     int p = a.indexOf("\\[GIBOKIND=");
     if (p == -1)
@@ -73,7 +85,7 @@ bool gib::get(go::data& data) const{
     data.root->whiteRank   = whiteRank;
     data.root->blackPlayer = blackPlayer;
     data.root->blackRank   = blackRank;
-    data.root->comment     = comment;
+    data.root->setComment( comment );
     data.root->place       = place;
     data.root->date        = gameDate;
     data.root->gameName    = gameName;
@@ -85,11 +97,11 @@ bool gib::get(go::data& data) const{
     data.root->handicap = handicap;
     for (int i=0; i<handicap; ++i){
         if (handicap < 6)
-            data.root->blackStones.push_back( stone(hcapx1[i], hcapy1[i], go::black) );
+            data.root->editBlackStones().push_back( stone(hcapx1[i], hcapy1[i], go::black) );
         else if (handicap < 8)
-            data.root->blackStones.push_back( stone(hcapx2[i], hcapy2[i], go::black) );
+            data.root->editBlackStones().push_back( stone(hcapx2[i], hcapy2[i], go::black) );
         else
-            data.root->blackStones.push_back( stone(hcapx3[i], hcapy3[i], go::black) );
+            data.root->editBlackStones().push_back( stone(hcapx3[i], hcapy3[i], go::black) );
     }
     get(dataList_.begin(), dataList_.end(), go::nodePtr(data.root));
     return true;
@@ -99,29 +111,32 @@ bool gib::set(const go::data& /*data*/){
     return false;
 }
 
+/**
+* append moves to parent as one line.
+*/
 bool gib::get(dataList::const_iterator first, dataList::const_iterator last, go::nodePtr parent) const{
-    if (first == last)
-        return true;
-
-    nodePtr node;
-    if (first->color == go::black)
-        node = go::createBlackNode(parent, first->x, first->y);
-    else if (first->color == go::white)
-        node = go::createWhiteNode(parent, first->x, first->y);
-    else
-        node.reset(new go::node(parent));
-
-    parent->childNodes.push_back(node);
+    parent->arena()->reserve( parent->arena()->size() + (last - first) );
+
+    for (; first != last; ++first){
+        nodePtr node;
+        if (first->color == go::black)
+            node = go::createBlackNode(parent, first->x, first->y);
+        else if (first->color == go::white)
+            node = go::createWhiteNode(parent, first->x, first->y);
+        else
+            node = go::createNode(parent);
 
-    get(++first, last, node);
+        parent->childNodes().push_back(node);
+        parent = node;
+    }
 
     return true;
 }
 
-bool gib::readHeader(QString::iterator& first, QString::iterator& last){
+bool gib::readHeader(textReader& reader){
     QString str;
-    while (first != last){
-        str.append( readLine(first, last) );
+    while (!reader.atEnd()){
+        str.append( reader.readLine() );
         if (str == "\\HE")
             return true;
 
@@ -165,10 +180,10 @@ bool gib::readHeader(QString::iterator& first, QString::iterator& last){
     return false;
 }
 
-bool gib::readGame(QString::iterator& first, QString::iterator& last){
+bool gib::readGame(textReader& reader){
     QString str;
-    while (first != last){
-        str = readLine(first, last);
+    while (!reader.atEnd()){
+        str = reader.readLine();
         if (str == "\\GE")
             return true;
         QStringList list = str.split(' ');
@@ -43,9 +43,10 @@ public:
 
     gib() : handicap(0){}
 
-    virtual bool readStream(QString::iterator& first, QString::iterator last);
+    virtual bool readText(textReader& reader);
     virtual bool saveStream(QTextStream& stream);
     virtual QTextCodec* getCodec(const QByteArray&) const;
+    static int probe(const QByteArray& head);
 
     virtual bool get(go::data& data) const;
     virtual bool set(const go::data& data);
@@ -53,8 +54,8 @@ public:
 private:
     bool get(dataList::const_iterator first, dataList::const_iterator last, go::nodePtr parent) const;
 
-    bool readHeader(QString::iterator& first, QString::iterator& last);
-    bool readGame(QString::iterator& first, QString::iterator& last);
+    bool readHeader(textReader& reader);
+    bool readGame(textReader& reader);
 
     bool readINI(int handicap);
     bool readSTO(int x, int y, int color);
@@ -15,22 +15,41 @@
     You should have received a copy of the GNU General Public License
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
+#include <new>
+#include <stdio.h>
+#include <ctype.h>
 #include <QDebug>
+#include <QFileInfo>
+#include <QTemporaryFile>
+#include <QTextDecoder>
+#include <QtConcurrentMap>
 #include "appdef.h"
 #include "godata.h"
 
+#ifdef Q_OS_WIN
+#include <qt_windows.h>
+#include <io.h>
+#else
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/stat.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  define GODATA_USE_SSE2
+#  include <emmintrin.h>
+#endif
+
 
 namespace go{
 
-const informationNode* infomation(const node* node){
-    while (node->parent()){
-        node = node->parent().get();
-    }
-    return (informationNode*)node;
+nodePtr createNode(nodePtr parent){
+    return nodePtr( parent->arena()->create( parent->index() ) );
 }
 
 nodePtr createBlackNode(nodePtr parent){
-    nodePtr newNode( new node(parent) );
+    nodePtr newNode( createNode(parent) );
     newNode->setColor(go::black);
     return newNode;
 }
@@ -43,7 +62,7 @@ nodePtr createBlackNode(nodePtr parent, int x, int y){
 }
 
 nodePtr createWhiteNode(nodePtr parent){
-    nodePtr newNode( new node(parent) );
+    nodePtr newNode( createNode(parent) );
     newNode->setColor(go::white);
     return newNode;
 }
@@ -57,35 +76,276 @@ nodePtr createWhiteNode(nodePtr parent, int x, int y){
 
 
 
-node::node()
-    : annotation(eNoAnnotation)
-    , moveAnnotation(eNoAnnotation)
-    , nodeAnnotation(eNoAnnotation)
-    , color(go::empty)
-    , nextColor(go::empty)
-    , moveNumber(-1)
-{
+const nodeProperty nodeProperty::null;
+
+
+nodeArena::nodeArena(node* root) : root_(root), count_(1){
+    depths.push_back(0);
+    moveIndexes.push_back(0);
+}
+
+nodeArena::~nodeArena(){
+    // nodes have no destructor, so blocks are freed as they are.
+    foreach(block* b, blocks)
+        qFreeAligned(b);
+
+    qDeleteAll(properties);
+}
+
+/**
+* construct new node in arena.
+*/
+node* nodeArena::create(quint32 parent){
+    quint32 index;
+    if (!freeNodes.empty()){
+        index = freeNodes.back();
+        freeNodes.pop_back();
+    }
+    else{
+        if (count_ - 1 == blocks.size() * blockNodes())
+            allocateBlock();
+        index = count_++;
+        depths.push_back(0);
+        moveIndexes.push_back(0);
+    }
+
+    node* n = new (at(index)) node(parent);
+    if (parent != noIndex)
+        setDepth(index, depths[parent] + 1, moveIndexes[parent]);
+    else
+        setDepth(index, 0, 0);
+    return n;
+}
+
+/**
+* release node which is removed from tree, with its descendants.
+* nodes must not be used after this.
+*/
+void nodeArena::release(node* n){
+    Q_ASSERT(!n->isRoot());
+
+    QVector<quint32> stack;
+    stack.push_back( indexOf(n) );
+    while (!stack.empty()){
+        quint32 index = stack.back();
+        stack.pop_back();
+
+        for (quint32 child=at(index)->firstChild_; child!=noIndex; child=at(child)->nextSibling_)
+            stack.push_back(child);
+
+        delete properties.take(index);
+        freeNodes.push_back(index);
+    }
+}
+
+/**
+* allocate blocks for count nodes in advance.
+*/
+void nodeArena::reserve(quint32 count){
+    while (count > 1 && blocks.size() * blockNodes() < count - 1)
+        allocateBlock();
+    depths.reserve(count);
+    moveIndexes.reserve(count);
+}
+
+/**
+* allocate block aligned to its size, so that nodes find header of it by their address.
+*/
+void nodeArena::allocateBlock(){
+    block* b = static_cast<block*>( qMallocAligned(blockSize, blockSize) );
+    Q_CHECK_PTR(b);
+    b->arena = this;
+    b->first = 1 + blocks.size() * blockNodes();
+    b->reserved = 0;
+    blocks.push_back(b);
+}
+
+/**
+* allocate rare properties of node.
+*/
+nodeProperty* nodeArena::createProperty(quint32 index){
+    nodeProperty*& property = properties[index];
+    if (property == NULL)
+        property = new nodeProperty;
+    return property;
+}
+
+
+/**
+* returns link to i-th child, which is firstChild_ of parent or nextSibling_ of previous child.
+* link to end of list is returned if i is size of list.
+*/
+quint32& childList::link(int i) const{
+    quint32* p = &arena_->at(parent_)->firstChild_;
+    while (i-- > 0 && *p != nodeArena::noIndex)
+        p = &arena_->at(*p)->nextSibling_;
+    return *p;
+}
+
+/**
+* returns link to node of index, or link to end of list if node is not child.
+*/
+quint32& childList::linkTo(quint32 index) const{
+    quint32* p = &arena_->at(parent_)->firstChild_;
+    while (*p != index && *p != nodeArena::noIndex)
+        p = &arena_->at(*p)->nextSibling_;
+    return *p;
+}
+
+int childList::size() const{
+    int n = 0;
+    for (iterator i=begin(); i!=end(); ++i)
+        ++n;
+    return n;
+}
+
+nodePtr childList::back() const{
+    quint32 last = nodeArena::noIndex;
+    for (quint32 i=arena_->at(parent_)->firstChild_; i!=nodeArena::noIndex; i=arena_->at(i)->nextSibling_)
+        last = i;
+    return last == nodeArena::noIndex ? nodePtr() : nodePtr( arena_->at(last) );
+}
+
+nodePtr childList::operator[](int i) const{
+    quint32 index = link(i);
+    return index == nodeArena::noIndex ? nodePtr() : nodePtr( arena_->at(index) );
+}
+
+int childList::indexOf(const nodePtr& n) const{
+    int i = 0;
+    for (iterator iter=begin(); iter!=end(); ++iter, ++i)
+        if (*iter == n)
+            return i;
+    return -1;
+}
+
+/**
+*/
+nodeList childList::toList() const{
+    nodeList list;
+    for (iterator iter=begin(); iter!=end(); ++iter)
+        list.push_back(*iter);
+    return list;
+}
+
+/**
+* insert node to i-th child, and set its parent.
+*/
+void childList::insert(int i, const nodePtr& n){
+    quint32& l = link(i);
+    n->nextSibling_ = l;
+    n->parent_ = parent_;
+    l = n->index();
+}
+
+childList::iterator childList::insert(iterator before, const nodePtr& n){
+    quint32& l = linkTo(before.index_);
+    n->nextSibling_ = l;
+    n->parent_ = parent_;
+    l = n->index();
+    return iterator(arena_, l);
+}
+
+/**
+* remove i-th child from list.
+* parent of removed node is not changed, so that it is inserted again by undo.
+*/
+nodePtr childList::takeAt(int i){
+    quint32& l = link(i);
+    node* n = arena_->at(l);
+    l = n->nextSibling_;
+    n->nextSibling_ = nodeArena::noIndex;
+    return nodePtr(n);
+}
+
+childList::iterator childList::erase(iterator i){
+    quint32& l = linkTo(i.index_);
+    node* n = arena_->at(l);
+    l = n->nextSibling_;
+    n->nextSibling_ = nodeArena::noIndex;
+    return iterator(arena_, l);
+}
+
+bool childList::removeOne(const nodePtr& n){
+    quint32& l = linkTo( n->index() );
+    if (l == nodeArena::noIndex)
+        return false;
+    l = n->nextSibling_;
+    n->nextSibling_ = nodeArena::noIndex;
+    return true;
+}
+
+/**
+* remove all children from list. they are not released.
+*/
+void childList::clear(){
+    quint32& first = arena_->at(parent_)->firstChild_;
+    while (first != nodeArena::noIndex){
+        node* n = arena_->at(first);
+        first = n->nextSibling_;
+        n->nextSibling_ = nodeArena::noIndex;
+    }
 }
 
-node::node(nodePtr p_)
-    : parent_(p_)
-    , annotation(eNoAnnotation)
-    , moveAnnotation(eNoAnnotation)
-    , nodeAnnotation(eNoAnnotation)
+
+node::node(quint32 parent)
+    : parent_(parent)
+    , firstChild_(nodeArena::noIndex)
+    , nextSibling_(nodeArena::noIndex)
+    , moveNumber(-1)
+    , position_(0xffff)
     , color(go::empty)
     , nextColor(go::empty)
-    , moveNumber(-1)
+    , flags(0)
 {
 }
 
 void node::clear(){
-    parent_.reset();
-    childNodes.clear();
+    parent_ = nodeArena::noIndex;
+    childNodes().clear();
+}
+
+void node::setParent(const nodePtr& parent){
+    Q_ASSERT(!parent || parent->arena() == arena());
+    parent_ = parent ? parent->index() : nodeArena::noIndex;
+}
+
+void node::setColor(go::color c){
+    color = c;
+
+    nodePtr p = parent();
+    arena()->setDepth( index(), depth(), (p ? p->moveIndex() : 0) + (isStone() ? 1 : 0) );
+}
+
+/**
+* recalculate depth and move index of this node and its descendants from parent.
+*/
+void node::updateDepth(){
+    nodeArena* a = arena();
+    QVector<node*> stack;
+    stack.push_back(this);
+    while (!stack.empty()){
+        node* n = stack.back();
+        stack.pop_back();
+
+        nodePtr p = n->parent();
+        a->setDepth( n->index(), p ? p->depth() + 1 : 0, (p ? p->moveIndex() : 0) + (n->isStone() ? 1 : 0) );
+
+        foreach(const nodePtr& child, n->childNodes())
+            stack.push_back(child.get());
+    }
 }
 
 bool node::isPass() const{
-    const informationNode* info = infomation(this);
-    return position.x < 0 || position.y < 0 || position.x >= info->xsize || position.y >= info->ysize;
+    const informationNode* info = information();
+    int x = getX();
+    int y = getY();
+    return x < 0 || y < 0 || x >= info->xsize || y >= info->ysize;
+}
+
+QString node::nodeName() const{
+    const informationNode* info = informationCast(this);
+    return info ? info->nodeName() : name();
 }
 
 QString node::toString() const{
@@ -94,57 +354,59 @@ QString node::toString() const{
     if (moveNumber > 0)
         str += QString(" (%1)").arg(moveNumber);
 
-    if (!comment.isEmpty())
+    const nodeProperty* p = property();
+
+    if (!p->comment.isEmpty())
         str += QString(" %1").arg( tr("Comment") );
 
-    if (!emptyStones.empty())
+    if (!p->emptyStones.empty())
         str += QString(" %1").arg( tr("Add Empty") );
 
-    if (!whiteStones.empty())
+    if (!p->whiteStones.empty())
         str += QString(" %1").arg( tr("Add White") );
 
-    if (!blackStones.empty())
+    if (!p->blackStones.empty())
         str += QString(" %1").arg( tr("Add Black") );
 
-    if (!dims.empty())
+    if (!p->dims.empty())
         str += QString(" %1").arg( tr("Dim") );
 
-    if (!marks.empty())
+    if (!p->marks.empty())
         str += QString(" %1").arg( tr("Mark") );
 
-    if (!blackTerritories.empty())
+    if (!p->blackTerritories.empty())
         str += QString(" %1").arg( tr("BlackTerritories") );
 
-    if (!whiteTerritories.empty())
+    if (!p->whiteTerritories.empty())
         str += QString(" %1").arg( tr("WhiteTerritories") );
 
-    if (moveAnnotation == eGoodMove)
+    if (p->moveAnnotation == eGoodMove)
         str += QString(" [%1]").arg( tr("Good Move") );
-    else if (moveAnnotation == eVeryGoodMove)
+    else if (p->moveAnnotation == eVeryGoodMove)
         str += QString(" [%1]").arg( tr("Very Good Move") );
-    else if (moveAnnotation == eBadMove)
+    else if (p->moveAnnotation == eBadMove)
         str += QString(" [%1]").arg( tr("Bad Move") );
-    else if (moveAnnotation == eVeryBadMove)
+    else if (p->moveAnnotation == eVeryBadMove)
         str += QString(" [%1]").arg( tr("Very Bad Move") );
-    else if (moveAnnotation == eDoubtfulMove)
+    else if (p->moveAnnotation == eDoubtfulMove)
         str += QString(" [%1]").arg( tr("Doubtful Move") );
-    else if (moveAnnotation == eInterestingMove)
+    else if (p->moveAnnotation == eInterestingMove)
         str += QString(" [%1]").arg( tr("Interesting Move") );
 
-    if (nodeAnnotation == eEven)
+    if (p->nodeAnnotation == eEven)
         str += QString(" [%1]").arg( tr("Even") );
-    else if (nodeAnnotation == eGoodForBlack)
+    else if (p->nodeAnnotation == eGoodForBlack)
         str += QString(" [%1]").arg( tr("Good for Black") );
-    else if (nodeAnnotation == eVeryGoodForBlack)
+    else if (p->nodeAnnotation == eVeryGoodForBlack)
         str += QString(" [%1]").arg( tr("Very Good for Black") );
-    else if (nodeAnnotation == eGoodForWhite)
+    else if (p->nodeAnnotation == eGoodForWhite)
         str += QString(" [%1]").arg( tr("Good for White") );
-    else if (nodeAnnotation == eVeryGoodForWhite)
+    else if (p->nodeAnnotation == eVeryGoodForWhite)
         str += QString(" [%1]").arg( tr("Very Good for White") );
-    else if (nodeAnnotation == eUnclear)
+    else if (p->nodeAnnotation == eUnclear)
         str += QString(" [%1]").arg( tr("Unclear") );
 
-    if (annotation == eHotspot)
+    if (p->annotation == eHotspot)
         str += QString(" [%1]").arg( tr("Hotspot") );
 
     if (!str.isEmpty() && str[0] == ' ')
@@ -153,11 +415,16 @@ QString node::toString() const{
     return str;
 }
 
-informationNode::informationNode(nodePtr parent) : node(parent){
+informationNode::informationNode() : node(nodeArena::noIndex), propertyCodec(NULL), loaded(true), dirty(false), pinned(0){
+    flags |= eRoot;
+    arena_ = new nodeArena(this);
     initialize();
 }
 
 informationNode::~informationNode(){
+    if (loader)
+        loader->destroyed(this);
+    delete arena_;
 }
 
 void informationNode::initialize(){
@@ -173,6 +440,188 @@ QString informationNode::nodeName() const{
     return str;
 }
 
+/**
+* parse game tree if it is not loaded yet.
+*/
+bool informationNode::load(){
+    if (loaded || !loader)
+        return true;
+
+    // game information read by index is read again with game tree.
+    clearTree();
+    if (loader->parse(this) == false)
+        return false;
+
+    loaded = true;
+    loader->loaded(this);
+    return true;
+}
+
+/**
+* release game tree, it is parsed again by load().
+* game which is not read lazily, or modified, is not released.
+*/
+void informationNode::unload(){
+    if (!loaded || !loader || dirty || pinned > 0)
+        return;
+
+    clearTree();
+    loaded = false;
+}
+
+void informationNode::clearTree(){
+    firstChild_ = nodeArena::noIndex;
+    flags &= ~eHasProperty;
+    delete arena_;
+    arena_ = new nodeArena(this);
+}
+
+
+/**
+* release trees of least recently used games.
+*/
+void loadedGameList::loaded(informationNode* info){
+    QMutexLocker locker(&mutex);
+    games.removeOne(info);
+    games.push_back(info);
+
+    int i = 0;
+    while (games.size() > maxLoadedGames && i < games.size() - 1){
+        if (games[i]->pinned > 0){
+            ++i;
+            continue;
+        }
+        games.takeAt(i)->unload();
+    }
+}
+
+
+/**
+* game whose tree is parsed in worker thread by parseGames.
+*/
+class parsedGame{
+public:
+    parsedGame() : skip(true){}
+    parsedGame(const informationPtr& game_, bool skip_) : game(game_), skip(skip_){}
+
+    informationPtr game;
+    informationPtr tree;
+    bool skip;
+};
+
+static void parseGame(parsedGame& g){
+    if (g.skip)
+        return;
+    else if (g.game->isLoaded() || !g.game->loader){
+        g.tree = g.game;
+        return;
+    }
+
+    // tree which is not parsed completely is used as it is, same as load().
+    // tree is NULL if loader can't parse it, as source file is changed.
+    g.tree.reset(new informationNode);
+    if (!g.game->loader->parse(g.tree.get()))
+        g.tree.reset();
+}
+
+/**
+* returns trees of games for operation which reads whole collection, such as saving.
+* games which are not loaded are parsed in parallel to temporary trees, so loaded games of collection are not changed.
+* tree is NULL if skip[i] is true, or game can't be parsed.
+* callers pass games by PARSE_GAMES_AT_ONCE to limit memory.
+*/
+informationList parseGames(const informationList& games, const QVector<bool>& skip){
+    QVector<parsedGame> list;
+    list.reserve(games.size());
+    for (int i=0; i<games.size(); ++i)
+        list.push_back( parsedGame(games[i], i < skip.size() && skip[i]) );
+
+    QtConcurrent::blockingMap(list, parseGame);
+
+    informationList trees;
+    foreach(const parsedGame& g, list)
+        trees.push_back(g.tree);
+    return trees;
+}
+
+/**
+* first game is set by reader in worker thread, and gui shows it while rest of file is read.
+*/
+void fileProgress::setFirstGame(const informationPtr& game){
+    QMutexLocker locker(&mutex);
+    first = game;
+}
+
+informationPtr fileProgress::firstGame() const{
+    QMutexLocker locker(&mutex);
+    return first;
+}
+
+
+/**
+* copy game, which is independent of game edited in gui.
+* game not modified after reading shares its loader, and it is read again from source.
+*/
+informationPtr copyGame(const informationPtr& game){
+    informationPtr copy(new informationNode);
+    if (game->loader && !game->dirty){
+        copy->loader = game->loader;
+        copy->loaded = false;
+        return copy;
+    }
+
+    copy->xsize       = game->xsize;
+    copy->ysize       = game->ysize;
+    copy->komi        = game->komi;
+    copy->handicap    = game->handicap;
+    copy->time        = game->time;
+    copy->overTime    = game->overTime;
+    copy->whitePlayer = game->whitePlayer;
+    copy->whiteRank   = game->whiteRank;
+    copy->whiteTeam   = game->whiteTeam;
+    copy->blackPlayer = game->blackPlayer;
+    copy->blackRank   = game->blackRank;
+    copy->blackTeam   = game->blackTeam;
+    copy->result      = game->result;
+    copy->gameName    = game->gameName;
+    copy->date        = game->date;
+    copy->round       = game->round;
+    copy->place       = game->place;
+    copy->event       = game->event;
+    copy->rule        = game->rule;
+    copy->annotation  = game->annotation;
+    copy->source      = game->source;
+    copy->gameComment = game->gameComment;
+    copy->copyright   = game->copyright;
+    copy->user        = game->user;
+    copy->opening     = game->opening;
+    copy->dirty       = true;
+
+    // nodes are copied with their children by stack.
+    QVector< QPair<const node*, node*> > stack;
+    stack.push_back( qMakePair(static_cast<const node*>(game.get()), static_cast<node*>(copy.get())) );
+    while (!stack.empty()){
+        const node* from = stack.back().first;
+        node* to = stack.back().second;
+        stack.pop_back();
+
+        to->position_      = from->position_;
+        to->setColor(from->color);
+        to->nextColor      = from->nextColor;
+        to->moveNumber     = from->moveNumber;
+        if (from->hasProperty())
+            *to->editProperty() = *from->property();
+
+        foreach(const nodePtr& child, from->childNodes()){
+            nodePtr newNode = createNode( nodePtr(to) );
+            to->childNodes().push_back(newNode);
+            stack.push_back( qMakePair(static_cast<const node*>(child.get()), newNode.get()) );
+        }
+    }
+
+    return copy;
+}
+
 
 data::data() : root(new informationNode()){
     rootList.push_back( root );
@@ -180,22 +629,167 @@ data::data() : root(new informationNode()){
 
 void data::clear(){
     rootList.clear();
-    root.reset( new informationNode(nodePtr()) );
+    root.reset( new informationNode );
     rootList.push_back( root );
 }
 
 
+fileBuffer::fileBuffer(const QString& fname) : file(fname), map(NULL), modified(0), opened(false){
+    if (!file.open(QIODevice::ReadOnly))
+        return;
+
+#ifndef Q_OS_WIN
+    struct stat st;
+    if (::fstat(file.handle(), &st) == 0 && st.st_size > 0){
+        modified = st.st_mtime;
+        map = file.map(0, st.st_size);
+    }
+#else
+    // mapped file can't be replaced by saving it, so it is read to memory.
+#endif
+    if (map)
+        bytes = QByteArray::fromRawData(reinterpret_cast<const char*>(map), file.size());
+    else{
+        file.close();
+        if (!file.open(QIODevice::ReadOnly|QIODevice::Text))
+            return;
+        bytes = file.readAll();
+    }
+
+    opened = true;
+}
+
+/**
+* buffer of bytes in memory, such as downloaded file.
+*/
+fileBuffer::fileBuffer(const QByteArray& bytes_) : bytes(bytes_), map(NULL), modified(0), opened(true){
+}
+
+fileBuffer::~fileBuffer(){
+    if (map)
+        file.unmap(map);
+}
+
+/**
+* returns false if mapped file is changed after it is mapped.
+* pages of truncated file raise SIGBUS when they are read, and rewritten bytes are not the indexed games.
+* size and time are taken from opened file, so file replaced by saving it with rename is still intact.
+*/
+bool fileBuffer::isIntact() const{
+#ifndef Q_OS_WIN
+    struct stat st;
+    if (map)
+        return ::fstat(file.handle(), &st) == 0 && st.st_size == bytes.size() && st.st_mtime == modified;
+#endif
+    return true;
+}
+
+/**
+* read file.
+* file is mapped to memory and read without copy if possible.
+*/
 bool fileBase::read(const QString& fname, QTextCodec* defaultCodec, bool guessCodec){
-    QFile f(fname);
-    if (!f.open(QIODevice::ReadOnly|QIODevice::Text))
+    return readSource(fileBufferPtr(new fileBuffer(fname)), defaultCodec, guessCodec);
+}
+
+/**
+* read bytes of buffer.
+* readers can share buffer with games instead of copying bytes.
+*/
+bool fileBase::readSource(const fileBufferPtr& buffer, QTextCodec* defaultCodec, bool guessCodec){
+    if (!buffer->isOpen())
         return false;
 
-    QByteArray bytes = f.read( f.size() );
-    return read(bytes, defaultCodec, guessCodec);
+    source = buffer;
+    bool ret = read(buffer->bytes, defaultCodec, guessCodec);
+    source.reset();
+    return ret;
 }
 
+/**
+* returns codec of byte order mark at head of bytes, or NULL.
+*/
+static QTextCodec* codecForBom(const QByteArray& bytes){
+    if (bytes.startsWith("\xef\xbb\xbf"))
+        return QTextCodec::codecForName("UTF-8");
+    else if (bytes.startsWith("\xff\xfe") || bytes.startsWith("\xfe\xff"))
+        return QTextCodec::codecForName("UTF-16");
+    else
+        return NULL;
+}
+
+/**
+* returns true if bytes are valid utf-8 and have any non ascii character.
+* sequence cut at last is accepted, because bytes may be head of file.
+*/
+static bool isUtf8(const char* first, const char* last){
+    const uchar* p   = reinterpret_cast<const uchar*>(first);
+    const uchar* end = reinterpret_cast<const uchar*>(last);
+    bool multibyte = false;
+
+    while (p != end){
+#ifdef GODATA_USE_SSE2
+        // ascii characters are skipped 16 bytes at a time.
+        while (end - p >= 16 && _mm_movemask_epi8( _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)) ) == 0)
+            p += 16;
+        if (p == end)
+            break;
+#endif
+
+        uchar c = *p++;
+        if (c < 0x80)
+            continue;
+
+        // number of trail bytes, and range of first trail byte excluding overlong and surrogate.
+        int n;
+        uchar min = 0x80, max = 0xbf;
+        if (c >= 0xc2 && c <= 0xdf)
+            n = 1;
+        else if (c >= 0xe0 && c <= 0xef){
+            n = 2;
+            if (c == 0xe0)
+                min = 0xa0;
+            else if (c == 0xed)
+                max = 0x9f;
+        }
+        else if (c >= 0xf0 && c <= 0xf4){
+            n = 3;
+            if (c == 0xf0)
+                min = 0x90;
+            else if (c == 0xf4)
+                max = 0x8f;
+        }
+        else
+            return false;
+
+        for (int i=0; i<n && p != end; ++i, ++p){
+            if (*p < min || *p > max)
+                return false;
+            min = 0x80;
+            max = 0xbf;
+        }
+        multibyte = true;
+    }
+
+    return multibyte;
+}
+
+/**
+* detect codec of bytes, and read them.
+* only head of bytes is examined, because encoding is declared in header of every format.
+*/
 bool fileBase::read(const QByteArray& bytes, QTextCodec* defaultCodec, bool guessCodec){
-    QTextCodec* codec = guessCodec ? getCodec(bytes) : NULL;
+    static const int detectionSize = 64 * 1024;
+
+    QTextCodec* codec = NULL;
+    if (guessCodec){
+        QByteArray head = QByteArray::fromRawData(bytes.constData(), qMin(bytes.size(), detectionSize));
+        codec = codecForBom(head);
+        if (codec == NULL)
+            codec = getCodec(head);
+        if (codec == NULL && isUtf8(head.constData(), head.constData() + head.size()))
+            codec = QTextCodec::codecForName("UTF-8");
+    }
     if (codec)
         qDebug() << "file codec is " << codec->name();
     else if (guessCodec)
@@ -204,47 +798,209 @@ bool fileBase::read(const QByteArray& bytes, QTextCodec* defaultCodec, bool gues
         qDebug() << "use default codec: " << defaultCodec->name();
 
     this->codec = codec ? codec : defaultCodec;
-    QString s = this->codec->toUnicode(bytes);
+    return readBuffer(bytes);
+}
+
+/**
+* read text of bytes decoded with codec.
+*/
+bool fileBase::readBuffer(const QByteArray& bytes){
+    textReader reader(bytes, codec, this);
+    return readText(reader) && !reader.canceled();
+}
 
+/**
+*/
+textReader::textReader(const QByteArray& bytes, QTextCodec* codec, const fileBase* file_)
+    : begin(bytes.constData())
+    , p(bytes.constData())
+    , last(bytes.constData() + bytes.size())
+    , decoder(codec)
+    , pos(0)
+    , file(file_)
+    , canceled_(false)
+{
     // yen sign problem.
     QChar chars[2] = {0x005C, 0x00A5};
-    QByteArray ba = this->codec->fromUnicode(chars, 2);
-    if (ba.size() == 2 && ba[0] == ba[1])
-        s.replace(QChar(0x00A5), QChar(0x5C));
+    QByteArray ba = codec->fromUnicode(chars, 2);
+    yen = ba.size() == 2 && ba[0] == ba[1];
+}
+
+/**
+* returns true if all text is read.
+*/
+bool textReader::atEnd(){
+    return pos == text.size() && !decode();
+}
+
+/**
+* first character of rest of text, 0 at end.
+*/
+QChar textReader::peek(){
+    return atEnd() ? QChar() : text[pos];
+}
+
+/**
+* read characters until '\n', which is not included.
+*/
+QString textReader::readLine(){
+    QString str;
+    while (!atEnd()){
+        int n = text.indexOf('\n', pos);
+        if (n < 0){
+            str.append( text.mid(pos) );
+            pos = text.size();
+            continue;
+        }
+
+        str.append( text.mid(pos, n - pos) );
+        pos = n + 1;
+        break;
+    }
+    return str;
+}
+
+/**
+* rest of decoded chunk, or next chunk.
+*/
+QString textReader::readChunk(){
+    if (atEnd())
+        return QString();
+
+    QString str = pos == 0 ? text : text.mid(pos);
+    pos = text.size();
+    return str;
+}
+
+/**
+* decode next chunk of bytes. returns false if bytes are all decoded or reading is canceled.
+*/
+bool textReader::decode(){
+    static const int chunkSize = 64 * 1024;
+
+    text.clear();
+    pos = 0;
+    while (text.isEmpty() && p != last){
+        if (file && !file->updateProgress(p - begin, last - begin)){
+            canceled_ = true;
+            p = last;
+            return false;
+        }
+
+        int n = qMin<int>(last - p, chunkSize);
+        text = decoder.toUnicode(p, n);
+        p += n;
+
+        QChar* out = text.data();
+        const QChar* c = out;
+        const QChar* end = c + text.size();
+        for (; c != end; ++c){
+            if (c->unicode() == '\r')
+                continue;
+            *out++ = yen && c->unicode() == 0x00A5 ? QChar(0x5C) : *c;
+        }
+        text.resize(out - text.constData());
+    }
+
+    return !text.isEmpty();
+}
 
-    QString::iterator iter = s.begin();
-    return readStream(iter, s.end());
+/**
+* replace file to with file from.
+*/
+bool replaceFile(const QString& from, const QString& to){
+#ifdef Q_OS_WIN
+    return MoveFileExW((const wchar_t*)from.utf16(), (const wchar_t*)to.utf16(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    return ::rename(QFile::encodeName(from).constData(), QFile::encodeName(to).constData()) == 0;
+#endif
+}
+
+/**
+* write buffered data of file to disk.
+*/
+bool syncFile(QFile& file){
+    if (!file.flush())
+        return false;
+#ifdef Q_OS_WIN
+    return FlushFileBuffers((HANDLE)_get_osfhandle(file.handle())) != 0;
+#else
+    return ::fsync(file.handle()) == 0;
+#endif
+}
+
+/**
+* write entries of directory to disk, so that renamed file is kept after crash.
+* rename on windows is written through by replaceFile.
+*/
+bool syncDirectory(const QString& path){
+#ifdef Q_OS_WIN
+    Q_UNUSED(path);
+    return true;
+#else
+    int fd = ::open(QFile::encodeName(path).constData(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    // some file systems can not sync directory.
+    bool ret = ::fsync(fd) == 0 || errno == EINVAL;
+    ::close(fd);
+    return ret;
+#endif
 }
 
+/**
+* save to temporary file in same directory, and replace fname with it.
+* original file is kept if writing fails.
+* file is synced before rename and directory after it, so that it is kept after crash.
+*/
 bool fileBase::save(const QString& fname, QTextCodec* codec){
     this->codec = codec;
 
-    QFile f(fname);
-    if (!f.open(QIODevice::WriteOnly))
+    QTemporaryFile f(fname + ".XXXXXX");
+    if (!f.open())
         return false;
 
-    QString str;
-    QTextStream stream(&str, QIODevice::WriteOnly);
+    if (QFile::exists(fname))
+        f.setPermissions( QFile::permissions(fname) );
+    else
+        f.setPermissions(QFile::ReadOwner | QFile::WriteOwner | QFile::ReadGroup | QFile::ReadOther);
+
+    // QTextStream encodes and writes buffered text in fixed size chunks.
+    QTextStream stream(&f);
+    stream.setCodec(codec);
     bool ret = saveStream(stream);
     stream.flush();
 
-    QByteArray a = codec->fromUnicode(str);
-    f.write(a);
+    if (!ret || f.error() != QFile::NoError || !syncFile(f))
+        return false;
 
-    return ret;
+    f.close();
+    if (!replaceFile(f.fileName(), fname))
+        return false;
+    return syncDirectory( QFileInfo(fname).absolutePath() );
 }
 
-QString fileBase::readLine(QString::iterator& first, QString::iterator& last){
-    QString str;
-    while (first != last){
-        QChar c = *first++;
-        if (c == '\r')
-            continue;
-        else if (c == '\n')
-            break;
-        str.push_back(c);
-    }
-    return str;
+/**
+* report progress, returns false if it is canceled.
+*/
+bool fileBase::updateProgress(int value, int maximum) const{
+    if (progress == NULL)
+        return true;
+
+    progress->maximum = maximum;
+    progress->value = value;
+    return progress->canceled == 0;
+}
+
+/**
+* returns position of first character in head of file, after byte order mark and spaces.
+* used by probe() of readers.
+*/
+int fileBase::headStart(const QByteArray& head){
+    int i = head.startsWith("\xef\xbb\xbf") ? 3 : 0;
+    while (i < head.size() && isspace((unsigned char)head[i]))
+        ++i;
+    return i;
 }
 
 
@@ -18,25 +18,80 @@
 #ifndef __godata_h__
 #define __godata_h__
 
+#include <iterator>
 #include <QCoreApplication>
 #include <QFile>
 #include <QTextStream>
 #include <QStringList>
 #include <QLinkedList>
 #include <QMap>
+#include <QHash>
+#include <QVector>
+#include <QPair>
 #include <QTextCodec>
+#include <QAtomicInt>
+#include <QMutex>
 #include <boost/shared_ptr.hpp>
-#include <boost/weak_ptr.hpp>
 
 namespace go{
 
 class node;
 class informationNode;
-typedef boost::shared_ptr<node> nodePtr;
-typedef boost::weak_ptr<node> nodeWPtr;
-typedef QList<nodePtr> nodeList;
+class nodeArena;
+class fileBuffer;
 typedef boost::shared_ptr<informationNode> informationPtr;
 typedef QList<informationPtr> informationList;
+typedef boost::shared_ptr<fileBuffer> fileBufferPtr;
+
+
+/**
+* handle of node.
+* node is owned by nodeArena of the game, handle does not own node.
+*/
+class nodeHandle{
+    typedef node* nodeHandle::*unspecified_bool_type;
+
+public:
+    nodeHandle() : node_(NULL){}
+    explicit nodeHandle(node* n) : node_(n){}
+    nodeHandle(const informationPtr& info);
+
+    node* get() const{ return node_; }
+    node* operator->() const{ return node_; }
+    node& operator*() const{ return *node_; }
+    void reset(){ node_ = NULL; }
+
+    operator unspecified_bool_type() const{ return node_ ? &nodeHandle::node_ : NULL; }
+    bool operator!() const{ return node_ == NULL; }
+
+private:
+    node* node_;
+};
+
+inline
+bool operator ==(const nodeHandle& a, const nodeHandle& b){
+    return a.get() == b.get();
+}
+
+inline
+bool operator !=(const nodeHandle& a, const nodeHandle& b){
+    return a.get() != b.get();
+}
+
+inline
+bool operator <(const nodeHandle& a, const nodeHandle& b){
+    return a.get() < b.get();
+}
+
+typedef nodeHandle nodePtr;
+
+}
+
+Q_DECLARE_TYPEINFO(go::nodeHandle, Q_MOVABLE_TYPE);
+
+namespace go{
+
+typedef QList<nodePtr> nodeList;
 
 
 enum color{ empty=0, black=1, white=2, blackTerritory=4, whiteTerritory=8, dame=16 };
@@ -84,8 +139,161 @@ public:
 
 typedef QList<mark>  markList;
 typedef QList<stone> stoneList;
+typedef QList<QByteArray> rawValueList;
+typedef QList< QPair<QByteArray, rawValueList> > propertyList;  // raw key and values, encoded by informationNode::propertyCodec
 class data;
-class informationNode;
+
+
+/**
+* rarely used properties of node.
+* allocated by nodeArena only when node has setup stones, markup, name, comment or annotation.
+*/
+class nodeProperty{
+public:
+    static const nodeProperty null;
+
+    nodeProperty() : annotation(0), moveAnnotation(0), nodeAnnotation(0){}
+
+    QString   name;
+    QString   comment;
+    markList  marks;
+    markList  blackTerritories;
+    markList  whiteTerritories;
+    markList  dims;
+    stoneList blackStones;
+    stoneList whiteStones;
+    stoneList emptyStones;
+    propertyList unknownProperties;  // not supported by mugo, kept to save them again.
+    quint8    annotation;      // node::eAnnotation
+    quint8    moveAnnotation;  // node::eMoveAnnotation
+    quint8    nodeAnnotation;  // node::eNodeAnnotation
+};
+
+
+/**
+* node storage of one game.
+* nodes are allocated in fixed size blocks, so address of node never changes until arena is deleted.
+* blocks are aligned to their size, and node finds its arena and index from header of its block.
+* index 0 is root node (informationNode) which owns arena.
+* depth and move index of nodes are kept in tables by index, apart from nodes.
+* released nodes are kept in free list, and their places are used by nodes created later.
+*/
+class nodeArena{
+public:
+    enum{ noIndex = 0xffffffff };
+
+    explicit nodeArena(node* root);
+    ~nodeArena();
+
+    node* create(quint32 parent);
+    void release(node* n);
+    void reserve(quint32 count);
+    node* at(quint32 index) const;
+    node* root() const{ return root_; }
+    int size() const{ return count_; }
+
+    static nodeArena* arenaOf(const node* n);
+    static quint32 indexOf(const node* n);
+
+    quint32 depth(quint32 index) const{ return depths[index]; }
+    quint32 moveIndex(quint32 index) const{ return moveIndexes[index]; }
+    void setDepth(quint32 index, quint32 depth, quint32 moveIndex){ depths[index] = depth; moveIndexes[index] = moveIndex; }
+
+    nodeProperty* property(quint32 index) const{ return properties.value(index); }
+    nodeProperty* createProperty(quint32 index);
+
+private:
+    Q_DISABLE_COPY(nodeArena)
+
+    enum{ blockSize = 4096 };
+
+    struct block{
+        nodeArena* arena;
+        quint32 first;    // index of first node in block
+        quint32 reserved;
+    };
+
+    static quint32 blockNodes();
+    static node* nodes(block* b){ return reinterpret_cast<node*>(b + 1); }
+    void allocateBlock();
+
+    node* root_;
+    QVector<block*> blocks;
+    quint32 count_;
+    QVector<quint32> freeNodes;  // indexes of released nodes
+    QVector<quint32> depths;
+    QVector<quint32> moveIndexes;
+    QHash<quint32, nodeProperty*> properties;
+};
+
+
+/**
+* children of node, which are linked by indexes in nodeArena.
+* it refers node, so it is valid while node exists and changes node directly.
+*/
+class childList{
+public:
+    class iterator{
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef nodePtr   value_type;
+        typedef ptrdiff_t difference_type;
+        typedef nodePtr*  pointer;
+        typedef nodePtr   reference;
+
+        iterator() : arena_(NULL), index_(nodeArena::noIndex){}
+        iterator(nodeArena* arena, quint32 index) : arena_(arena), index_(index){}
+
+        nodePtr operator*() const{ return nodePtr( arena_->at(index_) ); }
+        iterator& operator++();
+        iterator operator++(int){ iterator i(*this); ++*this; return i; }
+        bool operator ==(const iterator& i) const{ return index_ == i.index_; }
+        bool operator !=(const iterator& i) const{ return index_ != i.index_; }
+
+    private:
+        friend class childList;
+        nodeArena* arena_;
+        quint32 index_;
+    };
+    typedef iterator const_iterator;
+
+    childList(nodeArena* arena, quint32 parent) : arena_(arena), parent_(parent){}
+
+    iterator begin() const;
+    iterator end() const{ return iterator(arena_, nodeArena::noIndex); }
+
+    int  size() const;
+    int  count() const{ return size(); }
+    bool empty() const;
+    bool isEmpty() const{ return empty(); }
+    nodePtr front() const{ return *begin(); }
+    nodePtr first() const{ return front(); }
+    nodePtr back() const;
+    nodePtr last() const{ return back(); }
+    nodePtr operator[](int i) const;
+    nodePtr at(int i) const{ return (*this)[i]; }
+    int  indexOf(const nodePtr& n) const;
+    bool contains(const nodePtr& n) const{ return indexOf(n) >= 0; }
+    nodeList toList() const;
+
+    void push_back(const nodePtr& n){ insert(size(), n); }
+    void append(const nodePtr& n){ push_back(n); }
+    void insert(int i, const nodePtr& n);
+    iterator insert(iterator before, const nodePtr& n);
+    void removeAt(int i){ takeAt(i); }
+    nodePtr takeAt(int i);
+    iterator erase(iterator i);
+    bool removeOne(const nodePtr& n);
+    void clear();
+
+private:
+    quint32& link(int i) const;
+    quint32& linkTo(quint32 index) const;
+
+    nodeArena* arena_;
+    quint32 parent_;
+};
+
 
 class node{
     Q_DECLARE_TR_FUNCTIONS(go::node)
@@ -112,50 +320,132 @@ public:
         eUnclear,
     };
 
-    node();
-    explicit node(nodePtr parent);
-    virtual ~node(){  clear();  }
+    explicit node(quint32 parent);
 
     void clear();
-    nodePtr parent(){ return parent_.lock(); }
-    const nodePtr parent() const{ return parent_.lock(); }
+    nodePtr parent() const;
+    void setParent(const nodePtr& parent);
+    childList childNodes() const{ return childList(arena(), index()); }
+
+    nodeArena* arena() const;
+    quint32 index() const{ return isRoot() ? 0 : nodeArena::indexOf(this); }
+    bool isRoot() const{ return flags & eRoot; }
+    informationNode* information() const;
 
-    int getX() const{ return position.x; }
-    int getY() const{ return position.y; }
+    int depth() const{ return arena()->depth( index() ); }
+    int moveIndex() const{ return arena()->moveIndex( index() ); }
+    void updateDepth();
 
-    void setX(int x){ position.x = x; }
-    void setY(int y){ position.y = y; }
+    int getX() const{ return (position_ & 0xff) == 0xff ? -1 : position_ & 0xff; }
+    int getY() const{ return (position_ >> 8) == 0xff ? -1 : position_ >> 8; }
+    point position() const{ return point(getX(), getY()); }
 
-    virtual bool isStone() const{ return isBlack() || isWhite(); }
+    void setX(int x){ position_ = (position_ & 0xff00) | (x < 0 ? 0xff : x); }
+    void setY(int y){ position_ = (position_ & 0x00ff) | ((y < 0 ? 0xff : y) << 8); }
+    void setPosition(const point& p){ setX(p.x); setY(p.y); }
+
+    bool isStone() const{ return isBlack() || isWhite(); }
     bool isBlack() const{ return color == black; }
     bool isWhite() const{ return color == white; }
     bool isPass() const;
 
-    void setColor(go::color c){ color = c; }
-
-    virtual QString nodeName() const{ return name; }
-    virtual QString toString() const;
+    void setColor(go::color c);
+
+    QString nodeName() const;
+    QString toString() const;
+
+    // rare properties, stored in nodeArena
+    bool hasProperty() const{ return flags & eHasProperty; }
+    const nodeProperty* property() const;
+    nodeProperty* editProperty();
+
+    const QString& name() const{ return property()->name; }
+    const QString& comment() const{ return property()->comment; }
+    void setName(const QString& name){ editProperty()->name = name; }
+    void setComment(const QString& comment){ editProperty()->comment = comment; }
+
+    const markList&  marks() const{ return property()->marks; }
+    const markList&  blackTerritories() const{ return property()->blackTerritories; }
+    const markList&  whiteTerritories() const{ return property()->whiteTerritories; }
+    const markList&  dims() const{ return property()->dims; }
+    const stoneList& blackStones() const{ return property()->blackStones; }
+    const stoneList& whiteStones() const{ return property()->whiteStones; }
+    const stoneList& emptyStones() const{ return property()->emptyStones; }
+    const propertyList& unknownProperties() const{ return property()->unknownProperties; }
+    int annotation() const{ return property()->annotation; }
+    int moveAnnotation() const{ return property()->moveAnnotation; }
+    int nodeAnnotation() const{ return property()->nodeAnnotation; }
+
+    markList&  editMarks(){ return editProperty()->marks; }
+    markList&  editBlackTerritories(){ return editProperty()->blackTerritories; }
+    markList&  editWhiteTerritories(){ return editProperty()->whiteTerritories; }
+    markList&  editDims(){ return editProperty()->dims; }
+    stoneList& editBlackStones(){ return editProperty()->blackStones; }
+    stoneList& editWhiteStones(){ return editProperty()->whiteStones; }
+    stoneList& editEmptyStones(){ return editProperty()->emptyStones; }
+    propertyList& editUnknownProperties(){ return editProperty()->unknownProperties; }
+    void setAnnotation(int annotation){ editProperty()->annotation = annotation; }
+    void setMoveAnnotation(int annotation){ editProperty()->moveAnnotation = annotation; }
+    void setNodeAnnotation(int annotation){ editProperty()->nodeAnnotation = annotation; }
 
 //protected:
-    // node
-    nodeWPtr  parent_;
-    nodeList  childNodes;
-    QString   name;
-    markList  marks;
-    markList  blackTerritories;
-    markList  whiteTerritories;
-    markList  dims;
-    stoneList blackStones;
-    stoneList whiteStones;
-    stoneList emptyStones;
-    int annotation;
-    int moveAnnotation;
-    int nodeAnnotation;
-    QString comment;
-    point position;
-    go::color color;
-    go::color nextColor;
-    int   moveNumber;
+    enum eFlag{ eHasProperty = 1, eRoot = 2 };
+
+    // node, 20 bytes. arena and index are known by block of nodeArena.
+    quint32    parent_;
+    quint32    firstChild_;
+    quint32    nextSibling_;
+    int        moveNumber;
+    quint16    position_;
+    go::color  color : 5;
+    go::color  nextColor : 5;
+    quint8     flags : 6;
+};
+
+
+/**
+* parser of game which is read lazily.
+* collection is indexed first, and each game is parsed when it is used.
+*/
+class gameLoader{
+public:
+    virtual ~gameLoader(){}
+
+    /** parse game tree into info */
+    virtual bool parse(informationNode* info) const = 0;
+
+    /** called when game tree of info is loaded */
+    virtual void loaded(informationNode* /*info*/){}
+
+    /** returns true if original bytes of game can be written by codec */
+    virtual bool canCopy(QTextCodec* /*codec*/) const{ return false; }
+
+    /** write original bytes of game to device if codec is same as source */
+    virtual bool copy(QIODevice* /*device*/, QTextCodec* /*codec*/) const{ return false; }
+
+    /** buffer and byte range of game, which snapshot keeps to copy game later. NULL if game can't be copied */
+    virtual fileBufferPtr source(int& /*first*/, int& /*last*/) const{ return fileBufferPtr(); }
+
+    /** called when game which uses this loader is deleted */
+    virtual void destroyed(informationNode* /*info*/){}
+};
+typedef boost::shared_ptr<gameLoader> gameLoaderPtr;
+
+
+/**
+* games of collection which keep their trees.
+* trees of least recently used games are released.
+*/
+class loadedGameList{
+public:
+    enum{ maxLoadedGames = 16 };
+
+    void loaded(informationNode* info);
+    void remove(informationNode* info){ QMutexLocker locker(&mutex); games.removeOne(info); }
+
+private:
+    QList<informationNode*> games;  // least recently used first
+    QMutex mutex;                   // games are loaded also in worker threads
 };
 
 
@@ -166,10 +456,10 @@ class informationNode : public node{
 //    }
 
 public:
-    explicit informationNode(nodePtr parent=nodePtr());
+    informationNode();
     ~informationNode();
 
-    virtual QString nodeName() const;
+    QString nodeName() const;
 
     void initialize();
 
@@ -205,9 +495,110 @@ public:
     QString copyright;
     QString user;
     QString opening;
+
+    // codec of raw values in unknownProperties of nodes, NULL if they are not read yet.
+    QTextCodec* propertyCodec;
+
+    // lazy loading
+    bool isLoaded() const{ return loaded; }
+    bool load();
+    void unload();
+
+    gameLoaderPtr loader;  // NULL if game is not read lazily
+    bool loaded;
+    bool dirty;            // modified after it is read
+    int  pinned;           // number of boards which show this game
+
+    nodeArena* arena_;     // nodes of game tree
+
+private:
+    void clearTree();
+
+    Q_DISABLE_COPY(informationNode)
 };
 
 
+inline
+nodeHandle::nodeHandle(const informationPtr& info) : node_(info.get()){
+}
+
+inline
+quint32 nodeArena::blockNodes(){
+    return (blockSize - sizeof(block)) / sizeof(node);
+}
+
+inline
+node* nodeArena::at(quint32 index) const{
+    return index == 0 ? root_ : nodes( blocks[(index - 1) / blockNodes()] ) + (index - 1) % blockNodes();
+}
+
+inline
+nodeArena* nodeArena::arenaOf(const node* n){
+    return reinterpret_cast<const block*>( quintptr(n) & ~quintptr(blockSize - 1) )->arena;
+}
+
+inline
+quint32 nodeArena::indexOf(const node* n){
+    block* b = reinterpret_cast<block*>( quintptr(n) & ~quintptr(blockSize - 1) );
+    return b->first + quint32(n - nodes(b));
+}
+
+inline
+nodeArena* node::arena() const{
+    return isRoot() ? static_cast<const informationNode*>(this)->arena_ : nodeArena::arenaOf(this);
+}
+
+inline
+nodePtr node::parent() const{
+    return parent_ == nodeArena::noIndex ? nodePtr() : nodePtr( arena()->at(parent_) );
+}
+
+inline
+childList::iterator& childList::iterator::operator++(){
+    index_ = arena_->at(index_)->nextSibling_;
+    return *this;
+}
+
+inline
+childList::iterator childList::begin() const{
+    return iterator(arena_, arena_->at(parent_)->firstChild_);
+}
+
+inline
+bool childList::empty() const{
+    return arena_->at(parent_)->firstChild_ == nodeArena::noIndex;
+}
+
+inline
+informationNode* node::information() const{
+    return static_cast<informationNode*>( arena()->root() );
+}
+
+inline
+const nodeProperty* node::property() const{
+    return hasProperty() ? arena()->property( index() ) : &nodeProperty::null;
+}
+
+inline
+nodeProperty* node::editProperty(){
+    if (!hasProperty()){
+        flags |= eHasProperty;
+        return arena()->createProperty( index() );
+    }
+    return arena()->property( index() );
+}
+
+inline
+informationNode* informationCast(node* n){
+    return n && n->isRoot() ? static_cast<informationNode*>(n) : NULL;
+}
+
+inline
+const informationNode* informationCast(const node* n){
+    return n && n->isRoot() ? static_cast<const informationNode*>(n) : NULL;
+}
+
+
 class data{
 public:
     enum eRule{eJapanese, eChinese};
@@ -222,14 +613,97 @@ public:
 
 
 
+/**
+* contents of file, mapped to memory if possible.
+* games read lazily keep buffer by fileBufferPtr, so mapped memory is valid while they exist.
+* mapped file may be truncated or rewritten in place by other programs, so readers check isIntact()
+* before they parse bytes of it.
+*/
+class fileBuffer{
+public:
+    explicit fileBuffer(const QString& fname);
+    explicit fileBuffer(const QByteArray& bytes);
+    ~fileBuffer();
+
+    bool isOpen() const{ return opened; }
+    bool isIntact() const;
+    QString fileName() const{ return file.fileName(); }  // empty if buffer is not read from file
+
+    QByteArray bytes;  // refers mapped memory, valid until buffer is deleted.
+
+private:
+    Q_DISABLE_COPY(fileBuffer)
+
+    QFile file;
+    uchar* map;
+    qint64 modified;  // modification time of mapped file, in seconds
+    bool opened;
+};
+
+
+/**
+* progress of reading or saving in worker thread.
+* gui thread reads value, and sets canceled to stop it.
+*/
+class fileProgress{
+public:
+    fileProgress() : value(0), maximum(0), canceled(0){}
+
+    void setFirstGame(const informationPtr& game);
+    informationPtr firstGame() const;
+
+    QAtomicInt value;
+    QAtomicInt maximum;
+    QAtomicInt canceled;
+
+private:
+    mutable QMutex mutex;
+    informationPtr first;  // first game of collection, passed to gui before rest is read
+};
+
+
+class fileBase;
+
+/**
+* text of bytes, which are decoded in fixed size chunks while they are read.
+* only one chunk is kept as QString, '\r' is removed and yen sign is fixed in it.
+*/
+class textReader{
+public:
+    textReader(const QByteArray& bytes, QTextCodec* codec, const fileBase* file = NULL);
+
+    bool atEnd();
+    QChar peek();
+    QString readLine();
+    QString readChunk();
+    bool canceled() const{ return canceled_; }
+
+private:
+    Q_DISABLE_COPY(textReader)
+    bool decode();
+
+    const char* begin;
+    const char* p;
+    const char* last;
+    QTextDecoder decoder;
+    bool yen;                // yen sign is same byte as back slash in codec
+    QString text;            // decoded chunk
+    int pos;                 // position of next character in text
+    const fileBase* file;    // progress is reported to file
+    bool canceled_;
+};
+
+
 class fileBase{
 public:
-    fileBase() : codec(NULL){}
+    fileBase() : codec(NULL), progress(NULL){}
     virtual ~fileBase(){}
 
     virtual bool read(const QString& fname, QTextCodec* codec, bool guessCodec);
     virtual bool read(const QByteArray& bytes, QTextCodec* defaultCodec, bool guessCodec);
-    virtual bool readStream(QString::iterator& first, QString::iterator last) = 0;
+    bool readSource(const fileBufferPtr& buffer, QTextCodec* defaultCodec, bool guessCodec);
+    virtual bool readBuffer(const QByteArray& bytes);
+    virtual bool readText(textReader& /*reader*/){ return false; }
 
     virtual bool save(const QString& fname, QTextCodec* codec);
     virtual bool saveStream(QTextStream& stream) = 0;
@@ -239,13 +713,26 @@ public:
     virtual bool get(go::data& data) const = 0;
     virtual bool set(const go::data& data) = 0;
 
-    QString readLine(QString::iterator& first, QString::iterator& last);
+    static int headStart(const QByteArray& head);
+    bool updateProgress(int value, int maximum) const;
+    void setFirstGame(const informationPtr& game) const{ if (progress) progress->setFirstGame(game); }
 
     QTextCodec* codec;
+    fileProgress* progress;  // NULL if progress is not reported
+
+protected:
+    fileBufferPtr source;    // buffer read by readSource, readers may keep it instead of copying its bytes
 };
 
 
 
+bool replaceFile(const QString& from, const QString& to);
+bool syncFile(QFile& file);
+bool syncDirectory(const QString& path);
+informationPtr copyGame(const informationPtr& game);
+informationList parseGames(const informationList& games, const QVector<bool>& skip = QVector<bool>());
+
+nodePtr createNode(nodePtr parent);
 nodePtr createBlackNode(nodePtr parent);
 nodePtr createBlackNode(nodePtr parent, int x, int y);
 nodePtr createWhiteNode(nodePtr parent);
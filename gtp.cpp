@@ -387,7 +387,8 @@ void gtp::processCommand(QString& s){
         boardWidget_->addStoneCommand(root, cmd->x, cmd->y, go::black);
     }
     else if (command->kind == eDeadList){
-        const BoardWidget::BoardBuffer& buffer = boardWidget_->getBuffer();
+        boardWidget_->invalidateBoardBuffer();
+        QVector<go::point> points;
         QStringList deadStones = msg.split(QRegExp("[ \n]"));
         foreach(QString stone, deadStones){
             int sx, sy;  // sgfX, sgfY
@@ -396,10 +397,9 @@ void gtp::processCommand(QString& s){
 
             int bx, by;  // boardX, boardY
             boardWidget_->sgfToBoardCoordinate(sx, sy, bx, by);
-
-            if (!buffer[by][bx].blackTerritory() && !buffer[by][bx].whiteTerritory())
-                boardWidget_->reverseTerritory(bx, by);
+            points.push_back( go::point(bx, by) );
         }
+        boardWidget_->setDeadStones(points);
     }
     else if (command->kind == eUndo)
         boardWidget_->forward(-1);
@@ -503,10 +503,10 @@ void gtp::restoreSgf(){
         else if (node->color == go::white)
             put(go::white, x, y, eNone);
 
-        foreach(const go::stone& stone, node->blackStones)
+        foreach(const go::stone& stone, node->blackStones())
             put(go::black, stone.p.x, stone.p.y, eNone);
 
-        foreach(const go::stone& stone, node->whiteStones)
+        foreach(const go::stone& stone, node->whiteStones())
             put(go::white, stone.p.x, stone.p.y, eNone);
 
         if (node == boardWidget_->getCurrentNode())
@@ -541,11 +541,11 @@ bool gtp::loadSgf(){
                 tempFile.write( QString().sprintf("[%c%c]", char(x < 26 ? 'a' + x : 'A' + x), char(y < 26 ? 'a' + y : 'A' + y)).toAscii() );
         }
 
-        foreach(const go::stone& stone, node->blackStones){
+        foreach(const go::stone& stone, node->blackStones()){
             tempFile.write( QString().sprintf("AB[%c%c]", char(stone.p.x < 26 ? 'a' + stone.p.x : 'A' + stone.p.x), char(stone.p.y < 26 ? 'a' + stone.p.y : 'A' + stone.p.y)).toAscii() );
         }
 
-        foreach(const go::stone& stone, node->whiteStones){
+        foreach(const go::stone& stone, node->whiteStones()){
             tempFile.write( QString().sprintf("AW[%c%c]", char(stone.p.x < 26 ? 'a' + stone.p.x : 'A' + stone.p.x), char(stone.p.y < 26 ? 'a' + stone.p.y : 'A' + stone.p.y)).toAscii() );
         }
 
@@ -0,0 +1,584 @@
+/*
+    mugo, sgf editor.
+    Copyright (C) 2009-2010 nsase.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <algorithm>
+#include <QDir>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QUuid>
+#include <QDataStream>
+#include <QDesktopServices>
+#include "journal.h"
+#include "snapshot.h"
+
+namespace go{
+
+
+static const quint32 journalMagic   = 0x4d474a4c;  // "MGJL"
+static const quint32 journalVersion = 2;
+
+
+/**
+* read header, and check source file is not changed after journal is started.
+*/
+static bool readHeader(QDataStream& in, QString& sourceName){
+    quint32 magic, version;
+    qint64 size;
+    quint32 modified;
+    in >> magic >> version >> sourceName >> size >> modified;
+    if (in.status() != QDataStream::Ok || magic != journalMagic || version != journalVersion)
+        return false;
+
+    if (sourceName.isEmpty())
+        return true;
+
+    QFileInfo fi(sourceName);
+    return fi.exists() && fi.size() == size && fi.lastModified().toTime_t() == modified;
+}
+
+/**
+* find node by game number and indexes written by writePath.
+* game is loaded if it is not, and it is marked as modified.
+*/
+static nodePtr readPath(QDataStream& in, const data& data){
+    quint32 game, runs;
+    in >> game >> runs;
+    if (in.status() != QDataStream::Ok || game >= (quint32)data.rootList.size())
+        return nodePtr();
+
+    const informationPtr& info = data.rootList[game];
+    if (!info->load())
+        return nodePtr();
+    info->dirty = true;
+
+    nodePtr n(info);
+    for (quint32 i=0; i<runs; ++i){
+        quint32 index, count;
+        in >> index >> count;
+        for (quint32 j=0; j<count; ++j){
+            if (in.status() != QDataStream::Ok || index >= (quint32)n->childNodes().size())
+                return nodePtr();
+            n = n->childNodes()[index];
+        }
+    }
+
+    return in.status() == QDataStream::Ok ? n : nodePtr();
+}
+
+static int childIndex(const nodePtr& parent, const node* n){
+    for (int i=0; i<parent->childNodes().size(); ++i)
+        if (parent->childNodes()[i].get() == n)
+            return i;
+    return -1;
+}
+
+/**
+* apply one record to data, as BoardWidget does same edit.
+*/
+static bool apply(const QByteArray& record, data& data){
+    QDataStream in(record);
+    in.setVersion(QDataStream::Qt_4_5);
+
+    quint8 type;
+    in >> type;
+
+    switch (type){
+        case journal::eInsertNode:{
+            nodePtr parent = readPath(in, data);
+            quint32 index;
+            in >> index;
+            if (!parent || index > (quint32)parent->childNodes().size())
+                return false;
+
+            nodePtr n = createNode(parent);
+            if (!readTree(in, n.get()))
+                return false;
+            parent->childNodes().insert(index, n);
+            n->updateDepth();
+            break;
+        }
+
+        case journal::eDeleteNode:{
+            nodePtr n = readPath(in, data);
+            bool deleteChildren;
+            in >> deleteChildren;
+            if (!n || !n->parent())
+                return false;
+
+            nodePtr parent = n->parent();
+            int index = childIndex(parent, n.get());
+            parent->childNodes().removeAt(index);
+            if (!deleteChildren){
+                while (!n->childNodes().empty()){
+                    nodePtr child = n->childNodes().takeAt(0);
+                    parent->childNodes().insert(index++, child);
+                    child->updateDepth();
+                }
+            }
+            n->arena()->release(n.get());
+            break;
+        }
+
+        case journal::eGroupNodes:{
+            nodePtr parent = readPath(in, data);
+            quint32 index;
+            in >> index;
+            if (!parent)
+                return false;
+
+            nodePtr n = createNode(parent);
+            quint32 count = readNode(in, n.get());
+            if (index + count > (quint32)parent->childNodes().size())
+                return false;
+            for (quint32 i=0; i<count; ++i){
+                nodePtr child = parent->childNodes().takeAt(index);
+                n->childNodes().push_back(child);
+                child->setParent(n);
+            }
+            parent->childNodes().insert(index, n);
+            n->updateDepth();
+            break;
+        }
+
+        case journal::eSetNode:{
+            nodePtr n = readPath(in, data);
+            if (!n)
+                return false;
+            if (n->hasProperty())
+                *n->editProperty() = nodeProperty();
+            readNode(in, n.get());
+            break;
+        }
+
+        case journal::eSetTree:{
+            nodePtr root = readPath(in, data);
+            if (!root)
+                return false;
+
+            // tree is not changed, so nodes are read to existing nodes.
+            QVector<node*> stack;
+            stack.push_back( root.get() );
+            while (!stack.empty() && in.status() == QDataStream::Ok){
+                node* n = stack.back();
+                stack.pop_back();
+
+                if (n->hasProperty())
+                    *n->editProperty() = nodeProperty();
+                if (readNode(in, n) != (quint32)n->childNodes().size())
+                    return false;
+                int top = stack.size();
+                for (childList::iterator iter=n->childNodes().begin(); iter!=n->childNodes().end(); ++iter)
+                    stack.push_back( (*iter).get() );
+                std::reverse(stack.begin() + top, stack.end());
+            }
+            break;
+        }
+
+        case journal::eSetInformation:{
+            quint32 game;
+            in >> game;
+            if (game >= (quint32)data.rootList.size() || !data.rootList[game]->load())
+                return false;
+            data.rootList[game]->dirty = true;
+            readInformation(in, data.rootList[game].get());
+            break;
+        }
+
+        case journal::eMoveGame:{
+            quint32 from, to;
+            in >> from >> to;
+            if (from >= (quint32)data.rootList.size() || to >= (quint32)data.rootList.size())
+                return false;
+            data.rootList.move(from, to);
+            break;
+        }
+
+        case journal::eDeleteGame:{
+            quint32 game;
+            in >> game;
+            if (game >= (quint32)data.rootList.size())
+                return false;
+            data.rootList.removeAt(game);
+            break;
+        }
+
+        case journal::eClearGames:
+            data.rootList.clear();
+            break;
+
+        case journal::eAddGame:{
+            informationPtr info(new informationNode);
+            if (!readInformation(in, info.get()) || !readTree(in, info.get()))
+                return false;
+            info->dirty = true;
+            data.rootList.push_back(info);
+            break;
+        }
+
+        default:
+            return false;
+    }
+
+    return in.status() == QDataStream::Ok;
+}
+
+
+/**
+* start new journal for document read from sourceName.
+* file is created when first edit is written.
+*/
+void journal::start(const QString& sourceName){
+    remove();
+    this->sourceName = sourceName;
+}
+
+/**
+* apply edits in journal fname to data, which is read from its source.
+* journal is continued by this document, from last complete record.
+*/
+bool journal::recover(const QString& fname, data& data){
+    remove();
+
+    file.setFileName(fname);
+    if (!file.open(QIODevice::ReadWrite))
+        return false;
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_4_5);
+    if (!readHeader(in, sourceName)){
+        file.close();
+        return false;
+    }
+    headerSize = file.pos();
+
+    // record which is not written completely is discarded.
+    bool result = true;
+    qint64 size = headerSize;
+    while (!file.atEnd()){
+        quint32 length;
+        quint16 checksum;
+        in >> length >> checksum;
+        if (in.status() != QDataStream::Ok || length > (quint32)file.bytesAvailable())
+            break;
+
+        QByteArray record(length, 0);
+        if (in.readRawData(record.data(), length) != (int)length || qChecksum(record.constData(), length) != checksum)
+            break;
+
+        if (!apply(record, data)){
+            result = false;
+            break;
+        }
+        size = file.pos();
+    }
+
+    file.resize(size);
+    file.seek(size);
+    return result;
+}
+
+/**
+* restart journal from sourceName, which document is saved to.
+* records after pos are edits while saving, and they are kept.
+*/
+void journal::rebase(const QString& sourceName, qint64 pos){
+    QByteArray records;
+    if (file.isOpen()){
+        file.seek( qMax(pos, headerSize) );
+        records = file.readAll();
+    }
+
+    start(sourceName);
+    if (records.isEmpty() || !open())
+        return;
+
+    file.write(records);
+    file.flush();
+    unsynced = true;
+}
+
+/**
+* remove journal file, when document is saved or discarded.
+*/
+void journal::remove(){
+    if (!file.isOpen())
+        return;
+
+    file.close();
+    file.remove();
+    headerSize = 0;
+    unsynced = false;
+}
+
+/**
+* write records to disk.
+* records are flushed to system when they are appended, and synced periodically.
+*/
+bool journal::sync(){
+    if (!unsynced || !file.isOpen())
+        return true;
+
+    unsynced = false;
+    return syncFile(file);
+}
+
+void journal::insertNode(const nodePtr& parent, int index, const nodePtr& node){
+    QByteArray record;
+    QDataStream out(&record, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_4_5);
+    out << quint8(eInsertNode);
+    writePath(out, parent.get());
+    out << quint32(index);
+    writeTree(out, node.get());
+    append(record);
+}
+
+/**
+* this must be written before node is deleted, while its path is valid.
+*/
+void journal::deleteNode(const nodePtr& node, bool deleteChildren){
+    QByteArray record;
+    QDataStream out(&record, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_4_5);
+    out << quint8(eDeleteNode);
+    writePath(out, node.get());
+    out << deleteChildren;
+    append(record);
+}
+
+/**
+* node is inserted to index of parent, and children of node were children of parent from index.
+*/
+void journal::groupNodes(const nodePtr& parent, int index, const nodePtr& node){
+    QByteArray record;
+    QDataStream out(&record, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_4_5);
+    out << quint8(eGroupNodes);
+    writePath(out, parent.get());
+    out << quint32(index);
+    writeNode(out, node.get());
+    append(record);
+}
+
+/**
+* write move and properties of modified node.
+*/
+void journal::setNode(const nodePtr& node){
+    QByteArray record;
+    QDataStream out(&record, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_4_5);
+    out << quint8(eSetNode);
+    writePath(out, node.get());
+    writeNode(out, node.get());
+    append(record);
+}
+
+/**
+* write all nodes of tree from node in one record, when their moves are changed at once.
+*/
+void journal::setTree(const nodePtr& node){
+    QByteArray record;
+    QDataStream out(&record, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_4_5);
+    out << quint8(eSetTree);
+    writePath(out, node.get());
+    writeTree(out, node.get());
+    append(record);
+}
+
+void journal::setInformation(const informationPtr& info){
+    QByteArray record;
+    QDataStream out(&record, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_4_5);
+    out << quint8(eSetInformation) << quint32(gameIndex(info.get()));
+    writeInformation(out, info.get());
+    append(record);
+}
+
+void journal::moveGame(int from, int to){
+    QByteArray record;
+    QDataStream out(&record, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_4_5);
+    out << quint8(eMoveGame) << quint32(from) << quint32(to);
+    append(record);
+}
+
+void journal::deleteGame(int index){
+    QByteArray record;
+    QDataStream out(&record, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_4_5);
+    out << quint8(eDeleteGame) << quint32(index);
+    append(record);
+}
+
+/**
+* write games added to collection from first.
+*/
+void journal::addGames(int first){
+    for (int i=first; i<data_.rootList.size(); ++i){
+        QByteArray record;
+        QDataStream out(&record, QIODevice::WriteOnly);
+        out.setVersion(QDataStream::Qt_4_5);
+        out << quint8(eAddGame);
+        writeGame(out, data_.rootList[i]);
+        append(record);
+    }
+}
+
+/**
+* write all games, for document which is not read from file.
+*/
+void journal::setGames(){
+    QByteArray record;
+    QDataStream out(&record, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_4_5);
+    out << quint8(eClearGames);
+    append(record);
+
+    addGames(0);
+}
+
+QString journal::directory(){
+    QString dir = QDesktopServices::storageLocation(QDesktopServices::DataLocation);
+    if (dir.isEmpty())
+        return QString();
+    return dir + "/journal";
+}
+
+/**
+* journals left by documents which were not saved or closed.
+*/
+QStringList journal::files(){
+    QStringList files;
+    QString dir = directory();
+    if (dir.isEmpty())
+        return files;
+
+    QDir d(dir);
+    foreach(const QString& name, d.entryList(QStringList("*.journal"), QDir::Files))
+        files.push_back( d.absoluteFilePath(name) );
+    return files;
+}
+
+/**
+* returns false if fname is not journal, or its source file is changed.
+*/
+bool journal::readSource(const QString& fname, QString& sourceName){
+    QFile f(fname);
+    if (!f.open(QIODevice::ReadOnly))
+        return false;
+
+    QDataStream in(&f);
+    in.setVersion(QDataStream::Qt_4_5);
+    return readHeader(in, sourceName);
+}
+
+/**
+* create journal file with header.
+*/
+bool journal::open(){
+    if (file.isOpen())
+        return true;
+
+    QString dir = directory();
+    if (dir.isEmpty())
+        return false;
+    QDir().mkpath(dir);
+
+    file.setFileName( dir + "/" + QUuid::createUuid().toString().mid(1, 36) + ".journal" );
+    if (!file.open(QIODevice::ReadWrite | QIODevice::Truncate))
+        return false;
+
+    QFileInfo fi(sourceName);
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_4_5);
+    out << journalMagic << journalVersion << sourceName
+        << (sourceName.isEmpty() ? qint64(0) : fi.size())
+        << (sourceName.isEmpty() ? quint32(0) : quint32(fi.lastModified().toTime_t()));
+    headerSize = file.pos();
+    unsynced = true;
+
+    return out.status() == QDataStream::Ok;
+}
+
+/**
+* append record with its length and checksum, which detect record broken by crash.
+*/
+bool journal::append(const QByteArray& record){
+    if (!open())
+        return false;
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_4_5);
+    out << quint32(record.size()) << qChecksum(record.constData(), record.size());
+    out.writeRawData(record.constData(), record.size());
+    unsynced = true;
+
+    return out.status() == QDataStream::Ok && file.flush();
+}
+
+/**
+* write game number and path from root to n.
+* path is written as runs of same index, so main line is short.
+*/
+void journal::writePath(QDataStream& out, const node* n) const{
+    QVector<quint32> indexes;
+    for (nodePtr parent = n->parent(); parent; parent = parent->parent()){
+        indexes.push_back( childIndex(parent, n) );
+        n = parent.get();
+    }
+
+    QVector< QPair<quint32, quint32> > runs;
+    for (int i=indexes.size()-1; i>=0; --i){
+        if (!runs.empty() && runs.back().first == indexes[i])
+            ++runs.back().second;
+        else
+            runs.push_back( qMakePair(indexes[i], quint32(1)) );
+    }
+
+    out << quint32(gameIndex(n->information())) << quint32(runs.size());
+    for (int i=0; i<runs.size(); ++i)
+        out << runs[i].first << runs[i].second;
+}
+
+/**
+* write game information and tree.
+* game which is not loaded is parsed to temporary node.
+*/
+void journal::writeGame(QDataStream& out, const informationPtr& info) const{
+    informationPtr game = info;
+    if (!info->isLoaded()){
+        game.reset(new informationNode);
+        info->loader->parse(game.get());
+    }
+
+    writeInformation(out, game.get());
+    writeTree(out, game.get());
+}
+
+int journal::gameIndex(const informationNode* info) const{
+    if (data_.root.get() == info)
+        return data_.rootList.indexOf(data_.root);
+
+    for (int i=0; i<data_.rootList.size(); ++i)
+        if (data_.rootList[i].get() == info)
+            return i;
+    return -1;
+}
+
+
+}
@@ -0,0 +1,94 @@
+/*
+    mugo, sgf editor.
+    Copyright (C) 2009-2010 nsase.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __journal_h__
+#define __journal_h__
+
+#include <QFile>
+#include <QStringList>
+#include "godata.h"
+
+namespace go{
+
+
+/**
+* append-only log of edits of one document.
+* each edit is appended as small record, so unsaved document is rebuilt
+* from its last saved file and journal after crash.
+* nodes are addressed by game number and indexes of children from root.
+*/
+class journal{
+public:
+    enum eRecord{
+        eInsertNode = 1,  // parent, index, tree
+        eDeleteNode,      // node, deleteChildren
+        eGroupNodes,      // parent, index, node which takes children from index
+        eSetNode,         // node, node
+        eSetInformation,  // game, information
+        eMoveGame,        // game, index
+        eDeleteGame,      // game
+        eClearGames,      //
+        eAddGame,         // information, tree
+        eSetTree,         // node, nodes of its subtree in order of writeTree
+    };
+    enum{ syncInterval = 3000 };  // msec
+
+    journal(const data& data) : data_(data), headerSize(0), unsynced(false){}
+    ~journal(){ remove(); }
+
+    void start(const QString& sourceName);
+    bool recover(const QString& fname, data& data);
+    void rebase(const QString& sourceName, qint64 pos);
+    void remove();
+    bool sync();
+    qint64 size() const{ return file.isOpen() ? file.size() : 0; }
+
+    void insertNode(const nodePtr& parent, int index, const nodePtr& node);
+    void deleteNode(const nodePtr& node, bool deleteChildren);
+    void groupNodes(const nodePtr& parent, int index, const nodePtr& node);
+    void setNode(const nodePtr& node);
+    void setTree(const nodePtr& node);
+    void setInformation(const informationPtr& info);
+    void moveGame(int from, int to);
+    void deleteGame(int index);
+    void addGames(int first);
+    void setGames();
+
+    static QString directory();
+    static QStringList files();
+    static bool readSource(const QString& fname, QString& sourceName);
+
+private:
+    bool open();
+    bool append(const QByteArray& record);
+    void writePath(QDataStream& out, const node* n) const;
+    void writeGame(QDataStream& out, const informationPtr& info) const;
+    int  gameIndex(const informationNode* info) const;
+
+    const data& data_;
+    QString sourceName;  // file which edits are applied to, empty for new document
+    QFile file;
+    qint64 headerSize;
+    bool unsynced;
+
+    Q_DISABLE_COPY(journal)
+};
+
+
+}
+
+#endif
@@ -29,12 +29,19 @@
 #include <QProgressDialog>
 #include <QDateTime>
 #include <QPainter>
+#include <QTimer>
+#include <QPointer>
+#include <QThreadPool>
+#include <QFutureWatcher>
+#include <QtConcurrentRun>
 #include "appdef.h"
 #include "mugoapp.h"
 #include "sgf.h"
 #include "ugf.h"
 #include "gib.h"
 #include "ngf.h"
+#include "snapshot.h"
+#include "readers.h"
 #include "gtp.h"
 #include "mainwindow.h"
 #include "setupdialog.h"
@@ -52,6 +59,95 @@ Q_DECLARE_METATYPE(go::nodePtr);
 Q_DECLARE_METATYPE(go::informationPtr);
 
 
+/**
+* file read in worker thread.
+*/
+class openTask{
+public:
+    openTask(const QString& fname_, QTextCodec* codec_, bool guessCodec_, bool useSnapshot_)
+        : fname(fname_), codec(codec_), guessCodec(guessCodec_), useSnapshot(useSnapshot_), data(NULL), cached(false){}
+
+    void run(){
+        // large file is read from its snapshot if it is not changed after last opening.
+        if (useSnapshot){
+            go::snapshot* snapshot = new go::snapshot;
+            snapshot->progress = &progress;
+            if (snapshot->read(fname, codec, guessCodec)){
+                snapshot->progress = NULL;
+                codec  = snapshot->codec;
+                data   = snapshot;
+                cached = true;
+                return;
+            }
+            delete snapshot;
+        }
+
+        data = go::readFile(fname, codec, guessCodec, &progress);
+        if (data)
+            data->progress = NULL;
+    }
+
+    QString fname;
+    QTextCodec* codec;
+    bool guessCodec;
+    bool useSnapshot;
+    go::fileProgress progress;
+    go::fileBase* data;
+    bool cached;
+};
+
+/**
+* file saved in worker thread.
+* games are copied when saving starts, so board can be edited while saving.
+*/
+class saveTask{
+public:
+    saveTask() : codec(NULL), result(false), editCount(0), journalSize(0), background(false), dialog(NULL){}
+
+    void run(){
+        sgf.progress = &progress;
+        result = sgf.save(fname, codec);
+    }
+
+    go::sgf sgf;
+    QString fname;
+    QTextCodec* codec;
+    go::fileProgress progress;
+    bool result;
+
+    QPointer<BoardWidget> board;
+    int editCount;
+    qint64 journalSize;  // edits after this are not saved
+    bool background;
+    QProgressDialog* dialog;
+    QFutureWatcher<void> watcher;
+};
+
+/**
+* copy games of data for worker thread.
+*/
+static void copyData(const go::data& data, go::fileBase& file){
+    go::data copy;
+    copy.rootList.clear();
+    foreach(const go::informationPtr& game, data.rootList)
+        copy.rootList.push_back( go::copyGame(game) );
+    copy.root = copy.rootList.front();
+    file.set(copy);
+}
+
+static void saveSnapshot(go::snapshot* snapshot, const QString& fname, QTextCodec* codec){
+    snapshot->save(fname, codec);
+    delete snapshot;
+}
+
+static void updateProgress(QProgressDialog* dialog, go::fileProgress& progress){
+    dialog->setMaximum(progress.maximum);
+    dialog->setValue(progress.value);
+    if (dialog->wasCanceled())
+        progress.canceled = 1;
+}
+
+
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
@@ -160,6 +256,16 @@ MainWindow::MainWindow(QWidget *parent)
     }
     updateRecentFileActions();
 
+    // progress of files saved in background
+    saveTimer = new QTimer(this);
+    saveTimer->setInterval(100);
+    connect( saveTimer, SIGNAL(timeout()), this, SLOT(updateSaveProgress()) );
+
+    // edit journals are written to disk periodically
+    journalTimer = new QTimer(this);
+    journalTimer->start(go::journal::syncInterval);
+    connect( journalTimer, SIGNAL(timeout()), this, SLOT(syncJournals()) );
+
     // create undo/redo actions
     ui->undoView->setGroup(&undoGroup);
 
@@ -281,9 +387,18 @@ MainWindow::MainWindow(QWidget *parent)
 
     //
     ui->boardTabWidget->removeTab(0);
+
+    recoverJournals();
 }
 
 MainWindow::~MainWindow(){
+    // files saved in background must be written before quit.
+    while (!saveTasks.isEmpty()){
+        saveTasks.front()->watcher.waitForFinished();
+        finishSave(saveTasks.front());
+    }
+    QThreadPool::globalInstance()->waitForDone();
+
     QSettings settings;
     settings.setValue("mainwindowGeometry", saveGeometry());
     settings.setValue("docksState", saveState());
@@ -336,17 +451,9 @@ void MainWindow::dragEnterEvent(QDragEnterEvent* event)
         event->acceptProposedAction();
     else{
 */
-        const char* ext[] = {"sgf", "ugf", "ugi", "gib", "ngf"};
-        int N = sizeof(ext) / sizeof(ext[0]);
-
         QString localFile = event->mimeData()->urls().front().toLocalFile();
-        QFileInfo f(localFile);
-
-        for (int i=0; i<N; ++i)
-            if (f.suffix().compare(ext[i], Qt::CaseInsensitive) == 0){
-                event->acceptProposedAction();
-                break;
-            }
+        if (go::isReadable(localFile))
+            event->acceptProposedAction();
 //    }
 }
 
@@ -419,7 +526,7 @@ void MainWindow::on_actionReload_triggered(){
 * File -> Save
 */
 void MainWindow::on_actionSave_triggered(){
-    fileSave( currentBoard() );
+    fileSave( currentBoard(), true );
 }
 
 /**
@@ -427,7 +534,7 @@ void MainWindow::on_actionSave_triggered(){
 * File -> Save As
 */
 void MainWindow::on_actionSaveAs_triggered(){
-    fileSaveAs( currentBoard() );
+    fileSaveAs( currentBoard(), true );
 }
 
 /**
@@ -476,6 +583,7 @@ void MainWindow::on_actionCollectionExtract_triggered(){
 
     currentBoard()->setData(sgf);
     currentBoard()->setDirty(true);
+    currentBoard()->journal().setGames();
     setTreeData( currentBoard() );
     setCaption();
     updateCollection();
@@ -492,13 +600,16 @@ void MainWindow::on_actionCollectionImport_triggered(){
 
     TabData& tabData = tabDatas[currentBoard()];
 
-    QTextCodec* codec = tabData.codec;
-    go::fileBase* data = readFile(fname, codec, true);
-    if (data == NULL)
+    openTask task(fname, tabData.codec, true, false);
+    if (!waitForTask(QtConcurrent::run(&task, &openTask::run), task.progress, tr("Opening %1").arg(QFileInfo(fname).fileName())) || task.data == NULL){
+        delete task.data;
         return;
+    }
 
-    currentBoard()->addData(*data);
-    delete data;
+    int count = currentBoard()->getData().rootList.size();
+    currentBoard()->addData(*task.data);
+    currentBoard()->journal().addGames(count);
+    delete task.data;
 
     setCaption();
     updateCollection();
@@ -521,6 +632,7 @@ void MainWindow::on_actionCollectionMoveUp_triggered(){
     if (iter == rootList.end() || iter == rootList.begin())
         return;
     qSwap(*iter, *(iter-1));
+    currentBoard()->journal().moveGame(iter - rootList.begin(), iter - rootList.begin() - 1);
 
     int currentNo = item->text(0).toInt();
     item->setText(0, QString().sprintf("%5d", --currentNo));
@@ -557,6 +669,7 @@ void MainWindow::on_actionCollectionMoveDown_triggered(){
     if (iter == rootList.end() || iter+1 == rootList.end())
         return;
     qSwap(*iter, *(iter+1));
+    currentBoard()->journal().moveGame(iter - rootList.begin(), iter - rootList.begin() + 1);
 
     int currentNo = item->text(0).toInt();
     item->setText(0, QString().sprintf("%5d", ++currentNo));
@@ -595,6 +708,7 @@ void MainWindow::on_actionDeleteSgfFromCollection_triggered(){
         QMessageBox::warning(this, QString(), tr("Remove sgf from collection failed because this sgf is editing."));
         return;
     }
+    currentBoard()->journal().deleteGame(iter - rootList.begin());
     rootList.erase(iter);
 
     int currentNo = item->text(0).toInt();
@@ -726,9 +840,7 @@ void MainWindow::on_actionCopyCurrentSgfToClipboard_triggered(){
             s.clear();
         }
 
-        go::sgf::node node;
-        node.set(*iter);
-        s.append( node.toString() );
+        go::sgf::writeProperties(s, iter->get(), NULL);
         ++iter;
     }
     str.append(s);
@@ -754,6 +866,7 @@ void MainWindow::on_actionPasteSgfToNewTab_triggered(){
 
     currentBoard()->setData(sgf);
     currentBoard()->setDirty(true);
+    currentBoard()->journal().setGames();
 
     setTreeData( currentBoard() );
     setCaption();
@@ -772,7 +885,9 @@ void MainWindow::on_actionPasteSgfToCollection_triggered(){
     QString::iterator first = str.begin();
     sgf.readStream(first, str.end());
 
+    int count = currentBoard()->getData().rootList.size();
     currentBoard()->addData(sgf);
+    currentBoard()->journal().addGames(count);
 
     setTreeData( currentBoard() );
     setCaption();
@@ -809,6 +924,7 @@ void MainWindow::on_actionGameInformation_triggered(){
         return;
 
     currentBoard()->setDirty(true);
+    currentBoard()->journal().setInformation( currentBoard()->getData().root );
     setCaption();
     updateCollection();
 }
@@ -1064,7 +1180,7 @@ void MainWindow::on_actionEditNodeName_triggered(){
     go::nodePtr node = currentBoard()->getCurrentNode();
     QInputDialog dlg(this);
     dlg.setLabelText( tr("Input node name") );
-    dlg.setTextValue(node->name);
+    dlg.setTextValue(node->name());
     if (dlg.exec() != QDialog::Accepted)
         return;
     currentBoard()->setNodeNameCommand(node, dlg.textValue());
@@ -1222,7 +1338,7 @@ void MainWindow::on_actionBackToParent_triggered(){
     go::nodePtr node = currentBoard()->getCurrentNode();
     while(node->parent()){
         node = node->parent();
-        if (node->childNodes.size() > 1)
+        if (node->childNodes().size() > 1)
             break;
     }
     currentBoard()->setCurrentNode( node );
@@ -1236,7 +1352,7 @@ void MainWindow::on_actionPreviousBranch_triggered(){
     go::nodePtr node   = currentBoard()->getCurrentNode();
     go::nodePtr parent = node->parent();
     while(parent){
-        if (parent->childNodes.size() > 1)
+        if (parent->childNodes().size() > 1)
             break;
         node = parent;
         parent = parent->parent();
@@ -1245,11 +1361,11 @@ void MainWindow::on_actionPreviousBranch_triggered(){
     if (parent == NULL)
         return;
 
-    go::nodeList::iterator iter = qFind(parent->childNodes.begin(), parent->childNodes.end(), node);
-    if (iter == parent->childNodes.begin())
+    int index = parent->childNodes().indexOf(node);
+    if (index <= 0)
         return;
 
-    currentBoard()->setCurrentNode( *--iter );
+    currentBoard()->setCurrentNode( parent->childNodes()[index - 1] );
 }
 
 /**
@@ -1260,7 +1376,7 @@ void MainWindow::on_actionNextBranch_triggered(){
     go::nodePtr node   = currentBoard()->getCurrentNode();
     go::nodePtr parent = node->parent();
     while(parent){
-        if (parent->childNodes.size() > 1)
+        if (parent->childNodes().size() > 1)
             break;
         node = parent;
         parent = parent->parent();
@@ -1269,8 +1385,8 @@ void MainWindow::on_actionNextBranch_triggered(){
     if (parent == NULL)
         return;
 
-    go::nodeList::iterator iter = qFind(parent->childNodes.begin(), parent->childNodes.end(), node);
-    if (++iter == parent->childNodes.end())
+    go::childList::iterator iter = qFind(parent->childNodes().begin(), parent->childNodes().end(), node);
+    if (++iter == parent->childNodes().end())
         return;
 
     currentBoard()->setCurrentNode( *iter );
@@ -1839,7 +1955,7 @@ void MainWindow::on_boardTabWidget_currentChanged(QWidget* widget){
     // undo
     undoGroup.setActiveStack(board->getUndoStack());
 
-    ui->commentWidget->setPlainText(board->getCurrentNode()->comment);
+    ui->commentWidget->setPlainText(board->getCurrentNode()->comment());
 
     setCaption();
     updateMenu();
@@ -1866,7 +1982,7 @@ void MainWindow::boardCleared(){
 void MainWindow::nodeAdded(go::nodePtr parent, go::nodePtr node, bool /*select*/){
     BoardWidget* board = qobject_cast<BoardWidget*>(sender());
     TabData& tabData = tabDatas[board];
-    if (parent->childNodes.back() == node)
+    if (parent->childNodes().back() == node)
         addTreeWidget(board, node, true, tabData.branchWidget->invisibleRootItem());
     else
         remakeTreeWidget( board, tabData.nodeToTree[node->parent()] );
@@ -1876,10 +1992,11 @@ void MainWindow::nodeAdded(go::nodePtr parent, go::nodePtr node, bool /*select*/
 /**
 * Slot
 * node was deleted by BoardWidget.
+* children are former children of node, which may be moved to its parent.
 */
-void MainWindow::nodeDeleted(go::nodePtr node, bool deleteChildren){
+void MainWindow::nodeDeleted(go::nodePtr node, const go::nodeList& children){
     BoardWidget* board = qobject_cast<BoardWidget*>(sender());
-    deleteTreeWidget(board, node, deleteChildren);
+    deleteTreeWidget(board, node, children);
     if (node->parent())
         remakeTreeWidget( board, tabDatas[board].nodeToTree[node->parent()] );
     setCaption();
@@ -1907,8 +2024,8 @@ void MainWindow::currentNodeChanged(go::nodePtr node){
     BoardWidget* board = qobject_cast<BoardWidget*>(sender());
 
     setTreeWidget(board, node);
-    ui->commentWidget->setPlainText(node->comment);
-    setAnnotation(node->annotation, node->moveAnnotation, node->nodeAnnotation);
+    ui->commentWidget->setPlainText(node->comment());
+    setAnnotation(node->annotation(), node->moveAnnotation(), node->nodeAnnotation());
 
     int b, w;
     board->getCaptured(b, w);
@@ -1973,7 +2090,7 @@ void MainWindow::branchWidget_customContextMenuRequested(const QPoint& pos){
 
     QVariant v = current->data(0, Qt::UserRole);
     go::nodePtr n = v.value<go::nodePtr>();
-    if ( dynamic_cast<go::informationNode*>(n.get()) != NULL ){
+    if ( go::informationCast(n.get()) != NULL ){
         QMenu menu(this);
         menu.addAction( ui->actionGameInformation );
         menu.exec( tree->mapToGlobal(pos) );
@@ -1988,7 +2105,7 @@ void MainWindow::branchWidget_customContextMenuRequested(const QPoint& pos){
         menu.addAction( ui->actionDeleteOnlyCurrent );
 
 /*
-        if (n->parent()->childNodes.size() > 1){
+        if (n->parent()->childNodes().size() > 1){
             menu.addSeparator();
             menu.addAction(ui->actionBranchMoveUp);
             menu.addAction(ui->actionBranchMoveDown);
@@ -2248,7 +2365,7 @@ void MainWindow::updateMenu(){
             break;
     };
 
-    setAnnotation(boardWidget->getCurrentNode()->annotation, boardWidget->getCurrentNode()->moveAnnotation, boardWidget->getCurrentNode()->nodeAnnotation);
+    setAnnotation(boardWidget->getCurrentNode()->annotation(), boardWidget->getCurrentNode()->moveAnnotation(), boardWidget->getCurrentNode()->nodeAnnotation());
 
     ui->actionWhiteFirst->setChecked( boardWidget->whiteFirst() );
 
@@ -2354,7 +2471,7 @@ void MainWindow::addDocument(BoardWidget* board){
     // board widget
     connect(board, SIGNAL(cleared()), this, SLOT(boardCleared()));
     connect(board, SIGNAL(nodeAdded(go::nodePtr,go::nodePtr,bool)), this, SLOT(nodeAdded(go::nodePtr,go::nodePtr,bool)));
-    connect(board, SIGNAL(nodeDeleted(go::nodePtr,bool)), this, SLOT(nodeDeleted(go::nodePtr, bool)));
+    connect(board, SIGNAL(nodeDeleted(go::nodePtr,go::nodeList)), this, SLOT(nodeDeleted(go::nodePtr, go::nodeList)));
     connect(board, SIGNAL(nodeModified(go::nodePtr)), this, SLOT(nodeModified(go::nodePtr)));
     connect(board, SIGNAL(currentNodeChanged(go::nodePtr)), this, SLOT(currentNodeChanged(go::nodePtr)));
     connect(board, SIGNAL(updateTerritory(int,int,int,int,int,int,int,int,double)), this, SLOT(updateTerritory(int,int,int,int,int,int,int,int,double)));
@@ -2421,19 +2538,39 @@ bool MainWindow::fileOpen(const QString& fname, bool guessCodec, bool newTab, bo
         }
     }
 
-    QTextCodec* codec = newTab == true ? defaultCodec : tabDatas[currentBoard()].codec;
+    QTextCodec* requestedCodec = newTab == true ? defaultCodec : tabDatas[currentBoard()].codec;
 
-    go::fileBase* data = readFile(fname, codec, guessCodec);
-    if (data == NULL)
+    // file is read in worker thread while progress is shown.
+    // new tab shows first game of collection while rest of file is read.
+    openTask task(fname, requestedCodec, guessCodec, true);
+    BoardWidget* preview = NULL;
+    if (!waitForTask(QtConcurrent::run(&task, &openTask::run), task.progress, tr("Opening %1").arg(fi1.fileName()), newTab ? &preview : NULL) || task.data == NULL){
+        delete task.data;
+        if (preview)
+            closeTab( ui->boardTabWidget->indexOf(preview) );
         return false;
+    }
+    QTextCodec* codec = task.codec;
 
     BoardWidget* board = currentBoard();
-    if (newTab){
+    if (preview)
+        board = preview;
+    else if (newTab){
         board = new BoardWidget;
         addDocument(board);
     }
-    board->setData(*data);
-    delete data;
+    board->setData(*task.data);
+    board->journal().start(fname);
+    delete task.data;
+
+    // snapshot of large file is saved in background.
+    if (!task.cached && fi1.size() >= go::snapshot::minimumFileSize){
+        go::snapshot* snapshot = new go::snapshot;
+        snapshot->guessCodec = guessCodec;
+        snapshot->requestedCodec = requestedCodec;
+        copyData(board->getData(), *snapshot);
+        QtConcurrent::run(saveSnapshot, snapshot, fname, codec);
+    }
 
     setFileName(board, fname);
     setTreeData(board);
@@ -2476,53 +2613,25 @@ bool MainWindow::urlOpen(const QUrl& url){
 }
 
 go::fileBase* MainWindow::readFile(const QString& fname, QTextCodec*& codec, bool guessCodec){
-#define READ_FILE(FORMAT){\
-    go::FORMAT* data = new go::FORMAT;\
-    if (data->read(fname, codec, guessCodec)){\
-        codec = data->codec;\
-        return data;\
-    }\
-    else{\
-        delete data;\
-        return NULL;\
-    }\
-}
-
-    QFileInfo info(fname);
-    QString ext = info.suffix().toLower();
-
-    if (ext.compare("sgf") == 0){
-        READ_FILE(sgf);
-    }
-    else if (ext.compare("ugf") == 0 || ext.compare("ugi") == 0){
-        READ_FILE(ugf);
-    }
-    else if (ext.compare("gib") == 0){
-        READ_FILE(gib);
-    }
-    else if (ext.compare("ngf") == 0){
-        READ_FILE(ngf);
-    }
-    else
-        return NULL;
+    return go::readFile(fname, codec, guessCodec);
 }
 
 /**
 * file save.
 */
-bool MainWindow::fileSave(BoardWidget* boardWidget){
+bool MainWindow::fileSave(BoardWidget* boardWidget, bool background){
     const QString& fileName = tabDatas[boardWidget].fileName;
     QFileInfo fi(fileName);
     if (fileName.isEmpty() || fi.suffix().compare("sgf", Qt::CaseInsensitive) != 0)
-        return fileSaveAs(boardWidget);
+        return fileSaveAs(boardWidget, background);
     else
-        return fileSaveAs(boardWidget, fileName);
+        return fileSaveAs(boardWidget, fileName, background);
 }
 
 /**
 * file saveas.
 */
-bool MainWindow::fileSaveAs(BoardWidget* boardWidget){
+bool MainWindow::fileSaveAs(BoardWidget* boardWidget, bool background){
     QString filter = tr("sgf(*.sgf)");
 
     TabData& tabData = tabDatas[boardWidget];
@@ -2547,24 +2656,213 @@ bool MainWindow::fileSaveAs(BoardWidget* boardWidget){
     if (fi.suffix().isEmpty())
         fname.append(".sgf");
 
-    return fileSaveAs(boardWidget, fname);
+    return fileSaveAs(boardWidget, fname, background);
 }
 
 /**
 * file saveas.
 */
-bool MainWindow::fileSaveAs(BoardWidget* boardWidget, const QString& fname){
+bool MainWindow::fileSaveAs(BoardWidget* boardWidget, const QString& fname, bool background){
+    // previous saving to same file or of same board must be finished before.
+    for (int i=0; i<saveTasks.size(); ){
+        saveTask* task = saveTasks[i];
+        if (task->background && (task->fname == fname || task->board == boardWidget)){
+            task->watcher.waitForFinished();
+            finishSave(task);
+        }
+        else
+            ++i;
+    }
+
     setFileName(boardWidget, fname);
-    go::sgf sgf;
-    boardWidget->getData(sgf);
-    sgf.save(fname, tabDatas[boardWidget].codec);
-    boardWidget->setDirty(false);
 
-    setCaption();
+    // games are copied, then saved in worker thread.
+    saveTask* task = new saveTask;
+    copyData(boardWidget->getData(), task->sgf);
+    task->fname = fname;
+    task->codec = tabDatas[boardWidget].codec;
+    task->board = boardWidget;
+    task->editCount = boardWidget->editCount();
+    task->journalSize = boardWidget->journal().size();
+    task->background = background;
+    task->dialog = new QProgressDialog(tr("Saving %1").arg(QFileInfo(fname).fileName()), tr("Cancel"), 0, 0, this);
+    task->dialog->setMinimumDuration(500);
+    task->dialog->setAutoReset(false);
+    task->dialog->setAutoClose(false);
+    saveTasks.push_back(task);
 
     ui->actionReload->setEnabled(true);
 
-    return true;
+    if (background){
+        task->dialog->setWindowModality(Qt::NonModal);
+        connect( &task->watcher, SIGNAL(finished()), this, SLOT(saveFinished()) );
+        task->watcher.setFuture( QtConcurrent::run(task, &saveTask::run) );
+        saveTimer->start();
+        setCaption();
+        return true;
+    }
+
+    // dialog is shown at once, so board can't be edited while it is saved.
+    task->dialog->setWindowModality(Qt::WindowModal);
+    task->dialog->setMinimumDuration(0);
+    task->dialog->show();
+    task->watcher.setFuture( QtConcurrent::run(task, &saveTask::run) );
+    saveTimer->start();
+    while (!task->watcher.isFinished())
+        qApp->processEvents(QEventLoop::WaitForMoreEvents);
+    return finishSave(task);
+}
+
+/**
+* wait for file reading in worker thread.
+* dialog is shown at once, so documents are not edited while waiting.
+* if preview is not NULL, new tab is added to it when first game of collection is read.
+* returns false if it was canceled.
+*/
+bool MainWindow::waitForTask(const QFuture<void>& future, go::fileProgress& progress, const QString& label, BoardWidget** preview){
+    QProgressDialog dialog(label, tr("Cancel"), 0, 0, this);
+    dialog.setWindowModality(Qt::WindowModal);
+    dialog.setMinimumDuration(0);
+    dialog.setAutoReset(false);
+    dialog.setAutoClose(false);
+    dialog.show();
+
+    QFutureWatcher<void> watcher;
+    QTimer timer;
+    timer.setInterval(100);
+    timer.start();
+    watcher.setFuture(future);
+    while (!watcher.isFinished()){
+        qApp->processEvents(QEventLoop::WaitForMoreEvents);
+        updateProgress(&dialog, progress);
+
+        go::informationPtr game = preview && *preview == NULL ? progress.firstGame() : go::informationPtr();
+        if (game){
+            go::data data;
+            data.rootList.clear();
+            data.rootList.push_back(game);
+            data.root = game;
+
+            *preview = new BoardWidget;
+            addDocument(*preview);
+            (*preview)->setData(data);
+            setTreeData(*preview);
+            setCaption();
+        }
+    }
+
+    return progress.canceled == 0;
+}
+
+/**
+* file saving is finished.
+*/
+bool MainWindow::finishSave(saveTask* task){
+    saveTasks.removeOne(task);
+    if (saveTasks.isEmpty())
+        saveTimer->stop();
+
+    bool result = task->result;
+    bool canceled = task->progress.canceled != 0;
+
+    // board is clean only if it was not edited while saving.
+    // journal keeps only edits while saving.
+    if (result && task->board){
+        task->board->journal().rebase(task->fname, task->journalSize);
+        if (task->board->editCount() == task->editCount)
+            task->board->setDirty(false);
+    }
+
+    delete task->dialog;
+    QString fname = task->fname;
+    delete task;
+
+    if (!result && !canceled)
+        QMessageBox::warning(this, APPNAME, tr("Cannot write file %1.").arg(fname));
+
+    setCaption();
+
+    return result;
+}
+
+/**
+* Slot
+* file saving in background is finished.
+*/
+void MainWindow::saveFinished(){
+    for (int i=0; i<saveTasks.size(); ){
+        saveTask* task = saveTasks[i];
+        if (task->background && task->watcher.isFinished())
+            finishSave(task);
+        else
+            ++i;
+    }
+}
+
+/**
+* rebuild documents, which were not saved when mugo quit, from their journals.
+*/
+void MainWindow::recoverJournals(){
+    QStringList files = go::journal::files();
+    if (files.isEmpty())
+        return;
+
+    QMessageBox::StandardButton ret =
+    QMessageBox::question(this, APPNAME,
+                          tr("Some documents were not saved when mugo quit.\n"
+                             "Do you want to recover them?"),
+                          QMessageBox::Yes | QMessageBox::No);
+
+    foreach(const QString& fname, files){
+        // journal is removed if its source file is changed.
+        QString sourceName;
+        if (ret != QMessageBox::Yes || !go::journal::readSource(fname, sourceName)){
+            QFile::remove(fname);
+            continue;
+        }
+
+        if (sourceName.isEmpty())
+            fileNew();
+        else if (!fileOpen(sourceName, true, true, true)){
+            QFile::remove(fname);
+            continue;
+        }
+
+        BoardWidget* board = currentBoard();
+        go::data& data = board->getData();
+        if (!board->journal().recover(fname, data))
+            QMessageBox::warning(this, APPNAME, tr("Some edits of %1 could not be recovered.").arg(tabDatas[board].documentName));
+
+        if (data.rootList.empty())
+            data.rootList.push_back(data.root);
+        go::informationPtr root = data.rootList.contains(data.root) ? data.root : data.rootList.front();
+        board->setRoot(root);
+        board->setDirty(true);
+        setTreeData(board);
+        setCaption();
+        updateCollection();
+    }
+}
+
+/**
+* Slot
+* write edit journals of documents to disk.
+*/
+void MainWindow::syncJournals(){
+    TabDataMap::iterator iter = tabDatas.begin();
+    while (iter != tabDatas.end()){
+        iter.key()->journal().sync();
+        ++iter;
+    }
+}
+
+/**
+* Slot
+* update progress of files saved in background.
+*/
+void MainWindow::updateSaveProgress(){
+    foreach(saveTask* task, saveTasks)
+        updateProgress(task->dialog, task->progress);
 }
 
 /**
@@ -2721,11 +3019,15 @@ void MainWindow::openUrlDone(bool error){
         return;
     }
 
-    go::sgf sgf;
-    sgf.read(downloadBuff, defaultCodec, true);
-
+    QTextCodec* codec = defaultCodec;
+    go::fileBase* data = go::readBytes(downloadBuff, tabDatas[currentBoard()].documentName, codec, true);
     downloadBuff.clear();
-    currentBoard()->setData(sgf);
+    if (data == NULL)
+        return;
+
+    currentBoard()->setData(*data);
+    currentBoard()->journal().start( tabDatas[currentBoard()].url.toString() );
+    delete data;
 
     setTreeData(currentBoard());
     setCaption();
@@ -2779,20 +3081,17 @@ QTreeWidgetItem* MainWindow::addTreeWidget(BoardWidget* board, go::nodePtr node,
     bool newBranch = false;
     int  index = 0;
 
-    if (parentNode2 && parentNode2->childNodes.size() > 1){
+    if (parentNode2 && parentNode2->childNodes().size() > 1){
         newBranch = true;
-        go::nodeList::iterator iter = qFind(node->parent()->childNodes.begin(), node->parent()->childNodes.end(), node);
-        index = std::distance(node->parent()->childNodes.begin(), iter);
+        index = node->parent()->childNodes().indexOf(node);
     }
-    else if (tabData.branchMode && parentNode && parentNode->childNodes.size() > 1){
+    else if (tabData.branchMode && parentNode && parentNode->childNodes().size() > 1){
         newBranch = true;
-        go::nodeList::iterator iter = qFind(node->parent()->childNodes.begin(), node->parent()->childNodes.end(), node);
-        index = std::distance(node->parent()->childNodes.begin(), iter);
+        index = node->parent()->childNodes().indexOf(node);
     }
-    else if(!tabData.branchMode && parentNode && parentNode->childNodes.front() != node){
+    else if(!tabData.branchMode && parentNode && parentNode->childNodes().front() != node){
         newBranch = true;
-        go::nodeList::iterator iter = qFind(node->parent()->childNodes.begin(), node->parent()->childNodes.end(), node);
-        index = std::distance(node->parent()->childNodes.begin(), iter) - 1;
+        index = node->parent()->childNodes().indexOf(node) - 1;
     }
 
     if (newBranch){
@@ -2830,8 +3129,8 @@ QTreeWidgetItem* MainWindow::addTreeWidget(BoardWidget* board, go::nodePtr node,
         }
     }
 
-    go::nodeList::iterator iter = node->childNodes.begin();
-    while (iter != node->childNodes.end()){
+    go::childList::iterator iter = node->childNodes().begin();
+    while (iter != node->childNodes().end()){
         addTreeWidget(board, *iter, false, rootItem);
         ++iter;
     }
@@ -2867,8 +3166,8 @@ QTreeWidgetItem* MainWindow::remakeTreeWidget(BoardWidget* board, QTreeWidgetIte
     go::nodePtr node = getNode(treeWidget);
     if (node == NULL)
         return NULL;
-    go::nodeList::iterator iter = node->childNodes.begin();
-    while (iter != node->childNodes.end()){
+    go::childList::iterator iter = node->childNodes().begin();
+    while (iter != node->childNodes().end()){
         addTreeWidget(board, *iter, false, treeWidget->treeWidget()->invisibleRootItem());
         ++iter;
     }
@@ -2882,34 +3181,29 @@ void MainWindow::deleteNode(bool deleteChildren){
     currentBoard()->deleteNodeCommand( currentBoard()->getCurrentNode(), deleteChildren );
 }
 
-void MainWindow::deleteTreeWidget(BoardWidget* board, go::nodePtr node, bool deleteChildren){
+void MainWindow::deleteTreeWidget(BoardWidget* board, go::nodePtr node, const go::nodeList& children){
     QTreeWidgetItem* treeWidget = tabDatas[board].nodeToTree[node];
-    go::nodeList::iterator iter = node->childNodes.begin();
-    while (iter != node->childNodes.end()){
-        QTreeWidgetItem* treeWidget2 = tabDatas[board].nodeToTree[*iter];
+    foreach(const go::nodePtr& child, children){
+        QTreeWidgetItem* treeWidget2 = tabDatas[board].nodeToTree[child];
         if (treeWidget2->parent() != treeWidget)
-            deleteTreeWidget(board, *iter, deleteChildren);
-        ++iter;
+            deleteTreeWidget(board, child, child->childNodes().toList());
     }
 
-    deleteTreeWidgetForMap(board, node);
+    deleteTreeWidgetForMap(board, node, children);
     delete treeWidget;
 }
 
-void MainWindow::deleteTreeWidgetForMap(BoardWidget* board, go::nodePtr node){
+void MainWindow::deleteTreeWidgetForMap(BoardWidget* board, go::nodePtr node, const go::nodeList& children){
     NodeToTreeWidgetType& nodeToTree = tabDatas[board].nodeToTree;
     NodeToTreeWidgetType::iterator iter = nodeToTree.find(node);
     if(iter == nodeToTree.end())
         return;
 
-    go::nodeList::iterator iter2 = node->childNodes.begin();
-    while (iter2 != node->childNodes.end()){
-        NodeToTreeWidgetType::iterator iter3 = nodeToTree.find(*iter2);
+    foreach(const go::nodePtr& child, children){
+        NodeToTreeWidgetType::iterator iter3 = nodeToTree.find(child);
         if(iter3 != nodeToTree.end())
             if ((*iter3)->parent() == *iter || (*iter3)->parent() == (*iter)->parent())
-                deleteTreeWidgetForMap(board, *iter2);
-
-        ++iter2;
+                deleteTreeWidgetForMap(board, child, child->childNodes().toList());
     }
 
     nodeToTree.erase(iter);
@@ -3467,7 +3761,7 @@ QString MainWindow::getDefaultSaveName() const{
     REPLACE("%WR%", i->whiteRank);
     REPLACE("%WT%", i->whiteTeam);
     REPLACE("%DT%", date);
-    REPLACE("%GN%", i->name);
+    REPLACE("%GN%", i->name());
     REPLACE("%RO%", i->round);
     REPLACE("%EV%", i->event);
     REPLACE("%PC%", i->place);
@@ -3504,12 +3798,13 @@ void MainWindow::on_gtp_estimated(BoardWidget* board, const QVector< QVector<dou
 
     // udpate board buffer
     BoardWidget::BoardBuffer& buf = board->getBuffer();
+    board->invalidateBoardBuffer();
     for (int y=0; y<territories.size(); ++y){
-        if (y >= buf.size())
+        if (y >= buf.ysize())
             break;
 
         for (int x=0; x<territories[y].size(); ++x){
-            if (x >= buf[y].size())
+            if (x >= buf.xsize())
                 break;
 
             if (territories[y][x] <= -0.7){
@@ -3529,8 +3824,8 @@ void MainWindow::on_gtp_estimated(BoardWidget* board, const QVector< QVector<dou
 
     // count score
     int alive_b=0, alive_w=0, dead_b=0, dead_w=0, blackTerritory=0, whiteTerritory=0;
-    for (int y=0; y<buf.size(); ++y){
-        for (int x=0; x<buf[y].size(); ++x){
+    for (int y=0; y<buf.ysize(); ++y){
+        for (int x=0; x<buf.xsize(); ++x){
             if (buf[y][x].blackTerritory()){
                 ++blackTerritory;
                 if (buf[y][x].white())
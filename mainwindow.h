@@ -22,6 +22,7 @@
 #include <QUndoGroup>
 #include <QUrl>
 #include <QActionGroup>
+#include <QFuture>
 #include "boardwidget.h"
 #include "countterritorydialog.h"
 #include "gtp.h"
@@ -33,6 +34,8 @@ class QProgressDialog;
 class QHttp;
 class QHttpResponseHeader;
 class QProcess;
+class QTimer;
+class saveTask;
 
 
 namespace Ui
@@ -85,9 +88,9 @@ public:
     bool fileOpen(const QString& fname, bool guessCodec=true, bool newTab=true, bool forceOpen=false);
     bool urlOpen(const QUrl& url);
     go::fileBase* readFile(const QString& fname, QTextCodec*& codec, bool guessCodec);
-    bool fileSave(BoardWidget* board);
-    bool fileSaveAs(BoardWidget* board);
-    bool fileSaveAs(BoardWidget* board, const QString& fname);
+    bool fileSave(BoardWidget* board, bool background=false);
+    bool fileSaveAs(BoardWidget* board, bool background=false);
+    bool fileSaveAs(BoardWidget* board, const QString& fname, bool background=false);
     bool closeTab(int index);
     bool closeAllTab();
     bool maybeSave(BoardWidget* board);
@@ -124,8 +127,8 @@ private:
     QTreeWidgetItem* createTreeWidget(BoardWidget* board, go::nodePtr node);
     QTreeWidgetItem* remakeTreeWidget(BoardWidget* board, QTreeWidgetItem* currentWidget);
     void deleteNode(bool deleteNode);
-    void deleteTreeWidget(BoardWidget* board, go::nodePtr node, bool deleteChildren);
-    void deleteTreeWidgetForMap(BoardWidget* board, go::nodePtr node);
+    void deleteTreeWidget(BoardWidget* board, go::nodePtr node, const go::nodeList& children);
+    void deleteTreeWidgetForMap(BoardWidget* board, go::nodePtr node, const go::nodeList& children);
     void setTreeWidget(BoardWidget* board, go::nodePtr n);
     QString createTreeText(BoardWidget* board, const go::nodePtr node);
 
@@ -140,6 +143,10 @@ private:
 
     void readSettings();
 
+    bool waitForTask(const QFuture<void>& future, go::fileProgress& progress, const QString& label, BoardWidget** preview = NULL);
+    bool finishSave(saveTask* task);
+    void recoverJournals();
+
     Ui::MainWindow *ui;
     TabDataMap tabDatas;
     QActionGroup tabMenuGroups;
@@ -159,6 +166,10 @@ private:
 
     QProgressDialog* progressDialog;
     QHttp* http;
+
+    QList<saveTask*> saveTasks;  // files saved in worker threads
+    QTimer* saveTimer;
+    QTimer* journalTimer;
     QByteArray downloadBuff;
 
     QTextCodec* defaultCodec;
@@ -184,6 +195,9 @@ private slots:
     void on_actionPrint_triggered();
     void on_actionExit_triggered();
     void openRecentFile();
+    void saveFinished();
+    void updateSaveProgress();
+    void syncJournals();
 
     // Edit menu
     void on_actionCopySgfToClipboard_triggered();
@@ -315,7 +329,7 @@ private slots:
     // Board widget
     void boardCleared();
     void nodeAdded(go::nodePtr parent, go::nodePtr node, bool select);
-    void nodeDeleted(go::nodePtr node, bool deleteChildren);
+    void nodeDeleted(go::nodePtr node, const go::nodeList& children);
     void nodeModified(go::nodePtr node);
     void currentNodeChanged(go::nodePtr node);
     void updateTerritory(int alive_b, int alive_w, int dead_b, int dead_w, int capturedBlack, int capturedWhite, int blackTerritory, int whiteTerritory, double komi);
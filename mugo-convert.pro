@@ -0,0 +1,22 @@
+# -------------------------------------------------
+# mugo-convert, console converter of ugf, gib and ngf to sgf.
+# -------------------------------------------------
+TARGET = mugo-convert
+TEMPLATE = app
+QT -= gui
+CONFIG += console
+mac:CONFIG -= app_bundle
+SOURCES += convert.cpp \
+    godata.cpp \
+    sgf.cpp \
+    ugf.cpp \
+    gib.cpp \
+    ngf.cpp \
+    readers.cpp
+HEADERS += appdef.h \
+    godata.h \
+    sgf.h \
+    ugf.h \
+    gib.h \
+    ngf.h \
+    readers.h
@@ -25,6 +25,11 @@ SOURCES += main.cpp \
     printoptiondialog.cpp \
     gib.cpp \
     ngf.cpp \
+    snapshot.cpp \
+    readers.cpp \
+    journal.cpp \
+    position.cpp \
+    bitboard.cpp \
     boardsizedialog.cpp \
     saveimagedialog.cpp \
     qtsingleapplication.cpp \
@@ -51,6 +56,11 @@ HEADERS += mainwindow.h \
     printoptiondialog.h \
     gib.h \
     ngf.h \
+    snapshot.h \
+    readers.h \
+    journal.h \
+    position.h \
+    bitboard.h \
     boardsizedialog.h \
     saveimagedialog.h \
     qtsingleapplication.h \
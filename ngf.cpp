@@ -24,23 +24,23 @@ namespace go{
 
 
 
-bool ngf::readStream(QString::iterator& first, QString::iterator last){
+bool ngf::readText(textReader& reader){
 //    dataList_.push_back( data() );
-    gameName = readLine(first, last);
-    size = readLine(first, last).toInt();
-    whitePlayer = readLine(first, last);
-    blackPlayer = readLine(first, last);
-    readLine(first, last); // url?
-    handicap = readLine(first, last).toInt(); //
-    readLine(first, last); // 0?
-    readLine(first, last); // 6?
-    gameDate = readLine(first, last);
-    gameTime = readLine(first, last);
-    result   = readLine(first, last);
-    readLine(first, last); // last move number
-
-    while (first != last){
-        QString s = readLine(first, last);
+    gameName = reader.readLine();
+    size = reader.readLine().toInt();
+    whitePlayer = reader.readLine();
+    blackPlayer = reader.readLine();
+    reader.readLine(); // url?
+    handicap = reader.readLine().toInt(); //
+    reader.readLine(); // 0?
+    reader.readLine(); // 6?
+    gameDate = reader.readLine();
+    gameTime = reader.readLine();
+    result   = reader.readLine();
+    reader.readLine(); // last move number
+
+    while (!reader.atEnd()){
+        QString s = reader.readLine();
         if (s.size() < 7)
             continue;
 
@@ -65,6 +65,29 @@ bool ngf::saveStream(QTextStream& /*stream*/){
     return false;
 }
 
+/**
+* returns confidence (0-100) that head of file is ngf.
+* ngf has no signature, so line layout of header is checked.
+* board size is at line 2, handicap at line 6, and moves like "PMAB..." follow line 12.
+*/
+int ngf::probe(const QByteArray& head){
+    QList<QByteArray> lines = head.left(1024).split('\n');
+    if (lines.size() < 12)
+        return 0;
+
+    bool ok1, ok2, ok3;
+    int size = lines[1].trimmed().toInt(&ok1);
+    int hcap = lines[5].trimmed().toInt(&ok2);
+    lines[11].trimmed().toInt(&ok3);
+    if (!ok1 || !ok2 || !ok3 || size < 2 || size > 52 || hcap < 0 || hcap > 9)
+        return 0;
+
+    if (lines.size() > 12 && lines[12].startsWith("PM"))
+        return 90;
+    else
+        return 50;
+}
+
 QTextCodec* ngf::getCodec(const QByteArray&) const{
     return QTextCodec::codecForName("Shift_JIS");
 }
@@ -96,11 +119,11 @@ bool ngf::get(go::data& data) const{
     int hcap = (size % 2 == 0 && handicap > 4) ? 4 : handicap;
     for (int i=0; i<hcap; ++i){
         if (hcap < 6)
-            data.root->blackStones.push_back( stone(hcapx1[i], hcapy1[i], go::black) );
+            data.root->editBlackStones().push_back( stone(hcapx1[i], hcapy1[i], go::black) );
         else if (hcap < 8)
-            data.root->blackStones.push_back( stone(hcapx2[i], hcapy2[i], go::black) );
+            data.root->editBlackStones().push_back( stone(hcapx2[i], hcapy2[i], go::black) );
         else
-            data.root->blackStones.push_back( stone(hcapx3[i], hcapy3[i], go::black) );
+            data.root->editBlackStones().push_back( stone(hcapx3[i], hcapy3[i], go::black) );
     }
     get(dataList_.begin(), dataList_.end(), go::nodePtr(data.root));
     return true;
@@ -110,21 +133,24 @@ bool ngf::set(const go::data& /*data*/){
     return false;
 }
 
+/**
+* append moves to parent as one line.
+*/
 bool ngf::get(dataList::const_iterator first, dataList::const_iterator last, go::nodePtr parent) const{
-    if (first == last)
-        return true;
-
-    nodePtr node;
-    if (first->color == go::black)
-        node = go::createBlackNode(parent, first->x, first->y);
-    else if (first->color == go::white)
-        node = go::createWhiteNode(parent, first->x, first->y);
-    else
-        node.reset(new go::node(parent));
-
-    parent->childNodes.push_back(node);
+    parent->arena()->reserve( parent->arena()->size() + (last - first) );
+
+    for (; first != last; ++first){
+        nodePtr node;
+        if (first->color == go::black)
+            node = go::createBlackNode(parent, first->x, first->y);
+        else if (first->color == go::white)
+            node = go::createWhiteNode(parent, first->x, first->y);
+        else
+            node = go::createNode(parent);
 
-    get(++first, last, node);
+        parent->childNodes().push_back(node);
+        parent = node;
+    }
 
     return true;
 }
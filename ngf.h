@@ -43,9 +43,10 @@ public:
 
     ngf() : handicap(0){}
 
-    virtual bool readStream(QString::iterator& first, QString::iterator last);
+    virtual bool readText(textReader& reader);
     virtual bool saveStream(QTextStream& stream);
     virtual QTextCodec* getCodec(const QByteArray&) const;
+    static int probe(const QByteArray& head);
 
     virtual bool get(go::data& data) const;
     virtual bool set(const go::data& data);
@@ -0,0 +1,329 @@
+/*
+    mugo, sgf editor.
+    Copyright (C) 2009-2010 nsase.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "position.h"
+
+namespace go{
+
+
+void position::clear(int xsize, int ysize){
+    xsize_ = xsize;
+    ysize_ = ysize;
+    colors.fill(empty, xsize * ysize);
+    rebuild = false;
+
+    planes = bitboard::fits(xsize, ysize);
+    if (planes){
+        stones[0].clear();
+        stones[1].clear();
+        empties.setBoard(xsize, ysize);
+        return;
+    }
+
+    parents.resize(xsize * ysize);
+    nextStone.resize(xsize * ysize);
+    groups.resize(xsize * ysize);
+}
+
+/**
+* put or remove setup stone. stones are not captured.
+*/
+void position::setStone(int x, int y, color c){
+    int p = y * xsize_ + x;
+    if (colors[p] == c)
+        return;
+
+    if (planes){
+        if (colors[p] == empty)
+            empties.reset(x, y);
+        else
+            stones[colors[p] - 1].reset(x, y);
+
+        if (c == empty)
+            empties.set(x, y);
+        else
+            stones[c - 1].set(x, y);
+        colors[p] = c;
+        return;
+    }
+
+    // group can't be split, so groups are created again when they are used.
+    if (colors[p] != empty || c == empty){
+        colors[p] = c;
+        rebuild = true;
+        return;
+    }
+
+    colors[p] = c;
+    if (rebuild)
+        return;
+
+    parents[p] = p;
+    nextStone[p] = p;
+    group& g = groups[p];
+    g.size = 1;
+    g.liberties = 0;
+    g.sum = g.sumOfSquares = 0;
+
+    int n[4];
+    int count = neighbors(p, n);
+    for (int i=0; i<count; ++i){
+        if (colors[n[i]] == empty)
+            addLiberty(p, n[i]);
+        else
+            removeLiberty(n[i], p);
+    }
+    for (int i=0; i<count; ++i)
+        if (colors[n[i]] == c)
+            join(p, n[i]);
+}
+
+/**
+* play move, and remove captured groups of opponent.
+* own group is removed if it has no liberty after captures.
+* removed stones are appended to captured.
+*/
+void position::play(int x, int y, color c, QVector<point>* captured){
+    int p = y * xsize_ + x;
+    if (colors[p] != empty)
+        setStone(x, y, empty);
+    setStone(x, y, c);
+
+    color opponent = c == black ? white : black;
+    int n[4];
+    int count = neighbors(p, n);
+    if (planes){
+        bitboard checked;
+        for (int i=0; i<count; ++i){
+            int nx = n[i] % xsize_, ny = n[i] / xsize_;
+            if (colors[n[i]] != opponent || checked.test(nx, ny))
+                continue;
+
+            bitboard opponentChain = chain(nx, ny);
+            checked |= opponentChain;
+            if (!liberties(opponentChain).any())
+                removeChain(opponentChain, captured);
+        }
+
+        bitboard ownChain = chain(x, y);
+        if (!liberties(ownChain).any())
+            removeChain(ownChain, captured);
+        return;
+    }
+
+    if (rebuild)
+        createGroups();
+
+    for (int i=0; i<count; ++i)
+        if (colors[n[i]] == opponent && groups[find(n[i])].liberties == 0)
+            remove(n[i], captured);
+
+    if (groups[find(p)].liberties == 0)
+        remove(p, captured);
+}
+
+/**
+* returns true if move at empty point has no liberty and captures nothing.
+*/
+bool position::isSuicide(int x, int y, color c){
+    int p = y * xsize_ + x;
+    int n[4];
+    int count = neighbors(p, n);
+    if (planes){
+        // own chain through x, y needs liberty other than x, y, or opponent chain must lose its last liberty.
+        bitboard move;
+        move.set(x, y);
+        bitboard ownChain = move.fill(stones[c - 1] | move);
+        if ((liberties(ownChain).andNot(move)).any())
+            return false;
+
+        for (int i=0; i<count; ++i)
+            if (colors[n[i]] != empty && colors[n[i]] != c && liberties( chain(n[i] % xsize_, n[i] / xsize_) ) == move)
+                return false;
+        return true;
+    }
+
+    if (rebuild)
+        createGroups();
+
+    for (int i=0; i<count; ++i){
+        if (colors[n[i]] == empty)
+            return false;
+
+        // liberty of group in atari is p.
+        bool atari = isAtari(n[i] % xsize_, n[i] / xsize_);
+        if (colors[n[i]] == c ? !atari : atari)
+            return false;
+    }
+
+    return true;
+}
+
+/**
+* returns true if group at x, y has only one liberty.
+*/
+bool position::isAtari(int x, int y){
+    if (planes)
+        return liberties( chain(x, y) ).count() == 1;
+
+    if (rebuild)
+        createGroups();
+
+    const group& g = groups[ find(y * xsize_ + x) ];
+    return g.liberties > 0 && g.liberties * g.sumOfSquares == g.sum * g.sum;
+}
+
+/**
+* stones of chain at x, y on bit plane.
+*/
+bitboard position::chain(int x, int y) const{
+    bitboard seed;
+    seed.set(x, y);
+    return seed.fill( stones[ colors[y * xsize_ + x] - 1 ] );
+}
+
+/**
+* empty points adjacent to chain.
+*/
+bitboard position::liberties(const bitboard& chain) const{
+    return chain.neighbors(empties);
+}
+
+/**
+* remove stones of chain, and append them to captured.
+*/
+void position::removeChain(bitboard chain, QVector<point>* captured){
+    int x, y;
+    while (chain.first(x, y)){
+        chain.reset(x, y);
+        setStone(x, y, empty);
+        if (captured)
+            captured->push_back( point(x, y) );
+    }
+}
+
+int position::find(int p){
+    while (parents[p] != p){
+        parents[p] = parents[ parents[p] ];
+        p = parents[p];
+    }
+    return p;
+}
+
+void position::addLiberty(int p, int liberty){
+    group& g = groups[find(p)];
+    ++g.liberties;
+    g.sum += liberty;
+    g.sumOfSquares += qint64(liberty) * liberty;
+}
+
+void position::removeLiberty(int p, int liberty){
+    group& g = groups[find(p)];
+    --g.liberties;
+    g.sum -= liberty;
+    g.sumOfSquares -= qint64(liberty) * liberty;
+}
+
+/**
+* join groups of a and b. smaller group is attached to larger one.
+*/
+void position::join(int a, int b){
+    a = find(a);
+    b = find(b);
+    if (a == b)
+        return;
+    if (groups[a].size < groups[b].size)
+        qSwap(a, b);
+
+    parents[b] = a;
+    groups[a].size         += groups[b].size;
+    groups[a].liberties    += groups[b].liberties;
+    groups[a].sum          += groups[b].sum;
+    groups[a].sumOfSquares += groups[b].sumOfSquares;
+    qSwap(nextStone[a], nextStone[b]);
+}
+
+/**
+* remove group of p, and give liberties to adjacent groups.
+*/
+void position::remove(int p, QVector<point>* captured){
+    int first = p;
+    do{
+        colors[p] = empty;
+        if (captured)
+            captured->push_back( point(p % xsize_, p / xsize_) );
+        p = nextStone[p];
+    } while (p != first);
+
+    do{
+        int n[4];
+        int count = neighbors(p, n);
+        for (int i=0; i<count; ++i)
+            if (colors[n[i]] != empty)
+                addLiberty(n[i], p);
+        p = nextStone[p];
+    } while (p != first);
+}
+
+/**
+* create all groups from colors.
+*/
+void position::createGroups(){
+    rebuild = false;
+
+    int size = xsize_ * ysize_;
+    for (int p=0; p<size; ++p){
+        parents[p] = p;
+        nextStone[p] = p;
+        group& g = groups[p];
+        g.size = 1;
+        g.liberties = 0;
+        g.sum = g.sumOfSquares = 0;
+    }
+
+    for (int p=0; p<size; ++p){
+        if (colors[p] == empty)
+            continue;
+
+        int n[4];
+        int count = neighbors(p, n);
+        for (int i=0; i<count; ++i){
+            if (colors[n[i]] == empty)
+                addLiberty(p, n[i]);
+            else if (colors[n[i]] == colors[p])
+                join(p, n[i]);
+        }
+    }
+}
+
+int position::neighbors(int p, int* n) const{
+    int x = p % xsize_;
+    int y = p / xsize_;
+    int count = 0;
+    if (y > 0)
+        n[count++] = p - xsize_;
+    if (y < ysize_ - 1)
+        n[count++] = p + xsize_;
+    if (x > 0)
+        n[count++] = p - 1;
+    if (x < xsize_ - 1)
+        n[count++] = p + 1;
+    return count;
+}
+
+
+}
@@ -0,0 +1,88 @@
+/*
+    mugo, sgf editor.
+    Copyright (C) 2009-2010 nsase.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __position_h__
+#define __position_h__
+
+#include <QVector>
+#include "godata.h"
+#include "bitboard.h"
+
+namespace go{
+
+
+/**
+* stones on board, and their groups.
+* boards up to 52x52 keep stones of each color on bit planes, and chains,
+* liberties and captures are found by fill and neighbors of planes.
+* larger boards keep groups by union-find, and each group counts its pseudo
+* liberties (empty points adjacent to each stone) with their sum and sum of
+* squares. group is captured when count is 0, and it is in atari when all
+* its liberties are same point, so move and capture check don't search board.
+*/
+class position{
+public:
+    position() : xsize_(0), ysize_(0), planes(false), rebuild(false){}
+
+    void clear(int xsize, int ysize);
+
+    int xsize() const{ return xsize_; }
+    int ysize() const{ return ysize_; }
+    bool contains(int x, int y) const{ return x >= 0 && x < xsize_ && y >= 0 && y < ysize_; }
+    color at(int x, int y) const{ return color(colors[y * xsize_ + x]); }
+
+    void setStone(int x, int y, color c);
+    void play(int x, int y, color c, QVector<point>* captured = NULL);
+    bool isSuicide(int x, int y, color c);
+    bool isAtari(int x, int y);
+
+private:
+    struct group{
+        int size;
+        int liberties;
+        qint64 sum;
+        qint64 sumOfSquares;
+    };
+
+    bitboard chain(int x, int y) const;
+    bitboard liberties(const bitboard& chain) const;
+    void removeChain(bitboard chain, QVector<point>* captured);
+
+    int find(int p);
+    void addLiberty(int p, int liberty);
+    void removeLiberty(int p, int liberty);
+    void join(int a, int b);
+    void remove(int p, QVector<point>* captured);
+    void createGroups();
+    int neighbors(int p, int* n) const;
+
+    int xsize_;
+    int ysize_;
+    QVector<quint8> colors;
+    bool planes;             // stones are kept by bit planes, and groups are not used
+    bitboard stones[2];      // black and white stones
+    bitboard empties;        // empty points of board
+    QVector<int> parents;    // union-find of stones, root has group data
+    QVector<int> nextStone;  // circular list of stones in group
+    QVector<group> groups;
+    bool rebuild;            // groups are created again after stone is removed by setup
+};
+
+
+}
+
+#endif
@@ -0,0 +1,127 @@
+/*
+    mugo, sgf editor.
+    Copyright (C) 2009-2010 nsase.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <QFileInfo>
+#include "readers.h"
+#include "sgf.h"
+#include "ugf.h"
+#include "gib.h"
+#include "ngf.h"
+
+namespace go{
+
+
+template<class T>
+static fileBase* createInstance(){
+    return new T;
+}
+
+/**
+* registered reader.
+*/
+struct readerEntry{
+    const char* extensions;  // separated by space
+    int (*probe)(const QByteArray& head);
+    fileBase* (*create)();
+};
+
+static const readerEntry readers[] = {
+    { "sgf",     &sgf::probe, &createInstance<sgf> },
+    { "gib",     &gib::probe, &createInstance<gib> },
+    { "ugf ugi", &ugf::probe, &createInstance<ugf> },
+    { "ngf",     &ngf::probe, &createInstance<ngf> },
+};
+static const int readerCount = sizeof(readers) / sizeof(readers[0]);
+
+static const int headSize = 4096;
+
+/**
+* create reader which matches head of file best.
+* extension of fname only breaks tie, or chooses reader when no probe matches.
+*/
+fileBase* createReader(const QByteArray& head, const QString& fname){
+    QString ext = QFileInfo(fname).suffix().toLower();
+
+    int best = -1;
+    int bestScore = 0;
+    for (int i=0; i<readerCount; ++i){
+        int score = readers[i].probe(head) * 2;
+        if (!ext.isEmpty() && QString(readers[i].extensions).split(' ').contains(ext))
+            ++score;
+
+        if (score > bestScore){
+            best = i;
+            bestScore = score;
+        }
+    }
+
+    return best < 0 ? NULL : readers[best].create();
+}
+
+/**
+* read buffer by reader of its format.
+* returns NULL if format is unknown or buffer can't be read.
+*/
+static fileBase* readSource(const fileBufferPtr& buffer, const QString& fname, QTextCodec*& codec, bool guessCodec, fileProgress* progress){
+    const QByteArray& bytes = buffer->bytes;
+    QByteArray head = QByteArray::fromRawData(bytes.constData(), qMin(bytes.size(), headSize));
+    fileBase* reader = createReader(head, fname);
+    if (reader == NULL)
+        return NULL;
+
+    reader->progress = progress;
+    if (!reader->readSource(buffer, codec, guessCodec)){
+        delete reader;
+        return NULL;
+    }
+
+    codec = reader->codec;
+    return reader;
+}
+
+/**
+* read bytes by reader of its format.
+* bytes are shared by games which are read lazily, not copied.
+*/
+fileBase* readBytes(const QByteArray& bytes, const QString& fname, QTextCodec*& codec, bool guessCodec, fileProgress* progress){
+    return readSource(fileBufferPtr(new fileBuffer(bytes)), fname, codec, guessCodec, progress);
+}
+
+/**
+* read file once, format is detected from the same buffer.
+*/
+fileBase* readFile(const QString& fname, QTextCodec*& codec, bool guessCodec, fileProgress* progress){
+    fileBufferPtr buffer(new fileBuffer(fname));
+    if (!buffer->isOpen())
+        return NULL;
+
+    return readSource(buffer, fname, codec, guessCodec, progress);
+}
+
+bool isReadable(const QString& fname){
+    QFile f(fname);
+    if (!f.open(QIODevice::ReadOnly))
+        return false;
+
+    fileBase* reader = createReader(f.read(headSize), fname);
+    bool ret = reader != NULL;
+    delete reader;
+    return ret;
+}
+
+
+}
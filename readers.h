@@ -0,0 +1,38 @@
+/*
+    mugo, sgf editor.
+    Copyright (C) 2009-2010 nsase.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __readers_h__
+#define __readers_h__
+
+#include "godata.h"
+
+namespace go{
+
+
+/**
+* readers of supported formats.
+* format is chosen by contents of file, and by extension if contents are not recognized.
+*/
+fileBase* createReader(const QByteArray& head, const QString& fname = QString());
+fileBase* readFile(const QString& fname, QTextCodec*& codec, bool guessCodec, fileProgress* progress = NULL);
+fileBase* readBytes(const QByteArray& bytes, const QString& fname, QTextCodec*& codec, bool guessCodec, fileProgress* progress = NULL);
+bool isReadable(const QString& fname);
+
+
+}
+
+#endif
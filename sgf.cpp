@@ -15,76 +15,335 @@
     You should have received a copy of the GNU General Public License
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
+#include <ctype.h>
+#include <string.h>
 #include <QDebug>
+#include <QtConcurrentMap>
 #include "appdef.h"
 #include "sgf.h"
 
+#if !defined(SGF_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#  define SGF_USE_SSE2
+#  include <emmintrin.h>
+#  ifdef _MSC_VER
+#    include <intrin.h>
+#  endif
+#endif
+
+// avx2 code is compiled by target attribute or intrinsics of compiler, and used if cpu supports it.
+#if defined(SGF_USE_SSE2) && !defined(SGF_NO_AVX2) && \
+    ((defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))) || (defined(_MSC_VER) && _MSC_VER >= 1800))
+#  define SGF_USE_AVX2
+#  include <immintrin.h>
+#  ifdef _MSC_VER
+#    define SGF_TARGET_AVX2
+#  else
+#    define SGF_TARGET_AVX2 __attribute__((target("avx2")))
+#  endif
+#endif
+
 namespace go{
 
 
+#ifdef SGF_USE_SSE2
+static inline int lowestBit(unsigned int mask){
+#ifdef _MSC_VER
+    unsigned long i;
+    _BitScanForward(&i, mask);
+    return i;
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+#endif
 
-QString sgf::node::toString() const{
-    static const QString keys[] = {
-        // game information
-        "GM", "FF", "CA", "AP", "SZ", "KM", "HA", "RU",
-        "PW", "WR", "WT", "PB", "BR", "BT", "RE", "TM", "OT",
-        "DT", "GN", "RO", "PC", "EV",
-        "GC", "ON", "AN", "CP", "SO", "US",
+#ifdef SGF_USE_AVX2
+/**
+* returns true if cpu and os support avx2.
+*/
+static bool cpuHasAvx2(){
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return false;
+    __cpuid(info, 1);
+    if ((info[2] & (1 << 27)) == 0 || (_xgetbv(0) & 6) != 6)  // osxsave and ymm state
+        return false;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") != 0;
+#endif
+}
 
-        // stone
-        "B", "BL", "OB", "W", "WL","OW", "MN", "PL",
+static const bool hasAvx2 = cpuHasAvx2();
+#endif
 
-        // marker
-        "AE", "AB", "AW", "MA", "CR", "SQ", "TR", "SL", "LB", "TB", "TW", "DD",
+/**
+* scanners of sgf text.
+* find returns first C1, C2 or C3 in [first, last), or last if not found.
+* non ascii bytes are found too if High is true.
+* all versions return same result, vector versions are used for long text.
+*/
+template <char C1, char C2, char C3, bool High = false>
+struct scanner{
+    static inline bool match(char c){
+        return c == C1 || c == C2 || c == C3 || (High && (c & 0x80));
+    }
 
-        // move annotation
-        "TE", "BM", "DO", "IT",
+    static const char* scalar(const char* first, const char* last){
+        while (first != last && !match(*first))
+            ++first;
+        return first;
+    }
 
-        // node annotation
-        "C", "DM", "GB", "GW", "UC", "HO", "N",
+#ifdef SGF_USE_SSE2
+    static const char* sse2(const char* first, const char* last){
+        const __m128i c1 = _mm_set1_epi8(C1);
+        const __m128i c2 = _mm_set1_epi8(C2);
+        const __m128i c3 = _mm_set1_epi8(C3);
+        while (last - first >= 16){
+            __m128i v = _mm_loadu_si128( reinterpret_cast<const __m128i*>(first) );
+            __m128i m = _mm_or_si128( _mm_or_si128(_mm_cmpeq_epi8(v, c1), _mm_cmpeq_epi8(v, c2)), _mm_cmpeq_epi8(v, c3) );
+            int mask = _mm_movemask_epi8(m) | (High ? _mm_movemask_epi8(v) : 0);
+            if (mask)
+                return first + lowestBit(mask);
+            first += 16;
+        }
+        return scalar(first, last);
+    }
+#endif
+
+#ifdef SGF_USE_AVX2
+    SGF_TARGET_AVX2 static const char* avx2(const char* first, const char* last){
+        const __m256i c1 = _mm256_set1_epi8(C1);
+        const __m256i c2 = _mm256_set1_epi8(C2);
+        const __m256i c3 = _mm256_set1_epi8(C3);
+        while (last - first >= 32){
+            __m256i v = _mm256_loadu_si256( reinterpret_cast<const __m256i*>(first) );
+            __m256i m = _mm256_or_si256( _mm256_or_si256(_mm256_cmpeq_epi8(v, c1), _mm256_cmpeq_epi8(v, c2)), _mm256_cmpeq_epi8(v, c3) );
+            unsigned int mask = static_cast<unsigned int>( _mm256_movemask_epi8(m) | (High ? _mm256_movemask_epi8(v) : 0) );
+            if (mask)
+                return first + lowestBit(mask);
+            first += 32;
+        }
+        return sse2(first, last);
+    }
+#endif
+
+    static inline const char* find(const char* first, const char* last){
+#if defined(SGF_USE_AVX2)
+        return hasAvx2 ? avx2(first, last) : sse2(first, last);
+#elif defined(SGF_USE_SSE2)
+        return sse2(first, last);
+#else
+        return scalar(first, last);
+#endif
+    }
+};
 
-        // unsupported property
-        // "ST", "KO", "V", "AR", "LN", "FG", "PM", "VW"
-    };
-    static const int N = sizeof(keys) / sizeof(keys[0]);
+/**
+* lead bytes of codec. lead bytes and trail bytes are skipped together in values.
+*/
+static sgf::eLeadBytes leadBytes(QTextCodec* codec){
+    switch (codec ? codec->mibEnum() : 0){
+        case 17:    // Shift_JIS
+        case 2024:  // windows-31J
+            return sgf::eShiftJisLeadBytes;
+        case 113:   // GBK
+        case 114:   // GB18030
+        case 2025:  // GB2312
+        case 2026:  // Big5
+        case 2101:  // Big5-HKSCS
+            return sgf::eDoubleByteLeadBytes;
+        default:
+            return sgf::eNoLeadBytes;
+    }
+}
 
+static inline bool isLeadByte(sgf::eLeadBytes leads, unsigned char c){
+    if (leads == sgf::eShiftJisLeadBytes)
+        return (c >= 0x81 && c <= 0x9f) || (c >= 0xe0 && c <= 0xfc);
+    else
+        return leads == sgf::eDoubleByteLeadBytes && c >= 0x81 && c <= 0xfe;
+}
+
+/**
+* returns position after character at first, which may be double byte character.
+*/
+static inline const char* nextCharacter(const char* first, const char* last, sgf::eLeadBytes leads){
+    if (first == last)
+        return last;
+    return isLeadByte(leads, *first) && last - first > 1 ? first + 2 : first + 1;
+}
+
+/**
+* returns first ']' or '\\' in [first, last), or last if not found.
+* trail bytes of double byte characters are not delimiters.
+*/
+static inline const char* findValueDelimiter(const char* first, const char* last, sgf::eLeadBytes leads){
+    if (leads == sgf::eNoLeadBytes)
+        return scanner<']', '\\', '\\'>::find(first, last);
+
+    while ((first = scanner<']', '\\', '\\', true>::find(first, last)) != last){
+        if ((*first & 0x80) == 0)
+            return first;
+        first = nextCharacter(first, last, leads);
+    }
+    return last;
+}
+
+/**
+* returns first '[', '(' or ')' in [first, last), or last if not found.
+* it finds boundaries of branches and games without looking at properties.
+*/
+static inline const char* findBranchDelimiter(const char* first, const char* last){
+    return scanner<'[', '(', ')'>::find(first, last);
+}
+
+
+
+/**
+* property identifiers in same order as sgf::eProperty.
+*/
+static const char* const propertyNames[] = {
+    "GM", "FF", "CA", "AP", "SZ", "KM", "HA", "RU",
+    "PW", "WR", "WT", "PB", "BR", "BT", "RE", "TM", "OT",
+    "DT", "GN", "RO", "PC", "EV",
+    "GC", "ON", "AN", "CP", "SO", "US",
+    "B", "W", "MN", "PL",
+    "AE", "AB", "AW", "MA", "CR", "SQ", "TR", "SL", "LB", "TB", "TW", "DD",
+    "TE", "BM", "DO", "IT",
+    "C", "DM", "GB", "GW", "UC", "HO", "N",
+    "KO", "RD", "TC", "RN", "M", "PT"
+};
+
+/**
+* perfect hash table of property identifiers.
+* identifier is one or two upper case letters, so it is mapped to (c1 - 'A') * 27 + (c2 - 'A' + 1).
+*/
+class propertyTable{
+public:
+    enum{ size = 26 * 27 };
+
+    propertyTable(){
+        Q_ASSERT( sizeof(propertyNames) / sizeof(propertyNames[0]) == sgf::eUnknownProperty );
+
+        for (int i=0; i<size; ++i)
+            ids[i] = sgf::eUnknownProperty;
+        for (int i=0; i<sgf::eUnknownProperty; ++i)
+            ids[ hash(propertyNames[i], qstrlen(propertyNames[i])) ] = i;
+    }
+
+    static int hash(const char* key, int size){
+        if (size < 1 || size > 2 || key[0] < 'A' || key[0] > 'Z')
+            return -1;
+        else if (size == 1)
+            return (key[0] - 'A') * 27;
+        else if (key[1] < 'A' || key[1] > 'Z')
+            return -1;
+        else
+            return (key[0] - 'A') * 27 + (key[1] - 'A' + 1);
+    }
+
+    quint8 ids[size];
+};
+
+static const propertyTable propertyIds;
+
+/**
+* returns identifier of property, or eUnknownProperty.
+*/
+sgf::eProperty sgf::propertyId(const char* key, int size){
+    int h = propertyTable::hash(key, size);
+    return h < 0 ? eUnknownProperty : static_cast<eProperty>(propertyIds.ids[h]);
+}
+
+/**
+* append escaped value to str2.
+* str2 is moved to str as one line when it becomes longer than SGF_LINEWIDTH.
+*/
+static void writeValue(QString& str, QString& str2, const QString& value){
+    str2.push_back('[');
+    if (value.contains('\\') || value.contains(']')){
+        QString tmp(value);
+        tmp.replace('\\', "\\\\");
+        tmp.replace(']', "\\]");
+        str2.push_back(tmp);
+    }
+    else
+        str2.push_back(value);
+    str2.push_back(']');
+
+    if (str2.length() > SGF_LINEWIDTH){
+        str.append(str2);
+        str.push_back('\n');
+        str2.clear();
+    }
+}
+
+static void writeProperty(QString& str, QString& str2, const QString& key, const QStringList& values){
+    str2.push_back(key);
+    foreach(const QString& v, values)
+        writeValue(str, str2, v);
+}
+
+static void writeProperty(QString& str, QString& str2, const char* key, const QString& value){
+    str2.append( QLatin1String(key) );
+    writeValue(str, str2, value);
+}
+
+static void writeProperty(QString& str, QString& str2, const char* key, const QStringList& values){
+    str2.append( QLatin1String(key) );
+    foreach(const QString& v, values)
+        writeValue(str, str2, v);
+}
+
+QString sgf::node::toString() const{
     QString str;
     str.reserve(100);
+    toString(str);
+    return str;
+}
+
+/**
+* append node to str.
+*/
+void sgf::node::toString(QString& str) const{
+    // properties are written in order of eProperty, and unknown properties are written last.
+    propertyType::const_iterator known[eUnknownProperty];
+    bool hasKnown[eUnknownProperty] = {false};
+    QList<propertyType::const_iterator> unknown;
+
+    propertyType::const_iterator iter = property.begin();
+    while (iter != property.end()){
+        const QString& k = iter.key();
+        char key[2] = { k.size() > 0 ? k[0].toLatin1() : '\0', k.size() > 1 ? k[1].toLatin1() : '\0' };
+        eProperty id = propertyId(key, k.size());
+        if (id == eUnknownProperty)
+            unknown.push_back(iter);
+        else if (id < eKO){  // read only properties are not written.
+            known[id] = iter;
+            hasKnown[id] = true;
+        }
+        ++iter;
+    }
+
     str.push_back(';');
 
     QString str2;
     str2.reserve(100);
 
-    for (int i=0; i<N; ++i){
-        propertyType::const_iterator iter = property.find(keys[i]);
-        if (iter == property.end())
-            continue;
+    for (int i=0; i<eKO; ++i)
+        if (hasKnown[i])
+            writeProperty(str, str2, known[i].key(), known[i].value());
 
-        const propertyType::key_type& key = iter.key();
-        const propertyType::mapped_type& values = iter.value();
-        str2.push_back(key);
-
-        propertyType::mapped_type::const_iterator iter2 = values.begin();
-        while (iter2 != values.end()){
-            str2.push_back('[');
-            QString tmp(*iter2);
-            tmp.replace('\\', "\\\\");
-            tmp.replace(']', "\\]");
-            str2.push_back(tmp);
-            str2.push_back(']');
-
-            if (str2.length() > SGF_LINEWIDTH){
-                str.append(str2);
-                str.push_back('\n');
-                str2.clear();
-            }
-            ++iter2;
-        }
-    }
+    foreach(const propertyType::const_iterator& iter, unknown)
+        writeProperty(str, str2, iter.key(), iter.value());
 
     str.append(str2);
-
-    return str;
 }
 
 bool sgf::node::setProperty(const QString& key, const QStringList& values){
@@ -93,150 +352,175 @@ bool sgf::node::setProperty(const QString& key, const QStringList& values){
 }
 
 bool sgf::node::get(go::nodePtr n) const{
+    // values are stored as unicode, so pass them as utf-8.
+    QTextCodec* codec = QTextCodec::codecForName("UTF-8");
+
     propertyType::const_iterator iter = property.begin();
     while (iter != property.end()){
-        get(n, iter.key(), iter.value());
+        QByteArray key = iter.key().toUtf8();
+        valueList values;
+        foreach(const QString& v, iter.value())
+            values.push_back( v.toUtf8() );
+        get(n, propertyId(key.constData(), key.size()), key, values, codec);
         ++iter;
     }
 
     return true;
 }
 
-bool sgf::node::get(go::nodePtr n, const QString& key, const QStringList& values) const{
-    go::informationNode* infoNode = dynamic_cast<go::informationNode*>(n.get());
-
-    // game information
-    if (infoNode && key == "PW")
-        infoNode->whitePlayer = values[0];
-    else if (infoNode && key == "WR")
-        infoNode->whiteRank = values[0];
-    else if (infoNode && key == "WT")
-        infoNode->whiteTeam = values[0];
-    if (infoNode && key == "PB")
-        infoNode->blackPlayer = values[0];
-    else if (infoNode && key == "BR")
-        infoNode->blackRank = values[0];
-    else if (infoNode && key == "BT")
-        infoNode->blackTeam = values[0];
-    else if (infoNode && key == "RE")
-        infoNode->result = values[0];
-    else if (infoNode && key == "SZ"){
-        int p = values[0].indexOf(":");
-        if (p == -1)
-            infoNode->xsize = infoNode->ysize = values[0].toInt();
-        else{
-            infoNode->xsize = values[0].left(p).toInt();
-            infoNode->ysize = values[0].mid(p+1).toInt();
+/**
+* decode text value.
+* back slash of shift_jis may be decoded to yen sign, and it is fixed as files decoded at once were.
+*/
+static QString decodeValue(QTextCodec* codec, const QByteArray& value){
+    QString s = codec->toUnicode(value);
+    if (leadBytes(codec) == sgf::eShiftJisLeadBytes)
+        s.replace(QChar(0x00A5), QChar(0x005C));
+    return s;
+}
+
+/**
+* set property to n.
+* values are raw bytes, only text values are decoded by codec.
+*/
+bool sgf::node::get(go::nodePtr n, eProperty id, const QByteArray& key, const valueList& values, QTextCodec* codec){
+    go::informationNode* infoNode = go::informationCast(n.get());
+
+    switch (id){
+        // game information
+        case ePW: if (infoNode) infoNode->whitePlayer = decodeValue(codec, values[0]); break;
+        case eWR: if (infoNode) infoNode->whiteRank   = decodeValue(codec, values[0]); break;
+        case eWT: if (infoNode) infoNode->whiteTeam   = decodeValue(codec, values[0]); break;
+        case ePB: if (infoNode) infoNode->blackPlayer = decodeValue(codec, values[0]); break;
+        case eBR: if (infoNode) infoNode->blackRank   = decodeValue(codec, values[0]); break;
+        case eBT: if (infoNode) infoNode->blackTeam   = decodeValue(codec, values[0]); break;
+        case eRE: if (infoNode) infoNode->result      = decodeValue(codec, values[0]); break;
+        case eTM: if (infoNode) infoNode->time        = decodeValue(codec, values[0]); break;
+        case eOT: if (infoNode) infoNode->overTime    = decodeValue(codec, values[0]); break;
+        case eRO: if (infoNode) infoNode->round       = decodeValue(codec, values[0]); break;
+        case ePC: if (infoNode) infoNode->place       = decodeValue(codec, values[0]); break;
+        case eEV: if (infoNode) infoNode->event       = decodeValue(codec, values[0]); break;
+        case eAN: if (infoNode) infoNode->annotation  = decodeValue(codec, values[0]); break;
+        case eCP: if (infoNode) infoNode->copyright   = decodeValue(codec, values[0]); break;
+        case eON: if (infoNode) infoNode->opening     = decodeValue(codec, values[0]); break;
+        case eRU: if (infoNode) infoNode->rule        = decodeValue(codec, values[0]); break;
+        case eSO: if (infoNode) infoNode->source      = decodeValue(codec, values[0]); break;
+        case eUS: if (infoNode) infoNode->user        = decodeValue(codec, values[0]); break;
+        case eDT: case eRD:  // DT is correct, RD is cyber oro
+            if (infoNode) infoNode->date = decodeValue(codec, values[0]);
+            break;
+        case eGC: case eTC:  // GC is correct, TC is cyber oro.
+            if (infoNode) infoNode->gameComment = decodeValue(codec, values[0]);
+            break;
+        case eKM: case eKO:  // KM is correct, KO is used by cyber oro.
+            if (infoNode) infoNode->komi = values[0].trimmed().toDouble();
+            break;
+        case eHA:
+            if (infoNode) infoNode->handicap = values[0].trimmed().toInt();
+            break;
+        case eSZ:
+            if (infoNode){
+                int p = values[0].indexOf(':');
+                if (p == -1)
+                    infoNode->xsize = infoNode->ysize = values[0].trimmed().toInt();
+                else{
+                    infoNode->xsize = values[0].left(p).trimmed().toInt();
+                    infoNode->ysize = values[0].mid(p+1).trimmed().toInt();
+                }
+            }
+            break;
+        case eGN:
+            if (infoNode) infoNode->gameName = decodeValue(codec, values[0]);
+            break;
+
+        // comment
+        case eC:{
+            QByteArray comment = values[0];
+            for (int i=1; i<values.size(); ++i)
+                comment.append('\n').append(values[i]);
+            n->setComment( n->comment().isEmpty() ? decodeValue(codec, comment) : n->comment() + "\n" + decodeValue(codec, comment) );
+            break;
         }
-    }
-    else if (infoNode && (key == "KM" || key == "KO")) // KM is correct, KO is used by cyber oro.
-        infoNode->komi = values[0].toDouble();
-    else if (infoNode && key == "HA")
-        infoNode->handicap = values[0].toInt();
-    else if (infoNode && key == "TM")
-        infoNode->time = values[0];
-    else if (infoNode && key == "OT")
-        infoNode->overTime = values[0];
-    else if (infoNode && (key == "DT" || key == "RD"))  // DT is correct, RD is cyber oro
-        infoNode->date = values[0];
-    else if (infoNode && (key == "GN" || key == "TE"))  // GN is correct, TE is cyber oro
-        infoNode->gameName = values[0];
-    else if (infoNode && key == "RO")
-        infoNode->round = values[0];
-    else if (infoNode && key == "PC")
-        infoNode->place = values[0];
-    else if (infoNode && key == "EV")
-        infoNode->event = values[0];
-    else if (infoNode && (key == "GC" || key == "TC")) // GC is correct, TC is cyber oro.
-        infoNode->gameComment = values[0];
-    else if (infoNode && key == "AN")
-        infoNode->annotation = values[0];
-    else if (infoNode && key == "CP")
-        infoNode->copyright = values[0];
-    else if (infoNode && key == "ON")
-        infoNode->opening = values[0];
-    else if (infoNode && key == "RU")
-        infoNode->rule = values[0];
-    else if (infoNode && key == "SO")
-        infoNode->source = values[0];
-    else if (infoNode && key == "US")
-        infoNode->user = values[0];
-
-    // comment
-    else if (key == "C")
-        n->comment = values.join("\n");
-    else if (key == "N" || key == "RN")  // N is correct, RN is cyber oro version?
-        n->name = values[0];
-    else if (key == "MN")
-        n->moveNumber = values[0].toInt();
-
-    // move
-    else if (key == "B" || key == "W"){
-        n->setColor( key == "B" ? go::black : go::white);
-        int x, y;
-        if (pointToInt(values[0], x, y)){
-            n->setX(x);
-            n->setY(y);
+        case eN: case eRN:  // N is correct, RN is cyber oro version?
+            n->setName( decodeValue(codec, values[0]) );
+            break;
+        case eMN:
+            n->moveNumber = values[0].trimmed().toInt();
+            break;
+
+        // move
+        case eB: case eW:{
+            n->setColor( id == eB ? go::black : go::white);
+            int x, y;
+            if (pointToInt(values[0], x, y)){
+                n->setX(x);
+                n->setY(y);
+            }
+            break;
         }
+        case ePL:
+            n->nextColor = values[0] == "B" ? go::black : go::white;
+            break;
+
+        // mark
+        case eMA: case eM: addMark(n->editMarks(), values, mark::eCross); break;
+        case eTR: addMark(n->editMarks(), values, mark::eTriangle); break;
+        case eCR: addMark(n->editMarks(), values, mark::eCircle); break;
+        case eSQ: addMark(n->editMarks(), values, mark::eSquare); break;
+        case eSL: addMark(n->editMarks(), values, mark::eSelect); break;
+        case eLB: addMark(n->editMarks(), values, codec); break;
+        case eTB: addMark(n->editBlackTerritories(), values, mark::eBlackTerritory); break;
+        case eTW: addMark(n->editWhiteTerritories(), values, mark::eWhiteTerritory); break;
+        case eDD: addMark(n->editDims(), values, mark::eDim); break;
+        case eAB: addStone(n->editBlackStones(), go::black, values); break;
+        case eAW: addStone(n->editWhiteStones(), go::white, values); break;
+        case eAE: addStone(n->editEmptyStones(), go::empty, values); break;
+
+        // move annotation
+        case eTE:
+            if (infoNode)  // TE is game name of cyber oro
+                infoNode->gameName = decodeValue(codec, values[0]);
+            else
+                n->setMoveAnnotation(values[0].trimmed().toInt() > 1 ? go::node::eVeryGoodMove : go::node::eGoodMove);
+            break;
+        case eBM:
+            n->setMoveAnnotation(values[0].trimmed().toInt() > 1 ? go::node::eVeryBadMove : go::node::eBadMove);
+            break;
+        case eDO: n->setMoveAnnotation(go::node::eDoubtfulMove); break;
+        case eIT: n->setMoveAnnotation(go::node::eInterestingMove); break;
+
+        // node annotation
+        case eDM: n->setNodeAnnotation(go::node::eEven); break;
+        case eGB:
+            n->setNodeAnnotation(values[0].trimmed().toInt() > 1 ? go::node::eVeryGoodForBlack : go::node::eGoodForBlack);
+            break;
+        case eGW:
+            n->setNodeAnnotation(values[0].trimmed().toInt() > 1 ? go::node::eVeryGoodForWhite : go::node::eGoodForWhite);
+            break;
+        case eUC: n->setNodeAnnotation(go::node::eUnclear); break;
+
+        // annotation
+        case eHO: n->setAnnotation(go::node::eHotspot); break;
+
+        // written by mugo itself.
+        case eGM: case eFF: case eCA: case eAP: case ePT:
+            break;
+
+        // keep unknown property as raw bytes to save it again.
+        // keys of old sgf (FF[1]-FF[3]) such as "AddBlack" are kept as they are.
+        case eUnknownProperty:
+            if (key.isEmpty())
+                break;
+            n->information()->propertyCodec = codec;
+            n->editUnknownProperties().push_back( qMakePair(key, values) );
+            break;
     }
-    else if (key == "PL")
-        n->nextColor = values[0] == "B" ? go::black : go::white;
-
-    // mark
-    else if (key == "MA" || key == "M")
-        addMark(n->marks, values, mark::eCross);
-    else if (key == "TR")
-        addMark(n->marks, values, mark::eTriangle);
-    else if (key == "CR")
-        addMark(n->marks, values, mark::eCircle);
-    else if (key == "SQ")
-        addMark(n->marks, values, mark::eSquare);
-    else if (key == "SL")
-        addMark(n->marks, values, mark::eSelect);
-    else if (key == "LB")
-        addMark(n->marks, values);
-    else if (key == "TB")
-        addMark(n->blackTerritories, values, mark::eBlackTerritory);
-    else if (key == "TW")
-        addMark(n->whiteTerritories, values, mark::eWhiteTerritory);
-    else if (key == "DD")
-        addMark(n->dims, values, mark::eDim);
-    else if (key == "AB")
-        addStone(n->blackStones, key, values);
-    else if (key == "AW")
-        addStone(n->whiteStones, key, values);
-    else if (key == "AE")
-        addStone(n->emptyStones, key, values);
-
-    // move annotation
-    else if (key == "TE")
-        n->moveAnnotation = values[0].toInt() > 1 ? go::node::eVeryGoodMove : go::node::eGoodMove;
-    else if (key == "BM")
-        n->moveAnnotation = values[0].toInt() > 1 ? go::node::eVeryBadMove : go::node::eBadMove;
-    else if (key == "DO")
-        n->moveAnnotation = go::node::eDoubtfulMove;
-    else if (key == "IT")
-        n->moveAnnotation = go::node::eInterestingMove;
-
-    // node annotation
-    else if (key == "DM")
-        n->nodeAnnotation = go::node::eEven;
-    else if (key == "GB")
-        n->nodeAnnotation = values[0].toInt() > 1 ? go::node::eVeryGoodForBlack : go::node::eGoodForBlack;
-    else if (key == "GW")
-        n->nodeAnnotation = values[0].toInt() > 1 ? go::node::eVeryGoodForWhite : go::node::eGoodForWhite;
-    else if (key == "UC")
-        n->nodeAnnotation = go::node::eUnclear;
-
-    // annotation
-    else if (key == "HO")
-        n->annotation = go::node::eHotspot;
 
     return true;
 }
 
 bool sgf::node::set(const go::nodePtr n){
-    const go::informationNode* infoNode = dynamic_cast<const go::informationNode*>(n.get());
+    const go::informationNode* infoNode = go::informationCast(n.get());
     if (infoNode){
         property["GM"].push_back("1");
         property["FF"].push_back("4");
@@ -276,7 +560,7 @@ bool sgf::node::set(const go::nodePtr n){
     else if (n->isStone()){
         QString str;
         if (!n->isPass())
-            str = pointToString(n->position.x, n->position.y);
+            str = pointToString(n->getX(), n->getY());
         propertyType::key_type key = n->isBlack() ? "B" : "W";
         property[key].push_back(str);
 
@@ -284,10 +568,10 @@ bool sgf::node::set(const go::nodePtr n){
             property["MN"].push_back( QString("%1").arg(n->moveNumber) );
     }
 
-    if (!n->name.isEmpty())
-        property["N"].push_back(n->name);
-    if (!n->comment.isEmpty())
-        property["C"].push_back(n->comment);
+    if (!n->name().isEmpty())
+        property["N"].push_back(n->name());
+    if (!n->comment().isEmpty())
+        property["C"].push_back(n->comment());
 
 /*
     if (n->nextColor == go::black)
@@ -297,177 +581,607 @@ bool sgf::node::set(const go::nodePtr n){
 */
 
     // marker
-    set(n->marks);
-    set(n->blackTerritories);
-    set(n->whiteTerritories);
-    set(n->emptyStones);
-    set(n->blackStones);
-    set(n->whiteStones);
-    set(n->dims);
-
-    if (n->moveAnnotation == go::node::eGoodMove)
+    set(n->marks());
+    set(n->blackTerritories());
+    set(n->whiteTerritories());
+    set(n->emptyStones());
+    set(n->blackStones());
+    set(n->whiteStones());
+    set(n->dims());
+
+    if (n->moveAnnotation() == go::node::eGoodMove)
         property["TE"].push_back("1");
-    if (n->moveAnnotation == go::node::eVeryGoodMove)
+    if (n->moveAnnotation() == go::node::eVeryGoodMove)
         property["TE"].push_back("2");
-    else if (n->moveAnnotation == go::node::eBadMove)
+    else if (n->moveAnnotation() == go::node::eBadMove)
         property["BM"].push_back("1");
-    else if (n->moveAnnotation == go::node::eVeryBadMove)
+    else if (n->moveAnnotation() == go::node::eVeryBadMove)
         property["BM"].push_back("2");
-    else if (n->moveAnnotation == go::node::eDoubtfulMove)
+    else if (n->moveAnnotation() == go::node::eDoubtfulMove)
         property["DO"].push_back("");
-    else if (n->moveAnnotation == go::node::eInterestingMove)
+    else if (n->moveAnnotation() == go::node::eInterestingMove)
         property["IT"].push_back("");
 
-    if (n->nodeAnnotation == go::node::eEven)
+    if (n->nodeAnnotation() == go::node::eEven)
         property["DM"].push_back("1");
-    else if (n->nodeAnnotation == go::node::eGoodForBlack)
+    else if (n->nodeAnnotation() == go::node::eGoodForBlack)
         property["GB"].push_back("1");
-    else if (n->nodeAnnotation == go::node::eVeryGoodForBlack)
+    else if (n->nodeAnnotation() == go::node::eVeryGoodForBlack)
         property["GB"].push_back("2");
-    else if (n->nodeAnnotation == go::node::eGoodForWhite)
+    else if (n->nodeAnnotation() == go::node::eGoodForWhite)
         property["GW"].push_back("1");
-    else if (n->nodeAnnotation == go::node::eVeryGoodForWhite)
+    else if (n->nodeAnnotation() == go::node::eVeryGoodForWhite)
         property["GW"].push_back("2");
-    else if (n->nodeAnnotation == go::node::eUnclear)
+    else if (n->nodeAnnotation() == go::node::eUnclear)
         property["UC"].push_back("1");
 
-    if (n->annotation == go::node::eHotspot)
+    if (n->annotation() == go::node::eHotspot)
         property["HO"].push_back("1");
 
+    if (n->hasProperty() && !n->unknownProperties().empty()){
+        QTextCodec* codec = n->information()->propertyCodec;
+        if (codec == NULL)
+            codec = QTextCodec::codecForName("UTF-8");
+        foreach(const go::propertyList::value_type& p, n->unknownProperties()){
+            QStringList& values = property[ codec->toUnicode(p.first) ];
+            foreach(const QByteArray& v, p.second)
+                values.push_back( decodeValue(codec, v) );
+        }
+    }
+
     return false;
 }
 
+/**
+* cover points with compressed rectangles ("aa:cc") of sgf, and add them to values.
+* rectangles are taken greedily from top left, each one as wide and then as tall as possible.
+*/
+static void addRectangles(QStringList& values, const QVector<go::point>& points){
+    enum{ N = 53 };  // 'a'-'z' and 'A'-'Z'
+    bool exists[N][N];
+    memset(exists, 0, sizeof(exists));
+
+    int minX = N, minY = N, maxX = -1, maxY = -1;
+    foreach(const go::point& p, points){
+        if (p.x < 0 || p.x >= N || p.y < 0 || p.y >= N){
+            values.push_back( sgf::pointToString(p) );
+            continue;
+        }
+        exists[p.y][p.x] = true;
+        minX = qMin(minX, p.x);
+        minY = qMin(minY, p.y);
+        maxX = qMax(maxX, p.x);
+        maxY = qMax(maxY, p.y);
+    }
+
+    for (int y=minY; y<=maxY; ++y){
+        for (int x=minX; x<=maxX; ++x){
+            if (!exists[y][x])
+                continue;
+
+            int x2 = x;
+            while (x2 < maxX && exists[y][x2+1])
+                ++x2;
+
+            int y2 = y;
+            while (y2 < maxY){
+                int i = x;
+                while (i <= x2 && exists[y2+1][i])
+                    ++i;
+                if (i <= x2)
+                    break;
+                ++y2;
+            }
+
+            for (int j=y; j<=y2; ++j)
+                for (int i=x; i<=x2; ++i)
+                    exists[j][i] = false;
+
+            if (x == x2 && y == y2)
+                values.push_back( sgf::pointToString(x, y) );
+            else
+                values.push_back( sgf::pointToString(x, y) + ':' + sgf::pointToString(x2, y2) );
+        }
+    }
+}
+
 bool sgf::node::set(const go::markList& markList){
+    // key of each mark::eType
+    static const char* const keys[] = { "MA", "CR", "SQ", "TR", "LB", "TB", "TW", "DD", "SL" };
+    static const int N = sizeof(keys) / sizeof(keys[0]);
+
+    QVector<go::point> points[N];
     markList::const_iterator iter = markList.begin();
     while (iter != markList.end()){
-        switch (iter->t){
-            case go::mark::eCross:
-                property["MA"].push_back( pointToString(iter->p) );
-                break;
-            case go::mark::eCircle:
-                property["CR"].push_back( pointToString(iter->p) );
-                break;
-            case go::mark::eSquare:
-                property["SQ"].push_back( pointToString(iter->p) );
-                break;
-            case go::mark::eTriangle:
-                property["TR"].push_back( pointToString(iter->p) );
-                break;
-            case go::mark::eSelect:
-                property["SL"].push_back( pointToString(iter->p) );
-                break;
-            case go::mark::eCharacter:
-                property["LB"].push_back( pointToString(iter->p, &iter->s) );
-                break;
-            case go::mark::eBlackTerritory:
-                property["TB"].push_back( pointToString(iter->p) );
-                break;
-            case go::mark::eWhiteTerritory:
-                property["TW"].push_back( pointToString(iter->p) );
-                break;
-            case go::mark::eDim:
-                property["DD"].push_back( pointToString(iter->p) );
-                break;
-        };
+        if (iter->t == go::mark::eCharacter)
+            property["LB"].push_back( pointToString(iter->p, &iter->s) );
+        else
+            points[iter->t].push_back(iter->p);
         ++iter;
     }
 
+    for (int i=0; i<N; ++i)
+        if (!points[i].empty())
+            addRectangles(property[keys[i]], points[i]);
+
     return true;
 }
 
 bool sgf::node::set(const go::stoneList& stoneList){
+    QVector<go::point> black, white, empty;
     go::stoneList::const_iterator iter = stoneList.begin();
     while (iter != stoneList.end()){
         if (iter->isBlack())
-            property["AB"].push_back( pointToString(iter->p) );
+            black.push_back(iter->p);
         else if (iter->isWhite())
-            property["AW"].push_back( pointToString(iter->p) );
+            white.push_back(iter->p);
         else if (iter->isEmpty())
-            property["AE"].push_back( pointToString(iter->p) );
+            empty.push_back(iter->p);
         ++iter;
     }
 
+    if (!black.empty())
+        addRectangles(property["AB"], black);
+    if (!white.empty())
+        addRectangles(property["AW"], white);
+    if (!empty.empty())
+        addRectangles(property["AE"], empty);
+
     return true;
 }
 
-void sgf::node::addMark(go::markList& markList, const QStringList& values, const char* str) const{
-    QStringList::const_iterator iter = values.begin();
+void sgf::node::addMark(go::markList& markList, const valueList& values, QTextCodec* codec){
+    valueList::const_iterator iter = values.begin();
     while (iter != values.end()){
         int x, y;
-        QString str2;
-        if (pointToInt(*iter, x, y, &str2))
-            markList.push_back( go::mark(x, y, str2.isEmpty() ? str : str2) );
+        QByteArray str;
+        if (pointToInt(*iter, x, y, &str))
+            markList.push_back( go::mark(x, y, decodeValue(codec, str)) );
         ++iter;
     }
 }
 
-void sgf::node::addMark(go::markList& markList, const QStringList& values, mark::eType type) const{
-    QStringList::const_iterator iter = values.begin();
+void sgf::node::addMark(go::markList& markList, const valueList& values, mark::eType type){
+    valueList::const_iterator iter = values.begin();
     while (iter != values.end()){
-        QList<int> x, y;
-        if (pointToIntList(*iter, x, y))
-            for(int i=0; i<x.size(); ++i)
-                markList.push_back( go::mark(x[i], y[i], type) );
+        int x1, y1, x2, y2;
+        if (pointToRect(*iter, x1, y1, x2, y2))
+            for (int y=y1; y<=y2; ++y)
+                for (int x=x1; x<=x2; ++x)
+                    markList.push_back( go::mark(x, y, type) );
         ++iter;
     }
 }
 
-void sgf::node::addStone(go::stoneList& stoneList, const QString& key, const QStringList& values) const{
-    go::color c = key == "AB" ? go::black : key == "AW" ? go::white : go::empty;
-
-    QStringList::const_iterator iter = values.begin();
+void sgf::node::addStone(go::stoneList& stoneList, go::color c, const valueList& values){
+    valueList::const_iterator iter = values.begin();
     while (iter != values.end()){
-        QList<int> x, y;
-        if (pointToIntList(*iter, x, y))
-            for (int i=0; i<x.size(); ++i)
-                stoneList.push_back( go::stone(x[i], y[i], c) );
+        int x1, y1, x2, y2;
+        if (pointToRect(*iter, x1, y1, x2, y2))
+            for (int y=y1; y<=y2; ++y)
+                for (int x=x1; x<=x2; ++x)
+                    stoneList.push_back( go::stone(x, y, c) );
         ++iter;
     }
 }
 
-bool sgf::readStream(QString::iterator& first, QString::iterator last){
-    while (first != last){
-        wchar_t c = first->unicode();
-        ++first;
-        if (c == L'('){
-            nodePtr root(new node());
-            if (readBranch(first, last, root) == false)
-                continue;
+/**
+* returns true if bytes of sgf syntax never appear in multibyte characters of codec.
+* shift_jis, big5 and gbk use '\\' and ']' as trail byte, and their values are scanned by leadBytes.
+*/
+static bool isAsciiCompatible(QTextCodec* codec){
+    static const char* const names[] = {
+        "UTF-8", "US-ASCII", "ISO-8859-", "windows-125", "EUC-JP", "EUC-KR", "KOI8-"
+    };
+    static const int N = sizeof(names) / sizeof(names[0]);
 
-            if (root->getChildNodes().empty())
-                continue;
+    if (codec == NULL)
+        return false;
+
+    QByteArray name = codec->name();
+    for (int i=0; i<N; ++i)
+        if (qstrnicmp(name, names[i], qstrlen(names[i])) == 0)
+            return true;
+
+    return false;
+}
+
+/**
+* collection file read by sgf.
+* games are indexed at first, and each game is parsed when it is used.
+* only recently used games keep their trees.
+*/
+class sgfCollection{
+public:
+    sgfCollection(const fileBufferPtr& buffer_, QTextCodec* codec_) : buffer(buffer_), bytes(buffer_->bytes), codec(codec_){}
+
+    fileBufferPtr buffer;  // keeps mapped file
+    QByteArray  bytes;
+    QTextCodec* codec;
+    loadedGameList loadedGames;
+};
+typedef boost::shared_ptr<sgfCollection> sgfCollectionPtr;
+
+/**
+* byte range of one game in collection.
+*/
+class sgfGameLoader : public gameLoader{
+public:
+    sgfGameLoader(const sgfCollectionPtr& collection_, int first_, int last_)
+        : collection(collection_), first(first_), last(last_){}
+
+    virtual bool parse(informationNode* info) const;
+    virtual void loaded(informationNode* info){ collection->loadedGames.loaded(info); }
+    virtual bool canCopy(QTextCodec* codec) const;
+    virtual bool copy(QIODevice* device, QTextCodec* codec) const;
+    virtual fileBufferPtr source(int& first_, int& last_) const{ first_ = first; last_ = last; return collection->buffer; }
+    virtual void destroyed(informationNode* info){ collection->loadedGames.remove(info); }
+
+    bool parseHeader(informationNode* info) const;
+
+private:
+    sgfCollectionPtr collection;
+    int first;
+    int last;
+};
+
+bool sgfGameLoader::parse(informationNode* info) const{
+    if (!collection->buffer->isIntact())
+        return false;
+
+    sgf reader;
+    const char* p = collection->bytes.constData();
+    const char* iter = p + first;
+    reader.readBranch(iter, p + last, go::nodePtr(info), true, collection->codec);
+    return true;
+}
 
-            nodePtr info = root->getChildNodes().front();
-            if (root->getChildNodes().size() == 1 && info->getProperty().size() == 0)
+/**
+* parse only first node of game for collection list.
+*/
+bool sgfGameLoader::parseHeader(informationNode* info) const{
+    if (!collection->buffer->isIntact())
+        return false;
+
+    sgf reader;
+    const char* p = collection->bytes.constData();
+    const char* iter = p + first;
+    return reader.readHeader(iter, p + last, go::nodePtr(info), collection->codec);
+}
+
+/**
+* find value of CA in first node of game in [first, last).
+* if it is not found, first and last are set to position where CA should be inserted.
+* returns true if CA is found.
+*/
+static bool findCharset(const char*& first, const char*& last, sgf::eLeadBytes leads){
+    const char* p = first;
+    while (p != last && isspace((unsigned char)*p))
+        ++p;
+    if (p != last && *p == ';')
+        ++p;
+    const char* node = p;
+
+    while (p != last){
+        if (isspace((unsigned char)*p)){
+            ++p;
+            continue;
+        }
+        else if (*p == ';' || *p == '(' || *p == ')')
+            break;
+
+        // key
+        const char* key = p;
+        while (p != last && *p != '[' && *p != ';' && *p != '(' && *p != ')')
+            ++p;
+        const char* keyEnd = p;
+        while (keyEnd != key && isspace((unsigned char)keyEnd[-1]))
+            --keyEnd;
+        bool charset = keyEnd - key == 2 && key[0] == 'C' && key[1] == 'A';
+
+        // values
+        while (p != last && (*p == '[' || isspace((unsigned char)*p))){
+            if (*p++ != '[')
                 continue;
 
-            root->setNodeType(eRoot);
-            rootList.push_back(root);
-            info->setNodeType(eGameInformation);
+            const char* value = p;
+            while ((p = findValueDelimiter(p, last, leads)) != last && *p == '\\')
+                p = nextCharacter(p + 1, last, leads);
+            if (charset){
+                first = value;
+                last  = p;
+                return true;
+            }
+            if (p != last)
+                ++p;
         }
     }
 
+    first = last = node;
+    return false;
+}
+
+/**
+* bytes can't be copied if they are encoded by other codec, game is not closed, or source file is changed.
+*/
+bool sgfGameLoader::canCopy(QTextCodec* codec) const{
+    return codec == collection->codec && collection->buffer->isIntact() && collection->bytes[last - 1] == ')';
+}
+
+/**
+* write game as it is in source file.
+* CA of game is replaced by codec, because bytes are decoded from other codec if codec of file is not ascii compatible,
+* and file may be read by codec which is different from its CA.
+*/
+bool sgfGameLoader::copy(QIODevice* device, QTextCodec* codec) const{
+    if (!canCopy(codec))
+        return false;
+
+    const char* begin = collection->bytes.constData() + first - 1;  // '(' of game
+    const char* end   = collection->bytes.constData() + last;
+    const char* charsetFirst = begin + 1;
+    const char* charsetLast  = end;
+    bool found = findCharset(charsetFirst, charsetLast, leadBytes(collection->codec));
+
+    const QByteArray name = codec->name();
+    if (found && charsetLast - charsetFirst == name.size() && qstrnicmp(charsetFirst, name.constData(), name.size()) == 0)
+        return device->write(begin, end - begin) == end - begin;
+
+    QByteArray charset = found ? name : QByteArray("CA[") + name + ']';
+    return device->write(begin, charsetFirst - begin) == charsetFirst - begin &&
+           device->write(charset) == charset.size() &&
+           device->write(charsetLast, end - charsetLast) == end - charsetLast;
+}
+
+/**
+* returns position after ')' which closes game, or last.
+* values are skipped, so parentheses in comments are ignored.
+*/
+static const char* findGameEnd(const char* first, const char* last, sgf::eLeadBytes leads, bool& hasValue){
+    int depth = 1;
+    while ((first = findBranchDelimiter(first, last)) != last){
+        char c = *first++;
+        if (c == '['){
+            hasValue = true;
+            while ((first = findValueDelimiter(first, last, leads)) != last){
+                if (*first++ == ']')
+                    break;
+                first = nextCharacter(first, last, leads);  // escaped character
+            }
+        }
+        else if (c == '(')
+            ++depth;
+        else if (c == ')' && --depth == 0)
+            return first;
+    }
+
+    return last;
+}
+
+/**
+* returns game which has game tree.
+* game which is not loaded is parsed to temporary node, and it is not kept.
+* returns NULL if game can't be parsed.
+*/
+static go::informationPtr loadedGame(const go::informationPtr& info){
+    if (info->isLoaded())
+        return info;
+
+    go::informationPtr game(new go::informationNode);
+    if (!info->loader->parse(game.get()))
+        return go::informationPtr();
+    return game;
+}
+
+static void readGameHeader(go::informationPtr& info){
+    static_cast<sgfGameLoader*>( info->loader.get() )->parseHeader( info.get() );
+}
+
+/**
+* bytes of source buffer are shared with games, and other bytes are copied because they may be released after reading.
+* bytes of codecs which are not ascii compatible, as utf-16, are decoded and encoded to utf-8 in chunks,
+* so that whole text is not kept as QString.
+*/
+bool sgf::readBuffer(const QByteArray& bytes){
+    if (!isAsciiCompatible(codec) && leadBytes(codec) == eNoLeadBytes){
+        textReader reader(bytes, codec, this);
+        QByteArray utf8;
+        utf8.reserve(bytes.size());
+        while (!reader.atEnd())
+            utf8.append( reader.readChunk().toUtf8() );
+        if (reader.canceled())
+            return false;
+        return readStream(fileBufferPtr( new fileBuffer(utf8) ), QTextCodec::codecForName("UTF-8"));
+    }
+    else if (source && source->bytes.constData() == bytes.constData() && source->bytes.size() == bytes.size())
+        return readStream(source, codec);
+    else
+        return readStream(fileBufferPtr( new fileBuffer(QByteArray(bytes.constData(), bytes.size())) ), codec);
+}
+
+/**
+* loaders of games at byte ranges of buffer, given by source() of loaders.
+* snapshot uses them to copy games of source file, which are parsed from snapshot.
+*/
+QList<gameLoaderPtr> sgf::createLoaders(const fileBufferPtr& buffer, QTextCodec* codec, const QVector< QPair<int, int> >& ranges){
+    typedef QPair<int, int> range;
+
+    sgfCollectionPtr collection( new sgfCollection(buffer, codec) );
+    QList<gameLoaderPtr> loaders;
+    foreach(const range& r, ranges){
+        if (r.first > 0 && r.first < r.second && r.second <= buffer->bytes.size())
+            loaders.push_back( gameLoaderPtr(new sgfGameLoader(collection, r.first, r.second)) );
+        else
+            loaders.push_back( gameLoaderPtr() );
+    }
+    return loaders;
+}
+
+bool sgf::readStream(QString::iterator& first, QString::iterator last){
+    // syntax of sgf is ascii, so decoded text is encoded to utf-8 at once and read as bytes.
+    QTextCodec* utf8 = QTextCodec::codecForName("UTF-8");
+    fileBufferPtr buffer( new fileBuffer(utf8->fromUnicode(first, last - first)) );
+    first = last;
+
+    return readStream(buffer, utf8);
+}
+
+/**
+* read games in bytes.
+* collection of several games is indexed with game information only,
+* and each game tree is parsed when it is used.
+*/
+bool sgf::readStream(const fileBufferPtr& buffer, QTextCodec* textCodec){
+    typedef QPair<int, int> range;
+
+    const QByteArray& bytes = buffer->bytes;
+    const char* begin = bytes.constData();
+    const char* end   = begin + bytes.size();
+
+    // bytes may refer mapped file, so collection keeps buffer.
+    sgfCollectionPtr collection( new sgfCollection(buffer, textCodec) );
+    eLeadBytes leads = leadBytes(textCodec);
+    go::informationPtr first;
+
+    QVector<range> games;
+    const char* p = begin;
+    while (p != end && (p = static_cast<const char*>( memchr(p, '(', end - p) )) != NULL){
+        if (!updateProgress(p - begin, end - begin))
+            return false;
+
+        bool hasValue = false;
+        const char* q = findGameEnd(p + 1, end, leads, hasValue);
+        if (hasValue)
+            games.push_back( range(p + 1 - begin, q - begin) );
+        p = q;
+
+        // file is collection, so first game is shown before rest is indexed.
+        if (games.size() == 2 && !first){
+            first.reset(new go::informationNode);
+            first->loader.reset( new sgfGameLoader(collection, games[0].first, games[0].second) );
+            first->loaded = false;
+            readGameHeader(first);
+            setFirstGame(first);
+        }
+    }
+
+    if (games.size() < 2){
+        p = begin;
+        return readStream(p, end, textCodec);
+    }
+
+    go::informationList infos;
+    for (int i=1; i<games.size(); ++i){
+        go::informationPtr info(new go::informationNode);
+        info->loader.reset( new sgfGameLoader(collection, games[i].first, games[i].second) );
+        info->loaded = false;
+        infos.push_back(info);
+    }
+
+    // games are independent, so their headers are read in parallel.
+    // first game is not read again, it may be loaded by gui already.
+    QtConcurrent::blockingMap(infos, readGameHeader);
+    gameList.push_back(first);
+    gameList += infos;
+
     return true;
 }
 
+bool sgf::readStream(const char*& first, const char* last, QTextCodec* textCodec){
+    const char* begin = first;
+    while (first != last){
+        if (!updateProgress(first - begin, last - begin))
+            return false;
+
+        const char* p = static_cast<const char*>( memchr(first, '(', last - first) );
+        if (p == NULL)
+            break;
+
+        first = p + 1;
+        go::informationPtr info(new go::informationNode);
+        if (readBranch(first, last, info, true, textCodec))
+            gameList.push_back(info);
+    }
+
+    first = last;
+    return true;
+}
+
+/**
+* read first node of game to info.
+*/
+bool sgf::readHeader(const char*& first, const char* last, go::nodePtr info, QTextCodec* textCodec){
+    while (first != last && isspace((unsigned char)*first))
+        ++first;
+
+    if (first == last || *first == '(' || *first == ')')
+        return false;
+    else if (*first == ';')
+        ++first;
+
+    int pt = 1;
+    readNode(first, last, info, pt, textCodec);
+    return true;
+}
+
+/**
+* write games which are set by set().
+* nodes are converted one by one, and flushed to stream every line.
+*/
 bool sgf::saveStream(QTextStream& stream){
-    foreach (nodePtr root, rootList){
-        if (codec){
-            foreach (nodePtr info, root->getChildNodes()){
-                info->setProperty("CA", QStringList(codec->name()));
+    int count = 0;
+    for (int i=0; i<sourceList.size(); i+=PARSE_GAMES_AT_ONCE){
+        // game which is not modified is copied from source file, and others are parsed in parallel.
+        go::informationList games = sourceList.mid(i, PARSE_GAMES_AT_ONCE);
+        QVector<bool> copies;
+        foreach(const go::informationPtr& info, games)
+            copies.push_back( !info->dirty && info->loader && stream.device() && info->loader->canCopy(codec) );
+        go::informationList trees = go::parseGames(games, copies);
+
+        for (int j=0; j<games.size(); ++j){
+            if (!updateProgress(count++, sourceList.size()))
+                return false;
+
+            if (copies[j]){
+                stream.flush();
+                if (games[j]->loader->copy(stream.device(), codec)){
+                    stream << '\n';
+                    continue;
+                }
             }
-        }
 
-        QString s;
-        writeNode(stream, s, root);
-        if (!s.isEmpty())
-            stream << s;
-        stream << '\n';
+            // game of changed source file is not written as empty tree.
+            go::informationPtr tree = trees[j] ? trees[j] : loadedGame(games[j]);
+            if (!tree)
+                return false;
+            QString s;
+            s.reserve(SGF_LINEWIDTH * 2);
+            s.push_back('(');
+            writeNode(stream, s, tree);
+            s.push_back(')');
+            stream << s << '\n';
+        }
     }
 
     return true;
 }
 
+/**
+* returns confidence (0-100) that head of file is sgf.
+*/
+int sgf::probe(const QByteArray& head){
+    int i = headStart(head);
+    if (i < head.size() && head[i] == '('){
+        while (++i < head.size() && isspace((unsigned char)head[i]))
+            ;
+        // ';' does not exist in korean sgf.
+        if (i < head.size() && (head[i] == ';' || isupper((unsigned char)head[i])))
+            return 100;
+    }
+
+    return head.contains("(;") ? 40 : 0;
+}
+
 QTextCodec* sgf::getCodec(const QByteArray& a) const{
     int s = a.indexOf("CA[");
     if (s == -1)
@@ -485,118 +1199,143 @@ QTextCodec* sgf::getCodec(const QByteArray& a) const{
         return QTextCodec::codecForName(name.toAscii());
 }
 
-bool sgf::readBranch(QString::iterator& first, QString::iterator last, nodePtr n){
-    n->setNodeType(sgf::eBranch);
-    nodePtr branchParent;
-    nodeList::iterator branchNode = n->getChildNodes().end();
-    int pt = 1;
+/**
+* read branch and create go::node directly.
+* if root is true, first node of branch is game information and stored to parent.
+* returns false if branch has no node.
+*/
+bool sgf::readBranch(const char*& first, const char* last, go::nodePtr parent, bool root, QTextCodec* textCodec){
+    go::nodePtr tail = parent;
+    go::nodePtr branchParent;
+    int  branchIndex = -1;
+    int  elements = 0;
+    bool hasProperty = false;
+    int  pt = 1;
 
     while (first != last){
-        wchar_t c = first->unicode();
-        ++first;
+        char c = *first++;
 
-        if (c == L')')
-            return true;
+        if (c == ')')
+            break;
         // only ';' or '(' appears hear, but ';' does not exist in korean sgf.
-        else if (c != L';' && c != L'(' && iswspace(c))
+        else if (c != ';' && c != '(' && isspace((unsigned char)c))
             continue;
 
-        if (c == L'('){
-            nodePtr newNode( new node );
-            nodeList::iterator iter = n->getChildNodes().insert(n->getChildNodes().end(), newNode);
-
-            readBranch(first, last, newNode);
-
-            if (branchNode == n->getChildNodes().end()){
-                branchNode = iter;
-                branchParent = n;
+        if (c == '('){
+            if (branchIndex < 0){
+                branchParent = tail;
+                branchIndex  = tail->childNodes().size();
             }
+            readBranch(first, last, tail, false, textCodec);
+            ++elements;
         }
         else{
             if (c != ';')
                 --first;
 
-            nodePtr newNode( new node );
-
+            go::nodePtr newNode;
             if (pt == 1){
-                if ( branchNode == n->getChildNodes().end() )
-                    n->getChildNodes().push_back(newNode);
+                if (root && elements == 0)
+                    newNode = parent;
+                else if (branchIndex < 0){
+                    newNode = go::createNode(tail);
+                    tail->childNodes().push_back(newNode);
+                }
                 else{
                     // cyber oro? original format.
-                    newNode->setNodeType(sgf::eBranch);
-                    branchParent->getChildNodes().insert(branchNode, newNode);
-                    n = newNode;
-                    branchNode = n->getChildNodes().end();
+                    // node after variations continues before first variation.
+                    newNode = go::createNode(branchParent);
+                    branchParent->childNodes().insert(branchIndex, newNode);
                     branchParent.reset();
-                    newNode.reset( new node );
-                    n->getChildNodes().push_back(newNode);
+                    branchIndex = -1;
                 }
+                tail = newNode;
+                ++elements;
             }
             else
                 --pt;
-            readNode(first, last, newNode, pt);
+
+            int n = readNode(first, last, newNode, pt, textCodec);
+            if (newNode && elements == 1)
+                hasProperty = n > 0;
         }
     }
 
-    return true;
+    return elements > 1 || (elements == 1 && hasProperty);
 }
 
-bool sgf::readNode(QString::iterator& first, QString::iterator last, nodePtr& n, int& pt){
+/**
+* read properties of node, and set them to n.
+* if n is null, properties are read and discarded.
+* returns number of properties.
+*/
+int sgf::readNode(const char*& first, const char* last, go::nodePtr n, int& pt, QTextCodec* textCodec){
+    eLeadBytes leads = leadBytes(textCodec);
+    int num = 0;
     while (first != last){
-        wchar_t c = first->unicode();
-        if (iswspace(c)){
+        char c = *first;
+        if (isspace((unsigned char)c)){
             ++first;
             continue;
         }
-        else if (c == L';' || c == L'(' || c == L')'){
+        else if (c == ';' || c == '(' || c == ')'){
             break;
         }
 
-        QString key;
-        key.reserve(5);
+        QByteArray key;
         if (readNodeKey(first, last, key) == false)
-            return false;
+            break;
 
-        QStringList values;
-        if (readNodeValues(first, last, values) == false)
-            return false;
+        valueList values;
+        if (readNodeValues(first, last, values, leads) == false)
+            break;
 
-        n->setProperty(key, values);
+        ++num;
+        eProperty id = propertyId(key.constData(), key.size());
+        if (n)
+            node::get(n, id, key, values, textCodec);
 
         // for cyber oro?
-        if (key == "PT")
+        if (id == ePT)
             pt = values[0].toInt();
     }
 
-    return true;
+    return num;
 }
 
-bool sgf::readNodeKey(QString::iterator& first, QString::iterator last, QString& key){
-    while (first != last){
-        wchar_t c = first->unicode();
-        if (c == L'[')
+bool sgf::readNodeKey(const char*& first, const char* last, QByteArray& key){
+    const char* p = first;
+    while (p != last){
+        char c = *p;
+        if (c == '['){
+            // white spaces between key and value are not part of key.
+            const char* q = p;
+            while (q != first && isspace((unsigned char)q[-1]))
+                --q;
+            key = QByteArray(first, q - first);
+            first = p;
             return true;
-        else if (c == L';' || c == L'(' || c == L')')
+        }
+        else if (c == ';' || c == '(' || c == ')'){
+            first = p;
             return false;
-        else{
-            key.push_back(c);
-            ++first;
         }
+        ++p;
     }
 
+    first = p;
     return false;
 }
 
-bool sgf::readNodeValues(QString::iterator& first, QString::iterator last, QStringList& values){
+bool sgf::readNodeValues(const char*& first, const char* last, valueList& values, eLeadBytes leads){
     while (first != last){
-        wchar_t c = first->unicode();
-        if (c == L'['){
-            QString v;
-            v.reserve(100);
-            if (readNodeValue(++first, last, v))
+        char c = *first;
+        if (c == '['){
+            QByteArray v;
+            if (readNodeValue(++first, last, v, leads))
                 values.push_back(v);
         }
-        else if (iswspace(c))
+        else if (isspace((unsigned char)c))
             ++first;
         else
             return true;
@@ -605,42 +1344,240 @@ bool sgf::readNodeValues(QString::iterator& first, QString::iterator last, QStri
     return false;
 }
 
-bool sgf::readNodeValue(QString::iterator& first, QString::iterator last, QString& value){
-    while (first != last){
-        wchar_t c = first->unicode();
-        ++first;
-
-        if (c == ']')
+/**
+* read value until ']'.
+* text between escapes is copied at once.
+*/
+bool sgf::readNodeValue(const char*& first, const char* last, QByteArray& value, eLeadBytes leads){
+    const char* p = first;
+    while ((p = findValueDelimiter(p, last, leads)) != last){
+        if (*p == ']'){
+            value.append(first, p - first);
+            first = p + 1;
+
+            // file is not read in text mode, so CR of line break is removed here.
+            if (memchr(value.constData(), '\r', value.size()))
+                value.replace("\r", "");
             return true;
-
-        if (c == '\\'){
-            c = first->unicode();
-            ++first;
         }
-        value.push_back(c);
+
+        // escaped character is copied with next segment.
+        value.append(first, p - first);
+        if (++p == last)
+            break;
+        first = p;
+        p = nextCharacter(p, last, leads);
     }
 
+    first = last;
     return false;
 }
 
-bool sgf::writeNode(QTextStream& stream, QString& s, const nodePtr& n){
-    if (n->getNodeType() == eBranch || n->getNodeType() == eRoot){
-        s.push_back('(');
-        foreach(const nodePtr& childNode, n->getChildNodes()){
-            writeNode(stream, s, childNode);
+/**
+* append node n to str.
+* properties are written in order of eProperty directly from n, and unknown properties are written last.
+* codec is written to CA of game information if it is not NULL.
+*/
+void sgf::writeProperties(QString& str, const go::node* n, QTextCodec* codec){
+    // mark::eType of MA, CR, SQ, TR, SL, LB, TB, TW and DD
+    static const go::mark::eType markTypes[] = {
+        go::mark::eCross, go::mark::eCircle, go::mark::eSquare, go::mark::eTriangle, go::mark::eSelect,
+        go::mark::eCharacter, go::mark::eBlackTerritory, go::mark::eWhiteTerritory, go::mark::eDim
+    };
+
+    const go::informationNode* info = go::informationCast(n);
+    const go::nodeProperty* prop = n->property();
+
+    str.push_back(';');
+
+    QString str2;
+    str2.reserve(100);
+
+    // read only properties (KO and later) are not written.
+    for (int i=0; i<eKO; ++i){
+        const eProperty id = static_cast<eProperty>(i);
+        const char* key = propertyNames[i];
+        const QString* text = NULL;
+
+        switch (id){
+            // game information
+            case eGM: if (info) writeProperty(str, str2, key, "1"); break;
+            case eFF: if (info) writeProperty(str, str2, key, "4"); break;
+            case eCA: if (info && codec) writeProperty(str, str2, key, QString(codec->name())); break;
+            case eAP: if (info) writeProperty(str, str2, key, APPNAME ":" VERSION); break;
+            case eSZ:
+                if (info == NULL)
+                    break;
+                else if (info->xsize == info->ysize)
+                    writeProperty(str, str2, key, QString("%1").arg(info->xsize));
+                else
+                    writeProperty(str, str2, key, QString("%1:%2").arg(info->xsize).arg(info->ysize));
+                break;
+            case eKM: if (info) writeProperty(str, str2, key, QString("%1").arg(info->komi)); break;
+            case eHA: if (info && info->handicap != 0) writeProperty(str, str2, key, QString("%1").arg(info->handicap)); break;
+            case eRU: if (info) text = &info->rule; break;
+            case ePW: if (info) text = &info->whitePlayer; break;
+            case eWR: if (info) text = &info->whiteRank; break;
+            case eWT: if (info) text = &info->whiteTeam; break;
+            case ePB: if (info) text = &info->blackPlayer; break;
+            case eBR: if (info) text = &info->blackRank; break;
+            case eBT: if (info) text = &info->blackTeam; break;
+            case eRE: if (info) text = &info->result; break;
+            case eTM: if (info) text = &info->time; break;
+            case eOT: if (info) text = &info->overTime; break;
+            case eDT: if (info) text = &info->date; break;
+            case eGN: if (info) text = &info->gameName; break;
+            case eRO: if (info) text = &info->round; break;
+            case ePC: if (info) text = &info->place; break;
+            case eEV: if (info) text = &info->event; break;
+            case eGC: if (info) text = &info->gameComment; break;
+            case eON: if (info) text = &info->opening; break;
+            case eAN: if (info) text = &info->annotation; break;
+            case eCP: if (info) text = &info->copyright; break;
+            case eSO: if (info) text = &info->source; break;
+            case eUS: if (info) text = &info->user; break;
+
+            // move
+            case eB: case eW:
+                if (info == NULL && (id == eB ? n->isBlack() : n->isWhite()))
+                    writeProperty(str, str2, key, n->isPass() ? QString() : pointToString(n->getX(), n->getY()));
+                break;
+            case eMN:
+                if (info == NULL && n->isStone() && n->moveNumber > 0)
+                    writeProperty(str, str2, key, QString("%1").arg(n->moveNumber));
+                break;
+            case ePL:  // next color is not written.
+                break;
+
+            // setup stones
+            case eAE: case eAB: case eAW:{
+                const go::color c = id == eAB ? go::black : id == eAW ? go::white : go::empty;
+                const go::stoneList& stones = id == eAB ? prop->blackStones : id == eAW ? prop->whiteStones : prop->emptyStones;
+                QVector<go::point> points;
+                foreach(const go::stone& s, stones)
+                    if (s.c == c)
+                        points.push_back(s.p);
+                if (!points.empty()){
+                    QStringList values;
+                    addRectangles(values, points);
+                    writeProperty(str, str2, key, values);
+                }
+                break;
+            }
+
+            // marker
+            case eLB:{
+                QStringList values;
+                foreach(const go::mark& m, prop->marks)
+                    if (m.t == go::mark::eCharacter)
+                        values.push_back( pointToString(m.p, &m.s) );
+                if (!values.empty())
+                    writeProperty(str, str2, key, values);
+                break;
+            }
+            case eMA: case eCR: case eSQ: case eTR: case eSL: case eTB: case eTW: case eDD:{
+                const go::mark::eType t = markTypes[id - eMA];
+                const go::markList* lists[] = { &prop->marks, &prop->blackTerritories, &prop->whiteTerritories, &prop->dims };
+                QVector<go::point> points;
+                for (int j=0; j<4; ++j)
+                    foreach(const go::mark& m, *lists[j])
+                        if (m.t == t)
+                            points.push_back(m.p);
+                if (!points.empty()){
+                    QStringList values;
+                    addRectangles(values, points);
+                    writeProperty(str, str2, key, values);
+                }
+                break;
+            }
+
+            // move annotation
+            case eTE:
+                if (prop->moveAnnotation == go::node::eGoodMove || prop->moveAnnotation == go::node::eVeryGoodMove)
+                    writeProperty(str, str2, key, prop->moveAnnotation == go::node::eGoodMove ? "1" : "2");
+                break;
+            case eBM:
+                if (prop->moveAnnotation == go::node::eBadMove || prop->moveAnnotation == go::node::eVeryBadMove)
+                    writeProperty(str, str2, key, prop->moveAnnotation == go::node::eBadMove ? "1" : "2");
+                break;
+            case eDO: if (prop->moveAnnotation == go::node::eDoubtfulMove) writeProperty(str, str2, key, QString()); break;
+            case eIT: if (prop->moveAnnotation == go::node::eInterestingMove) writeProperty(str, str2, key, QString()); break;
+
+            // node annotation
+            case eC: text = &prop->comment; break;
+            case eDM: if (prop->nodeAnnotation == go::node::eEven) writeProperty(str, str2, key, "1"); break;
+            case eGB:
+                if (prop->nodeAnnotation == go::node::eGoodForBlack || prop->nodeAnnotation == go::node::eVeryGoodForBlack)
+                    writeProperty(str, str2, key, prop->nodeAnnotation == go::node::eGoodForBlack ? "1" : "2");
+                break;
+            case eGW:
+                if (prop->nodeAnnotation == go::node::eGoodForWhite || prop->nodeAnnotation == go::node::eVeryGoodForWhite)
+                    writeProperty(str, str2, key, prop->nodeAnnotation == go::node::eGoodForWhite ? "1" : "2");
+                break;
+            case eUC: if (prop->nodeAnnotation == go::node::eUnclear) writeProperty(str, str2, key, "1"); break;
+            case eHO: if (prop->annotation == go::node::eHotspot) writeProperty(str, str2, key, "1"); break;
+            case eN: text = &prop->name; break;
+
+            default:
+                break;
+        }
+
+        if (text && !text->isEmpty())
+            writeProperty(str, str2, key, *text);
+    }
+
+    // raw values are decoded by codec which they were read with, so they are written as they are if it is same as codec.
+    if (!prop->unknownProperties.empty()){
+        QTextCodec* valueCodec = n->information()->propertyCodec;
+        if (valueCodec == NULL)
+            valueCodec = codec ? codec : QTextCodec::codecForName("UTF-8");
+        foreach(const go::propertyList::value_type& p, prop->unknownProperties){
+            str2.push_back( valueCodec->toUnicode(p.first) );
+            foreach(const QByteArray& v, p.second)
+                writeValue(str, str2, decodeValue(valueCodec, v));
         }
-        s.push_back(')');
     }
-    else{
-        s.append(n->toString());
+
+    str.append(str2);
+}
+
+/**
+* write n and its descendants.
+* nodes are written in depth first order by stack, NULL in stack closes branch.
+*/
+bool sgf::writeNode(QTextStream& stream, QString& s, const go::nodePtr& n){
+    QVector< QPair<go::node*, bool> > stack;  // node, and whether it begins branch
+    stack.push_back( qMakePair(n.get(), false) );
+
+    while (!stack.empty()){
+        go::node* current = stack.back().first;
+        bool branch = stack.back().second;
+        stack.pop_back();
+
+        if (current == NULL){
+            s.push_back(')');
+            continue;
+        }
+        else if (branch)
+            s.push_back('(');
+
+        writeProperties(s, current, codec);
         if (s.size() > SGF_LINEWIDTH){
             stream << s;
-            if (s.right(1) != "\n")
+            if (!s.endsWith('\n'))
                 stream << '\n';
             s.clear();
         }
-        foreach(const nodePtr& childNode, n->getChildNodes()){
-            writeNode(stream, s, childNode);
+
+        if (current->childNodes().size() == 1){
+            stack.push_back( qMakePair(current->childNodes().front().get(), false) );
+            continue;
+        }
+
+        go::nodeList children = current->childNodes().toList();
+        for (int i=children.size()-1; i>=0; --i){
+            stack.push_back( qMakePair(static_cast<go::node*>(NULL), false) );
+            stack.push_back( qMakePair(children[i].get(), true) );
         }
     }
 
@@ -650,12 +1587,35 @@ bool sgf::writeNode(QTextStream& stream, QString& s, const nodePtr& n){
 bool sgf::get(go::data& data) const{
     data.clear();
     data.rootList.clear();
-    foreach(const nodePtr& root, rootList){
-        go::informationPtr info(new go::informationNode(go::nodePtr()));
-        go::nodePtr node(info);
-        get(root, node);
-        data.rootList.push_back(info);
+
+    // games created by readStream are passed as is.
+    if (!gameList.empty()){
+        data.rootList = gameList;
         data.root = data.rootList.front();
+        return true;
+    }
+
+    // games set by set() are copied through sgf::node, and games which are not loaded are parsed in parallel.
+    for (int i=0; i<sourceList.size(); i+=PARSE_GAMES_AT_ONCE){
+        foreach(const go::informationPtr& source, go::parseGames( sourceList.mid(i, PARSE_GAMES_AT_ONCE) )){
+            if (!source)
+                return false;
+
+            nodePtr root(new node());
+            root->setNodeType(eRoot);
+
+            nodePtr gameInfo(new node());
+            gameInfo->set(source);
+            gameInfo->setNodeType(sgf::eGameInformation);
+            root->getChildNodes().push_back(gameInfo);
+            set(gameInfo, source);
+
+            go::informationPtr info(new go::informationNode);
+            go::nodePtr node(info);
+            get(root, node);
+            data.rootList.push_back(info);
+            data.root = data.rootList.front();
+        }
     }
 
     if (data.rootList.empty())
@@ -664,113 +1624,143 @@ bool sgf::get(go::data& data) const{
     return true;
 }
 
-go::nodePtr sgf::get(const nodePtr& sgfNode, go::nodePtr& outNode) const{
-    // process node
+/**
+* create node of sgfNode in outNode.
+* returns outNode for node which has no move, such as branch.
+*/
+static go::nodePtr getNode(const sgf::nodePtr& sgfNode, go::nodePtr& outNode){
     go::nodePtr newNode;
     switch(sgfNode->getNodeType()){
-        case eBlack:
+        case sgf::eBlack:
             newNode = go::createBlackNode(outNode);
             break;
 
-        case eWhite:
+        case sgf::eWhite:
             newNode = go::createWhiteNode(outNode);
             break;
 
-        case eBranch:
+        case sgf::eBranch:
             break;
 
-        case eGameInformation:
+        case sgf::eGameInformation:
             sgfNode->get(outNode);
             break;
 
-        case eRoot:
+        case sgf::eRoot:
             break;
 
         default:
-            newNode.reset( new go::node(outNode) );
+            newNode = go::createNode(outNode);
             break;
     }
 
     if (newNode){
-        outNode->childNodes.push_back(newNode);
+        outNode->childNodes().push_back(newNode);
         sgfNode->get(newNode);
     }
     else
         newNode = outNode;
 
-    // process children
-    go::nodePtr childNode = newNode;
-    foreach(const nodePtr& node, sgfNode->getChildNodes()){
-        childNode = get(node, childNode);
-    }
-
     return newNode;
 }
 
-bool sgf::set(const go::data& data){
-    rootList.clear();
-
-    foreach(const go::informationPtr& info, data.rootList){
-        nodePtr root(new node());
-        root->setNodeType(eRoot);
-        rootList.push_back(root);
+/**
+* sgf node whose children are converted, and go node which next child is added to.
+*/
+class getFrame{
+public:
+    getFrame(const sgf::node* sgfNode_, const go::nodePtr& outNode_)
+        : sgfNode(sgfNode_), child(sgfNode_->getChildNodes().begin()), outNode(outNode_){}
+
+    const sgf::node* sgfNode;
+    sgf::nodeList::const_iterator child;
+    go::nodePtr outNode;
+};
 
-        nodePtr gameInfo(new node());
-        gameInfo->set(info);
-        gameInfo->setNodeType(sgf::eGameInformation);
-        root->getChildNodes().push_back(gameInfo);
+/**
+* convert sgfNode and its descendants in depth first order.
+* each child is added to node of previous child, so children of sgf node are read as sequence.
+*/
+go::nodePtr sgf::get(const nodePtr& sgfNode, go::nodePtr& outNode) const{
+    go::nodePtr newNode = getNode(sgfNode, outNode);
+
+    QVector<getFrame> stack;
+    stack.push_back( getFrame(sgfNode.get(), newNode) );
+    while (!stack.empty()){
+        getFrame& frame = stack.back();
+        if (frame.child == frame.sgfNode->getChildNodes().end()){
+            stack.pop_back();
+            continue;
+        }
 
-        if (set(gameInfo, info) == false)
-            return false;
+        const nodePtr& child = *frame.child++;
+        frame.outNode = getNode(child, frame.outNode);
+        stack.push_back( getFrame(child.get(), frame.outNode) );
     }
+
+    return newNode;
+}
+
+/**
+* set games to write or copy.
+* games are referred until they are written, not converted here.
+*/
+bool sgf::set(const go::data& data){
+    gameList.clear();
+    sourceList = data.rootList;
     return true;
 }
 
 bool sgf::set(const go::informationPtr& info){
-    rootList.clear();
+    gameList.clear();
+    sourceList.clear();
+    sourceList.push_back(info);
+    return true;
+}
 
-    nodePtr root(new node());
-    root->setNodeType(eRoot);
-    rootList.push_back(root);
+/**
+* convert descendants of goNode to children of sgfNode.
+* line without branch is added to sgfNode as sequence, and each branch is converted later from stack.
+*/
+bool sgf::set(nodePtr& sgfNode, const go::nodePtr& goNode) const{
+    QVector< QPair<node*, go::node*> > stack;
+    stack.push_back( qMakePair(sgfNode.get(), goNode.get()) );
 
-    nodePtr gameInfo(new node());
-    gameInfo->set(info);
-    gameInfo->setNodeType(sgf::eGameInformation);
-    root->getChildNodes().push_back(gameInfo);
+    while (!stack.empty()){
+        node* sequence = stack.back().first;
+        go::node* n = stack.back().second;
+        stack.pop_back();
 
-    if (set(gameInfo, info) == false)
-        return false;
-    return true;
-}
+        while (n->childNodes().size() == 1){
+            nodePtr newNode(new node);
+            newNode->set( n->childNodes().front() );
+            sequence->getChildNodes().push_back(newNode);
+            n = n->childNodes().front().get();
+        }
+
+        if (n->childNodes().size() < 2)
+            continue;
 
-bool sgf::set(nodePtr& sgfNode, const go::nodePtr& goNode){
-    if (goNode->childNodes.size() > 1){
-        foreach(const go::nodePtr& inNode, goNode->childNodes){
+        foreach(const go::nodePtr& inNode, n->childNodes()){
             nodePtr branchNode(new node);
             branchNode->setNodeType(eBranch);
-            sgfNode->getChildNodes().push_back(branchNode);
+            sequence->getChildNodes().push_back(branchNode);
 
             nodePtr newNode(new node);
             newNode->set( inNode );
             branchNode->getChildNodes().push_back(newNode);
-            set(newNode, inNode);
+            stack.push_back( qMakePair(newNode.get(), inNode.get()) );
         }
     }
-    else if (goNode->childNodes.size() == 1){
-        nodePtr newNode(new node);
-        newNode->set( goNode->childNodes.front() );
-        sgfNode->getChildNodes().push_back(newNode);
-        set(sgfNode, goNode->childNodes.front());
-    }
 
     return true;
 }
 
-bool sgf::pointToInt(const QString& pos, int& x, int& y, QString* str){
+bool sgf::pointToInt(const QByteArray& pos, int& x, int& y, QByteArray* str){
     if (pos.size() < 2)
         return false;
-    x = pos[0].unicode() - (pos[0].isLower() ? L'a' : L'A' - 27);
-    y = pos[1].unicode() - (pos[1].isLower() ? L'a' : L'A' - 27);
+    x = pos[0] - (islower((unsigned char)pos[0]) ? 'a' : 'A' - 27);
+    y = pos[1] - (islower((unsigned char)pos[1]) ? 'a' : 'A' - 27);
 
     if (str && pos.size() > 3 && pos[2] == ':')
         *str = pos.mid(3);
@@ -778,28 +1768,27 @@ bool sgf::pointToInt(const QString& pos, int& x, int& y, QString* str){
     return true;
 }
 
-bool sgf::pointToIntList(const QString& pos, QList<int>& xList, QList<int>& yList){
-    QRegExp exp("(..):?(..)?");
-    exp.indexIn(pos);
-    QStringList list = exp.capturedTexts();
-
-    int x1, y1;
-    if (pointToInt(list[1], x1, y1) == false)
+/**
+* "aa" is a point, "aa:cc" (or "aacc") is a rectangle.
+* a point is returned as a rectangle of x1 == x2 and y1 == y2.
+*/
+bool sgf::pointToRect(const QByteArray& pos, int& x1, int& y1, int& x2, int& y2){
+    if (pointToInt(pos, x1, y1) == false)
         return false;
 
-    int x2, y2;
-    if (list[2].isEmpty() || pointToInt(list[2], x2, y2) == false){
-        xList.push_back(x1);
-        yList.push_back(y1);
+    const int p = pos.size() > 2 && pos[2] == ':' ? 3 : 2;
+    if (pos.size() < p + 2){
+        x2 = x1;
+        y2 = y1;
         return true;
     }
 
-    for (int y=y1; y<=y2; ++y){
-        for (int x=x1; x<=x2; ++x){
-            xList.push_back( x );
-            yList.push_back( y );
-        }
-    }
+    x2 = pos[p]   - (islower((unsigned char)pos[p])   ? 'a' : 'A' - 27);
+    y2 = pos[p+1] - (islower((unsigned char)pos[p+1]) ? 'a' : 'A' - 27);
+    if (x2 < x1)
+        qSwap(x1, x2);
+    if (y2 < y1)
+        qSwap(y1, y2);
 
     return true;
 }
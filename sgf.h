@@ -23,20 +23,55 @@
 namespace go{
 
 
+class sgfGameLoader;
+
 class sgf : public fileBase{
+    friend class sgfGameLoader;
+
 public:
     enum eNodeType{ eUnknown, eRoot, eGameInformation, eBranch, eBlack, eWhite };
 
+    /** lead bytes of double byte codecs, whose trail bytes may be '[', '\\' or ']'. */
+    enum eLeadBytes{ eNoLeadBytes, eShiftJisLeadBytes, eDoubleByteLeadBytes };
+
+    /** supported property. properties are written in this order. */
+    enum eProperty{
+        // game information
+        eGM, eFF, eCA, eAP, eSZ, eKM, eHA, eRU,
+        ePW, eWR, eWT, ePB, eBR, eBT, eRE, eTM, eOT,
+        eDT, eGN, eRO, ePC, eEV,
+        eGC, eON, eAN, eCP, eSO, eUS,
+
+        // stone
+        eB, eW, eMN, ePL,
+
+        // marker
+        eAE, eAB, eAW, eMA, eCR, eSQ, eTR, eSL, eLB, eTB, eTW, eDD,
+
+        // move annotation
+        eTE, eBM, eDO, eIT,
+
+        // node annotation
+        eC, eDM, eGB, eGW, eUC, eHO, eN,
+
+        // read only (old sgf and cyber oro)
+        eKO, eRD, eTC, eRN, eM, ePT,
+
+        eUnknownProperty
+    };
+
     class node;
     typedef boost::shared_ptr<node> nodePtr;
     typedef QLinkedList<nodePtr> nodeList;
     typedef QMap<QString, QStringList> propertyType;
+    typedef QList<QByteArray> valueList;
 
     class node{
         public:
             node() : nodeType(eUnknown){}
 
             QString toString() const;
+            void toString(QString& str) const;
 
             void clear(){
                 childNodes.clear();
@@ -54,16 +89,16 @@ public:
             const propertyType& getProperty() const{ return property; }
 
             bool get(go::nodePtr n) const;
-            bool get(go::nodePtr n, const QString& key, const QStringList& values) const;
+            static bool get(go::nodePtr n, eProperty id, const QByteArray& key, const valueList& values, QTextCodec* codec);
 
             bool set(const go::nodePtr n);
             bool set(const go::markList& markList);
             bool set(const go::stoneList& markList);
 
         private:
-            void addMark(go::markList& markList, const QStringList& values, const char* str=NULL) const;
-            void addMark(go::markList& markList, const QStringList& values, mark::eType type) const;
-            void addStone(go::stoneList& stoneList, const QString& key, const QStringList& values) const;
+            static void addMark(go::markList& markList, const valueList& values, QTextCodec* codec);
+            static void addMark(go::markList& markList, const valueList& values, mark::eType type);
+            static void addStone(go::stoneList& stoneList, go::color c, const valueList& values);
 
             nodeList childNodes;
             eNodeType nodeType;
@@ -74,32 +109,43 @@ public:
     sgf(){
     }
 
-    virtual bool readStream(QString::iterator& first, QString::iterator last);
+    virtual bool readBuffer(const QByteArray& bytes);
+    bool readStream(QString::iterator& first, QString::iterator last);
     virtual bool saveStream(QTextStream& stream);
     virtual QTextCodec* getCodec(const QByteArray&) const;
+    static int probe(const QByteArray& head);
 
     virtual bool get(go::data& data) const;
     virtual bool set(const go::data& data);
     virtual bool set(const go::informationPtr& info);
 
-    static bool pointToInt(const QString& pos, int& x, int& y, QString* str=NULL);
-    static bool pointToIntList(const QString& pos, QList<int>& x, QList<int>& y);
+    static QList<gameLoaderPtr> createLoaders(const fileBufferPtr& buffer, QTextCodec* codec, const QVector< QPair<int, int> >& ranges);
+
+    static eProperty propertyId(const char* key, int size);
+    static void writeProperties(QString& str, const go::node* n, QTextCodec* codec);
+
+    static bool pointToInt(const QByteArray& pos, int& x, int& y, QByteArray* str=NULL);
+    static bool pointToRect(const QByteArray& pos, int& x1, int& y1, int& x2, int& y2);
     static QString pointToString(int x, int y, const QString* s=NULL);
     static QString pointToString(const go::point& p, const QString* s=NULL);
 
 protected:
-    bool readBranch(QString::iterator& first, QString::iterator last, nodePtr n);
-    bool readNode(QString::iterator& first, QString::iterator last, nodePtr& n, int& pt);
-    bool readNodeKey(QString::iterator& first, QString::iterator last, QString& key);
-    bool readNodeValues(QString::iterator& first, QString::iterator last, QStringList& values);
-    bool readNodeValue(QString::iterator& first, QString::iterator last, QString& value);
+    bool readStream(const fileBufferPtr& buffer, QTextCodec* textCodec);
+    bool readStream(const char*& first, const char* last, QTextCodec* textCodec);
+    bool readHeader(const char*& first, const char* last, go::nodePtr info, QTextCodec* textCodec);
+    bool readBranch(const char*& first, const char* last, go::nodePtr parent, bool root, QTextCodec* textCodec);
+    int  readNode(const char*& first, const char* last, go::nodePtr n, int& pt, QTextCodec* textCodec);
+    bool readNodeKey(const char*& first, const char* last, QByteArray& key);
+    bool readNodeValues(const char*& first, const char* last, valueList& values, eLeadBytes leads);
+    bool readNodeValue(const char*& first, const char* last, QByteArray& value, eLeadBytes leads);
 
-    bool writeNode(QTextStream& stream, QString& s, const nodePtr& n);
+    bool writeNode(QTextStream& stream, QString& s, const go::nodePtr& n);
 
     go::nodePtr get(const nodePtr& sgfNode, go::nodePtr& goNode) const;
-    bool set(nodePtr& sgfNode, const go::nodePtr& goNode);
+    bool set(nodePtr& sgfNode, const go::nodePtr& goNode) const;
 
-    nodeList rootList;
+    go::informationList gameList;    // games read by readStream
+    go::informationList sourceList;  // games set by set()
 };
 
 
@@ -0,0 +1,578 @@
+/*
+    mugo, sgf editor.
+    Copyright (C) 2009-2010 nsase.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <algorithm>
+#include <QFileInfo>
+#include <QDir>
+#include <QDataStream>
+#include <QTemporaryFile>
+#include <QCryptographicHash>
+#include <QDesktopServices>
+#include "appdef.h"
+#include "snapshot.h"
+#include "sgf.h"
+
+namespace go{
+
+
+static const quint32 snapshotMagic   = 0x4d475353;  // "MGSS"
+static const quint32 snapshotVersion = 3;
+
+/**
+* string fields of game information, saved as indexes of string table.
+*/
+static QString informationNode::* const informationStrings[] = {
+    &informationNode::time,
+    &informationNode::overTime,
+    &informationNode::whitePlayer,
+    &informationNode::whiteRank,
+    &informationNode::whiteTeam,
+    &informationNode::blackPlayer,
+    &informationNode::blackRank,
+    &informationNode::blackTeam,
+    &informationNode::result,
+    &informationNode::gameName,
+    &informationNode::date,
+    &informationNode::round,
+    &informationNode::place,
+    &informationNode::event,
+    &informationNode::rule,
+    &informationNode::annotation,
+    &informationNode::source,
+    &informationNode::gameComment,
+    &informationNode::copyright,
+    &informationNode::user,
+    &informationNode::opening,
+};
+static const int informationStringCount = sizeof(informationStrings) / sizeof(informationStrings[0]);
+
+
+/**
+* snapshot file mapped to memory.
+* it is shared by games, which parse their trees from it.
+*/
+class snapshotFile{
+public:
+    snapshotFile() : map(NULL){}
+    ~snapshotFile(){
+        if (map)
+            file.unmap(map);
+    }
+
+    bool open(const QString& fname){
+        file.setFileName(fname);
+        if (!file.open(QIODevice::ReadOnly))
+            return false;
+
+        map = file.map(0, file.size());
+        if (map)
+            bytes = QByteArray::fromRawData(reinterpret_cast<const char*>(map), file.size());
+        else
+            bytes = file.readAll();
+
+        return !bytes.isEmpty();
+    }
+
+    QFile file;
+    uchar* map;
+    QByteArray bytes;
+    loadedGameList loadedGames;
+
+private:
+    Q_DISABLE_COPY(snapshotFile)
+};
+typedef boost::shared_ptr<snapshotFile> snapshotFilePtr;
+
+
+static void writeMarks(QDataStream& out, const markList& marks){
+    out << quint32(marks.size());
+    foreach(const mark& m, marks){
+        out << qint8(m.p.x) << qint8(m.p.y) << quint8(m.t);
+        if (m.t == mark::eCharacter)
+            out << m.s;
+    }
+}
+
+static void readMarks(QDataStream& in, markList& marks){
+    quint32 n;
+    in >> n;
+    for (quint32 i=0; i<n && in.status() == QDataStream::Ok; ++i){
+        qint8 x, y;
+        quint8 t;
+        in >> x >> y >> t;
+        if (t == mark::eCharacter){
+            QString s;
+            in >> s;
+            marks.push_back( mark(x, y, s) );
+        }
+        else
+            marks.push_back( mark(x, y, mark::eType(t)) );
+    }
+}
+
+static void writeStones(QDataStream& out, const stoneList& stones){
+    out << quint32(stones.size());
+    foreach(const stone& s, stones)
+        out << qint8(s.p.x) << qint8(s.p.y);
+}
+
+static void readStones(QDataStream& in, stoneList& stones, color c){
+    quint32 n;
+    in >> n;
+    for (quint32 i=0; i<n && in.status() == QDataStream::Ok; ++i){
+        qint8 x, y;
+        in >> x >> y;
+        stones.push_back( stone(x, y, c) );
+    }
+}
+
+/**
+* write node with packed move, and its rare properties if it has.
+*/
+void writeNode(QDataStream& out, const node* n){
+    out << n->position_ << quint8(n->color) << quint8(n->nextColor)
+        << quint8(n->annotation()) << quint8(n->moveAnnotation()) << quint8(n->nodeAnnotation()) << quint8(n->flags)
+        << qint32(n->moveNumber) << quint32(n->childNodes().size());
+
+    if (!n->hasProperty())
+        return;
+
+    const nodeProperty* p = n->property();
+    out << p->name << p->comment;
+    writeMarks(out, p->marks);
+    writeMarks(out, p->blackTerritories);
+    writeMarks(out, p->whiteTerritories);
+    writeMarks(out, p->dims);
+    writeStones(out, p->blackStones);
+    writeStones(out, p->whiteStones);
+    writeStones(out, p->emptyStones);
+
+    // unknown properties are raw bytes, so codec of them is written with them.
+    out << quint32(p->unknownProperties.size());
+    if (p->unknownProperties.empty())
+        return;
+
+    QTextCodec* codec = n->information()->propertyCodec;
+    out << (codec ? codec->name() : QByteArray());
+    foreach(const propertyList::value_type& prop, p->unknownProperties)
+        out << prop.first << prop.second;
+}
+
+/**
+* read node written by writeNode, and returns number of its children.
+*/
+quint32 readNode(QDataStream& in, node* n){
+    quint8 c, nextColor, annotation, moveAnnotation, nodeAnnotation, flags;
+    qint32 moveNumber;
+    quint32 children;
+    in >> n->position_ >> c >> nextColor
+       >> annotation >> moveAnnotation >> nodeAnnotation >> flags
+       >> moveNumber >> children;
+
+    n->setColor( go::color(c) );
+    n->nextColor = go::color(nextColor);
+    n->moveNumber = moveNumber;
+
+    // annotations are kept in rare properties, so they are set only if node has them.
+    if (annotation)
+        n->setAnnotation(annotation);
+    if (moveAnnotation)
+        n->setMoveAnnotation(moveAnnotation);
+    if (nodeAnnotation)
+        n->setNodeAnnotation(nodeAnnotation);
+
+    if ((flags & node::eHasProperty) == 0 || in.status() != QDataStream::Ok)
+        return children;
+
+    nodeProperty* p = n->editProperty();
+    in >> p->name >> p->comment;
+    readMarks(in, p->marks);
+    readMarks(in, p->blackTerritories);
+    readMarks(in, p->whiteTerritories);
+    readMarks(in, p->dims);
+    readStones(in, p->blackStones, black);
+    readStones(in, p->whiteStones, white);
+    readStones(in, p->emptyStones, empty);
+
+    quint32 count;
+    in >> count;
+    if (count == 0 || in.status() != QDataStream::Ok)
+        return children;
+
+    QByteArray name;
+    in >> name;
+    if (!name.isEmpty())
+        n->information()->propertyCodec = QTextCodec::codecForName(name);
+    for (quint32 i=0; i<count && in.status() == QDataStream::Ok; ++i){
+        propertyList::value_type prop;
+        in >> prop.first >> prop.second;
+        p->unknownProperties.push_back(prop);
+    }
+
+    return children;
+}
+
+/**
+* write tree in pre-order. each node is followed by its children.
+*/
+void writeTree(QDataStream& out, const node* root){
+    QVector<const node*> stack;
+    stack.push_back(root);
+    while (!stack.empty()){
+        const node* n = stack.back();
+        stack.pop_back();
+
+        writeNode(out, n);
+        int top = stack.size();
+        for (childList::iterator iter=n->childNodes().begin(); iter!=n->childNodes().end(); ++iter)
+            stack.push_back( (*iter).get() );
+        std::reverse(stack.begin() + top, stack.end());
+    }
+}
+
+/**
+* read tree written by writeTree to root, which is created by caller.
+*/
+bool readTree(QDataStream& in, node* root){
+    QVector< QPair<node*, quint32> > stack;  // node, and number of its children not read yet
+    stack.push_back( qMakePair(root, readNode(in, root)) );
+    while (!stack.empty() && in.status() == QDataStream::Ok){
+        if (stack.back().second == 0){
+            stack.pop_back();
+            continue;
+        }
+        --stack.back().second;
+
+        nodePtr parent( stack.back().first );
+        nodePtr child = createNode(parent);
+        parent->childNodes().push_back(child);
+        stack.push_back( qMakePair(child.get(), readNode(in, child.get())) );
+    }
+
+    return in.status() == QDataStream::Ok;
+}
+
+/**
+* write game information with its strings, not by string table.
+*/
+void writeInformation(QDataStream& out, const informationNode* info){
+    out << qint32(info->xsize) << qint32(info->ysize) << info->komi << qint32(info->handicap);
+    for (int i=0; i<informationStringCount; ++i)
+        out << (*info).*informationStrings[i];
+}
+
+bool readInformation(QDataStream& in, informationNode* info){
+    qint32 xsize, ysize, handicap;
+    in >> xsize >> ysize >> info->komi >> handicap;
+    info->xsize    = xsize;
+    info->ysize    = ysize;
+    info->handicap = handicap;
+    for (int i=0; i<informationStringCount; ++i)
+        in >> (*info).*informationStrings[i];
+
+    return in.status() == QDataStream::Ok;
+}
+
+
+/**
+* tree of one game in snapshot file.
+* original bytes of game are copied by loader of source file.
+*/
+class snapshotGameLoader : public gameLoader{
+public:
+    snapshotGameLoader(const snapshotFilePtr& file_, int offset_, int size_, const gameLoaderPtr& sourceLoader_)
+        : file(file_), offset(offset_), size(size_), sourceLoader(sourceLoader_){}
+
+    virtual bool parse(informationNode* info) const{
+        QDataStream in( QByteArray::fromRawData(file->bytes.constData() + offset, size) );
+        in.setVersion(QDataStream::Qt_4_5);
+        return readTree(in, info);
+    }
+
+    virtual void loaded(informationNode* info){
+        file->loadedGames.loaded(info);
+    }
+
+    virtual bool canCopy(QTextCodec* codec) const{
+        return sourceLoader && sourceLoader->canCopy(codec);
+    }
+
+    virtual bool copy(QIODevice* device, QTextCodec* codec) const{
+        return sourceLoader && sourceLoader->copy(device, codec);
+    }
+
+    virtual fileBufferPtr source(int& first, int& last) const{
+        return sourceLoader ? sourceLoader->source(first, last) : fileBufferPtr();
+    }
+
+    virtual void destroyed(informationNode* info){
+        file->loadedGames.remove(info);
+    }
+
+private:
+    snapshotFilePtr file;
+    int offset;
+    int size;
+    gameLoaderPtr sourceLoader;  // NULL if game can't be copied
+};
+
+
+static QByteArray codecName(QTextCodec* codec){
+    return codec ? codec->name() : QByteArray();
+}
+
+/**
+* hash of file contents, to check source file is not changed.
+*/
+static QByteArray contentHash(const fileBuffer& buffer){
+    return buffer.isOpen() ? QCryptographicHash::hash(buffer.bytes, QCryptographicHash::Md5) : QByteArray();
+}
+
+/**
+* remove snapshots of missing files or older versions, unfinished temporary files,
+* and least recently saved snapshots over SNAPSHOT_CACHE_FILES.
+*/
+static void pruneCache(const QString& dir){
+    QDir d(dir);
+    QFileInfoList files = d.entryInfoList(QStringList() << "*.snapshot", QDir::Files, QDir::Time);
+    for (int i=0; i<files.size(); ++i){
+        bool stale = i >= SNAPSHOT_CACHE_FILES;
+        if (!stale){
+            QFile f( files[i].absoluteFilePath() );
+            if (!f.open(QIODevice::ReadOnly))
+                continue;
+
+            QDataStream in(&f);
+            in.setVersion(QDataStream::Qt_4_5);
+            quint32 magic, version;
+            QString path;
+            in >> magic >> version;
+            if (in.status() == QDataStream::Ok && magic == snapshotMagic && version == snapshotVersion)
+                in >> path;
+            stale = in.status() != QDataStream::Ok || magic != snapshotMagic || version != snapshotVersion || !QFile::exists(path);
+        }
+        if (stale)
+            d.remove( files[i].fileName() );
+    }
+
+    // temporary files left by crash. files written now are newer.
+    QDateTime old = QDateTime::currentDateTime().addSecs(-24 * 60 * 60);
+    foreach(const QFileInfo& fi, d.entryInfoList(QStringList() << "*.snapshot.*", QDir::Files)){
+        if (fi.lastModified() < old)
+            d.remove( fi.fileName() );
+    }
+}
+
+QString snapshot::cacheFileName(const QString& fname){
+    QString dir = QDesktopServices::storageLocation(QDesktopServices::CacheLocation);
+    if (dir.isEmpty())
+        return QString();
+
+    QByteArray key = QCryptographicHash::hash(QFileInfo(fname).absoluteFilePath().toUtf8(), QCryptographicHash::Md5);
+    return dir + "/snapshot/" + QString::fromLatin1(key.toHex()) + ".snapshot";
+}
+
+/**
+* read snapshot of fname.
+* returns false if there is no snapshot, or source file is changed after snapshot is saved.
+* game trees are read lazily from mapped snapshot.
+*/
+bool snapshot::read(const QString& fname, QTextCodec* codec, bool guessCodec){
+    QFileInfo fi(fname);
+    if (fi.size() < minimumFileSize)
+        return false;
+
+    QString cacheName = cacheFileName(fname);
+    snapshotFilePtr file(new snapshotFile);
+    if (cacheName.isEmpty() || !file->open(cacheName))
+        return false;
+
+    QDataStream in(file->bytes);
+    in.setVersion(QDataStream::Qt_4_5);
+
+    quint32 magic, version;
+    in >> magic >> version;
+    if (in.status() != QDataStream::Ok || magic != snapshotMagic || version != snapshotVersion)
+        return false;
+
+    QString path;
+    qint64 size;
+    quint32 modified;
+    QByteArray hash;
+    bool guessed;
+    QByteArray requestedName, name;
+    in >> path >> size >> modified >> hash >> guessed >> requestedName >> name;
+    if (in.status() != QDataStream::Ok || path != fi.absoluteFilePath() || size != fi.size() ||
+        modified != fi.lastModified().toTime_t() || guessed != guessCodec || requestedName != codecName(codec))
+        return false;
+
+    // source is kept to copy original bytes of games when they are saved.
+    fileBufferPtr source(new fileBuffer(fname));
+    if (hash != contentHash(*source))
+        return false;
+
+    QStringList strings;
+    quint32 count;
+    in >> strings >> count;
+
+    informationList infos;
+    QVector< QPair<quint32, quint32> > trees;
+    QVector< QPair<int, int> > ranges;
+    for (quint32 i=0; i<count && in.status() == QDataStream::Ok; ++i){
+        informationPtr info(new informationNode);
+        qint32 xsize, ysize, handicap;
+        in >> xsize >> ysize >> info->komi >> handicap;
+        info->xsize = xsize;
+        info->ysize = ysize;
+        info->handicap = handicap;
+
+        for (int j=0; j<informationStringCount; ++j){
+            quint32 index;
+            in >> index;
+            if (index >= quint32(strings.size()))
+                return false;
+            (*info).*informationStrings[j] = strings[index];
+        }
+
+        quint32 offset, treeSize;
+        qint32 sourceFirst, sourceLast;
+        in >> offset >> treeSize >> sourceFirst >> sourceLast;
+        trees.push_back( qMakePair(offset, treeSize) );
+        ranges.push_back( qMakePair(int(sourceFirst), int(sourceLast)) );
+        infos.push_back(info);
+    }
+
+    quint32 treesSize;
+    in >> treesSize;
+    if (in.status() != QDataStream::Ok || infos.size() != int(count))
+        return false;
+
+    qint64 base = in.device()->pos();
+    if (base + treesSize > file->bytes.size())
+        return false;
+
+    this->codec = QTextCodec::codecForName(name);
+    QList<gameLoaderPtr> sourceLoaders = sgf::createLoaders(source, this->codec, ranges);
+
+    for (int i=0; i<infos.size(); ++i){
+        if (qint64(trees[i].first) + trees[i].second > treesSize)
+            return false;
+        infos[i]->loader.reset( new snapshotGameLoader(file, base + trees[i].first, trees[i].second, sourceLoaders[i]) );
+        infos[i]->loaded = false;
+    }
+
+    gameList = infos;
+
+    return !gameList.empty();
+}
+
+/**
+* save snapshot of games read from fname by codec.
+* nothing is saved for small file, which is read fast enough.
+*/
+bool snapshot::save(const QString& fname, QTextCodec* codec){
+    QFileInfo fi(fname);
+    QString cacheName = cacheFileName(fname);
+    if (fi.size() < minimumFileSize || cacheName.isEmpty())
+        return false;
+
+    // headers and trees are written to buffers first, to build string table and offsets of trees.
+    QHash<QString, quint32> stringIndex;
+    QStringList strings;
+    QByteArray headers;
+    QByteArray treeBytes;
+    QDataStream headerStream(&headers, QIODevice::WriteOnly);
+    QDataStream treeStream(&treeBytes, QIODevice::WriteOnly);
+    headerStream.setVersion(QDataStream::Qt_4_5);
+    treeStream.setVersion(QDataStream::Qt_4_5);
+
+    // range of game in source is saved if game is read from source file as it is.
+    fileBuffer source(fname);
+    QString sourcePath = fi.absoluteFilePath();
+
+    // games which are not loaded are parsed to temporary nodes in parallel.
+    for (int first=0; first<gameList.size(); first+=PARSE_GAMES_AT_ONCE){
+        informationList games = gameList.mid(first, PARSE_GAMES_AT_ONCE);
+        informationList trees = parseGames(games);
+        for (int j=0; j<games.size(); ++j){
+            const informationPtr& game = trees[j];
+            if (!game)
+                return false;
+
+            headerStream << qint32(game->xsize) << qint32(game->ysize) << game->komi << qint32(game->handicap);
+            for (int i=0; i<informationStringCount; ++i){
+                const QString& s = (*game).*informationStrings[i];
+                QHash<QString, quint32>::const_iterator iter = stringIndex.find(s);
+                if (iter == stringIndex.end()){
+                    iter = stringIndex.insert(s, strings.size());
+                    strings.push_back(s);
+                }
+                headerStream << iter.value();
+            }
+
+            quint32 offset = treeBytes.size();
+            writeTree(treeStream, game.get());
+            headerStream << offset << quint32(treeBytes.size() - offset);
+
+            int sourceFirst = 0, sourceLast = 0;
+            fileBufferPtr buffer = games[j]->loader && !games[j]->dirty ? games[j]->loader->source(sourceFirst, sourceLast) : fileBufferPtr();
+            if (!buffer || !buffer->isIntact() || buffer->fileName().isEmpty() || QFileInfo(buffer->fileName()).absoluteFilePath() != sourcePath)
+                sourceFirst = sourceLast = 0;
+            headerStream << qint32(sourceFirst) << qint32(sourceLast);
+        }
+    }
+
+    QDir().mkpath( QFileInfo(cacheName).absolutePath() );
+    QTemporaryFile f(cacheName + ".XXXXXX");
+    if (!f.open())
+        return false;
+
+    QDataStream out(&f);
+    out.setVersion(QDataStream::Qt_4_5);
+    out << snapshotMagic << snapshotVersion
+        << sourcePath << fi.size() << quint32(fi.lastModified().toTime_t()) << contentHash(source)
+        << guessCodec << codecName(requestedCodec) << codecName(codec)
+        << strings << quint32(gameList.size());
+    out.writeRawData(headers.constData(), headers.size());
+    out << quint32(treeBytes.size());
+    out.writeRawData(treeBytes.constData(), treeBytes.size());
+
+    if (out.status() != QDataStream::Ok || f.error() != QFile::NoError)
+        return false;
+
+    f.close();
+    if (!replaceFile(f.fileName(), cacheName))
+        return false;
+
+    pruneCache( QFileInfo(cacheName).absolutePath() );
+    return true;
+}
+
+bool snapshot::get(go::data& data) const{
+    data.clear();
+    data.rootList = gameList;
+    data.root = data.rootList.front();
+    return true;
+}
+
+bool snapshot::set(const go::data& data){
+    gameList = data.rootList;
+    return true;
+}
+
+
+}
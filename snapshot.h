@@ -0,0 +1,68 @@
+/*
+    mugo, sgf editor.
+    Copyright (C) 2009-2010 nsase.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __snapshot_h__
+#define __snapshot_h__
+
+#include <QDataStream>
+#include "godata.h"
+
+namespace go{
+
+
+/**
+* binary snapshot of games read from large file.
+* it is kept in cache directory of user, and read instead of source file
+* while source file is not changed.
+*/
+class snapshot : public fileBase{
+public:
+    enum{ minimumFileSize = 1024 * 1024 };
+
+    snapshot() : guessCodec(true), requestedCodec(NULL){}
+
+    virtual bool read(const QString& fname, QTextCodec* codec, bool guessCodec);
+
+    virtual bool save(const QString& fname, QTextCodec* codec);
+    virtual bool saveStream(QTextStream& /*stream*/){ return false; }
+
+    virtual bool get(go::data& data) const;
+    virtual bool set(const go::data& data);
+
+    static QString cacheFileName(const QString& fname);
+
+    // how source file was read, saved to snapshot as part of its key.
+    bool guessCodec;
+    QTextCodec* requestedCodec;
+
+private:
+    informationList gameList;
+};
+
+
+// binary form of nodes and games, shared with edit journal.
+void writeNode(QDataStream& out, const node* n);
+quint32 readNode(QDataStream& in, node* n);
+void writeTree(QDataStream& out, const node* root);
+bool readTree(QDataStream& in, node* root);
+void writeInformation(QDataStream& out, const informationNode* info);
+bool readInformation(QDataStream& in, informationNode* info);
+
+
+}
+
+#endif
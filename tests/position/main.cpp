@@ -0,0 +1,226 @@
+/*
+    mugo, sgf editor.
+    Copyright (C) 2009-2010 nsase.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <QVector>
+#include "position.h"
+
+/**
+* test of go::position.
+* plays random games with setup stones on random board sizes, and compares
+* stones, captures, suicide and atari with flood fill of each chain.
+* prints number of moves and exits with 1 at first difference.
+*/
+
+static const int testGames = 1000;
+static const int testMoves = 300;
+static const int setupRate = 20;  // 1 of this is setup stone
+
+
+/**
+* board which finds chains by flood fill, as board widget did before position.
+*/
+class floodFillBoard{
+public:
+    floodFillBoard(int xsize, int ysize) : xsize(xsize), ysize(ysize), colors(xsize * ysize, go::empty){}
+
+    go::color at(int p) const{ return colors[p]; }
+    void setStone(int p, go::color c){ colors[p] = c; }
+
+    /**
+    * stones of chain at p, and number of its liberties.
+    */
+    int chain(int p, QVector<int>& stones) const{
+        QVector<bool> visited(colors.size(), false);
+        QVector<int> stack;
+        int liberties = 0;
+        stones.clear();
+        stack.push_back(p);
+        visited[p] = true;
+        while (!stack.empty()){
+            int q = stack.back();
+            stack.pop_back();
+            stones.push_back(q);
+
+            int n[4];
+            int count = neighbors(q, n);
+            for (int i=0; i<count; ++i){
+                if (visited[n[i]])
+                    continue;
+                if (colors[n[i]] == go::empty){
+                    visited[n[i]] = true;
+                    ++liberties;
+                }
+                else if (colors[n[i]] == colors[p]){
+                    visited[n[i]] = true;
+                    stack.push_back(n[i]);
+                }
+            }
+        }
+        return liberties;
+    }
+
+    /**
+    * play move at p, and returns captured stones.
+    */
+    QVector<int> play(int p, go::color c){
+        QVector<int> captured, stones;
+        colors[p] = c;
+
+        go::color opponent = c == go::black ? go::white : go::black;
+        int n[4];
+        int count = neighbors(p, n);
+        for (int i=0; i<count; ++i){
+            if (colors[n[i]] == opponent && chain(n[i], stones) == 0)
+                remove(stones, captured);
+        }
+        if (chain(p, stones) == 0)
+            remove(stones, captured);
+
+        return captured;
+    }
+
+    bool isSuicide(int p, go::color c){
+        floodFillBoard board(*this);
+        return board.play(p, c).contains(p);
+    }
+
+    /**
+    * number of liberties of chain of each stone, 0 for empty point.
+    */
+    QVector<int> liberties() const{
+        QVector<int> result(colors.size(), 0), stones;
+        for (int p=0; p<colors.size(); ++p){
+            if (colors[p] == go::empty || result[p] > 0)
+                continue;
+            int n = chain(p, stones);
+            foreach(int q, stones)
+                result[q] = n;
+        }
+        return result;
+    }
+
+private:
+    int neighbors(int p, int* n) const{
+        int x = p % xsize, y = p / xsize, count = 0;
+        if (y > 0)
+            n[count++] = p - xsize;
+        if (y < ysize - 1)
+            n[count++] = p + xsize;
+        if (x > 0)
+            n[count++] = p - 1;
+        if (x < xsize - 1)
+            n[count++] = p + 1;
+        return count;
+    }
+
+    void remove(const QVector<int>& stones, QVector<int>& captured){
+        foreach(int p, stones){
+            colors[p] = go::empty;
+            captured.push_back(p);
+        }
+    }
+
+    int xsize;
+    int ysize;
+    QVector<go::color> colors;
+};
+
+/**
+* returns true if captured points of position are same as stones of board.
+*/
+static bool sameCaptures(const QVector<go::point>& captured, QVector<int> stones, int xsize){
+    if (captured.size() != stones.size())
+        return false;
+
+    foreach(const go::point& p, captured){
+        int i = stones.indexOf(p.y * xsize + p.x);
+        if (i < 0)
+            return false;
+        stones.remove(i);
+    }
+    return true;
+}
+
+/**
+* returns true if stones and atari of all chains are same.
+*/
+static bool samePosition(go::position& pos, const floodFillBoard& board){
+    QVector<int> liberties = board.liberties();
+    for (int y=0; y<pos.ysize(); ++y){
+        for (int x=0; x<pos.xsize(); ++x){
+            int p = y * pos.xsize() + x;
+            if (pos.at(x, y) != board.at(p))
+                return false;
+            if (board.at(p) != go::empty && pos.isAtari(x, y) != (liberties[p] == 1))
+                return false;
+        }
+    }
+    return true;
+}
+
+int main(int /*argc*/, char* /*argv*/[]){
+    srand(1);
+    long moves = 0, captures = 0;
+
+    for (int game=0; game<testGames; ++game){
+        // every 10th board is larger than bit planes, and its groups are kept by union-find.
+        int xsize = game % 10 == 9 ? go::bitboard::maxSize + 1 + rand() % 8 : 2 + rand() % 18;
+        int ysize = 2 + rand() % 18;
+        floodFillBoard board(xsize, ysize);
+        go::position pos;
+        pos.clear(xsize, ysize);
+
+        for (int move=0; move<testMoves; ++move){
+            int x = rand() % xsize;
+            int y = rand() % ysize;
+            int p = y * xsize + x;
+
+            if (rand() % setupRate == 0){
+                go::color c = go::color(rand() % 3);
+                board.setStone(p, c);
+                pos.setStone(x, y, c);
+            }
+            else{
+                go::color c = rand() % 2 ? go::black : go::white;
+                if (board.at(p) == go::empty && pos.isSuicide(x, y, c) != board.isSuicide(p, c)){
+                    printf("suicide differs at game %d move %d\n", game, move);
+                    return 1;
+                }
+
+                QVector<go::point> captured;
+                pos.play(x, y, c, &captured);
+                QVector<int> stones = board.play(p, c);
+                if (!sameCaptures(captured, stones, xsize)){
+                    printf("captures differ at game %d move %d\n", game, move);
+                    return 1;
+                }
+                ++moves;
+                captures += stones.size();
+            }
+
+            if (!samePosition(pos, board)){
+                printf("position differs at game %d move %d\n", game, move);
+                return 1;
+            }
+        }
+    }
+
+    printf("ok %ld moves, %ld captured stones\n", moves, captures);
+    return 0;
+}
@@ -0,0 +1,12 @@
+# -------------------------------------------------
+# test of go::position against flood fill.
+# -------------------------------------------------
+TARGET = position
+TEMPLATE = app
+QT -= gui
+CONFIG += console
+mac:CONFIG -= app_bundle
+INCLUDEPATH += ../..
+SOURCES += main.cpp \
+    ../../position.cpp \
+    ../../bitboard.cpp
@@ -21,22 +21,22 @@
 
 namespace go{
 
-bool ugf::readStream(QString::iterator& first, QString::iterator last){
+bool ugf::readText(textReader& reader){
     dataList_.push_back( data() );
-    while (first != last){
-        QString s = readLine(first, last);
+    while (!reader.atEnd()){
+        QString s = reader.readLine();
         if (s == "[Header]")
-            readHeader(first, last);
+            readHeader(reader);
         else if (s == "[Remote]")
-            readRemote(first, last);
+            readRemote(reader);
         else if (s == "[Files]")
-            readFiles(first, last);
+            readFiles(reader);
         else if (s == "[Data]")
-            readData(first, last);
+            readData(reader);
         else if (s == "[Figure]")
-            readFigure(first, last);
+            readFigure(reader);
         else if (s == "[Comment]")
-            readComment(first, last);
+            readComment(reader);
     }
 
     return true;
@@ -46,6 +46,18 @@ bool ugf::saveStream(QTextStream& /*stream*/){
     return false;
 }
 
+/**
+* returns confidence (0-100) that head of file is ugf.
+*/
+int ugf::probe(const QByteArray& head){
+    if (head.mid(headStart(head), 8) == "[Header]")
+        return 100;
+    else if (head.contains("\n[Header]"))
+        return 60;
+    else
+        return 0;
+}
+
 QTextCodec* ugf::getCodec(const QByteArray& a) const{
     int s = a.indexOf("\nLang=");
     if (s == -1)
@@ -79,21 +91,21 @@ bool ugf::get(go::data& data) const{
     data.root->blackRank = blackRank;
 
     dataList::const_iterator first = dataList_.begin();
-    data.root->comment = first->comment;
+    data.root->setComment( first->comment );
     markerList::const_iterator marker = first->markers.begin();
     while (marker != first->markers.end()){
-        data.root->marks.push_back( go::mark(marker->x, marker->y, marker->str) );
+        data.root->editMarks().push_back( go::mark(marker->x, marker->y, marker->str) );
         ++marker;
     }
 
     stoneList::const_iterator stone = first->stones.begin();
     while (stone != first->stones.end()){
         if (stone->color == go::empty)
-            data.root->emptyStones.push_back( go::stone(stone->x, stone->y, go::empty) );
+            data.root->editEmptyStones().push_back( go::stone(stone->x, stone->y, go::empty) );
         else if (stone->color == go::black)
-            data.root->blackStones.push_back( go::stone(stone->x, stone->y, go::black) );
+            data.root->editBlackStones().push_back( go::stone(stone->x, stone->y, go::black) );
         else if (stone->color == go::white)
-            data.root->whiteStones.push_back( go::stone(stone->x, stone->y, go::white) );
+            data.root->editWhiteStones().push_back( go::stone(stone->x, stone->y, go::white) );
         ++stone;
     }
 
@@ -104,9 +116,9 @@ bool ugf::set(const go::data& /*data*/){
     return false;
 }
 
-bool ugf::readHeader(QString::iterator& first, QString::iterator& last){
-    while (first != last && *first != '['){
-        QString str = readLine(first, last);
+bool ugf::readHeader(textReader& reader){
+    while (!reader.atEnd() && reader.peek() != '['){
+        QString str = reader.readLine();
 
         int pos = str.indexOf('=');
         if (pos == -1)
@@ -170,25 +182,25 @@ bool ugf::readHeader(QString::iterator& first, QString::iterator& last){
     return true;
 }
 
-bool ugf::readRemote(QString::iterator& first, QString::iterator& last){
-    while (first != last && *first != '['){
-        QString str = readLine(first, last);
+bool ugf::readRemote(textReader& reader){
+    while (!reader.atEnd() && reader.peek() != '['){
+        QString str = reader.readLine();
     }
 
     return false;
 }
 
-bool ugf::readFiles(QString::iterator& first, QString::iterator& last){
-    while (first != last && *first != '['){
-        QString str = readLine(first, last);
+bool ugf::readFiles(textReader& reader){
+    while (!reader.atEnd() && reader.peek() != '['){
+        QString str = reader.readLine();
     }
 
     return false;
 }
 
-bool ugf::readData(QString::iterator& first, QString::iterator& last){
-    while (first != last && *first != '['){
-        QString str = readLine(first, last);
+bool ugf::readData(textReader& reader){
+    while (!reader.atEnd() && reader.peek() != '['){
+        QString str = reader.readLine();
 
         QStringList list = str.split(',');
         if (list.size() != 4)
@@ -210,39 +222,39 @@ bool ugf::readData(QString::iterator& first, QString::iterator& last){
     return true;
 }
 
-bool ugf::readFigure(QString::iterator& first, QString::iterator& last){
-    while (first != last && *first != '['){
-        QString str = readLine(first, last);
+bool ugf::readFigure(textReader& reader){
+    while (!reader.atEnd() && reader.peek() != '['){
+        QString str = reader.readLine();
 
         QStringList list =  str.split(',');
         if (list.size() < 2)
             continue;
 
         if (list[0] == ".Fig")
-            readFig(first, last, list[1].toInt());
+            readFig(reader, list[1].toInt());
         else if (list[0] == ".Text")
-            readText(first, last, list[1].toInt());
+            readText(reader, list[1].toInt());
     }
 
     return false;
 }
 
-bool ugf::readComment(QString::iterator& first, QString::iterator& last){
-    while (first != last && *first != '['){
-        QString str = readLine(first, last);
+bool ugf::readComment(textReader& reader){
+    while (!reader.atEnd() && reader.peek() != '['){
+        QString str = reader.readLine();
 
         QStringList list =  str.split(',');
         if (list.size() < 2)
             continue;
 
         if (list[0] == ".Fig")
-            readFig(first, last, list[1].toInt());
+            readFig(reader, list[1].toInt());
     }
 
     return true;
 }
 
-bool ugf::readFig(QString::iterator& first, QString::iterator& last, int index){
+bool ugf::readFig(textReader& reader, int index){
     data addEmpty;
     dataList::iterator iter = dataList_.begin();
     while (iter != dataList_.end()){
@@ -260,13 +272,13 @@ bool ugf::readFig(QString::iterator& first, QString::iterator& last, int index){
     dataList branch;
     branch.push_back(addEmpty);
 
-    while (first != last && *first != '['){
-        QString str = readLine(first, last);
+    while (!reader.atEnd() && reader.peek() != '['){
+        QString str = reader.readLine();
         if (str == ".EndFig")
             break;
 
         if (str == ".Text"){
-            readText(first, last, index);
+            readText(reader, index);
         }
         else{
             QStringList list =  str.split(',');
@@ -290,13 +302,13 @@ bool ugf::readFig(QString::iterator& first, QString::iterator& last, int index){
     return true;
 }
 
-bool ugf::readText(QString::iterator& first, QString::iterator& last, int index){
+bool ugf::readText(textReader& reader, int index){
     data* d = getNthData(index);
     if (d == NULL)
         return false;
 
-    while (first != last && *first != '['){
-        QString str = readLine(first, last);
+    while (!reader.atEnd() && reader.peek() != '['){
+        QString str = reader.readLine();
         if (!str.isEmpty() && str[0] == '.'){
             if (str == ".EndText")
                 break;
@@ -333,46 +345,58 @@ void ugf::replaceStone(stoneList& stones, const data& d){
     }
 }
 
+/**
+* append moves to parent as one line, and their branches.
+* branches are kept in stack, and added to their node after main line of it.
+*/
 bool ugf::get(dataList::const_iterator first, dataList::const_iterator last, go::nodePtr parent) const{
-    if (first == last)
-        return true;
-
-    nodePtr node;
-    if (first->color == go::black)
-        node = go::createBlackNode(parent, first->x, first->y);
-    else if (first->color == go::white)
-        node = go::createWhiteNode(parent, first->x, first->y);
-    else
-        node.reset(new go::node(parent));
+    QVector< QPair<go::nodePtr, const dataList*> > branches;
+
+    for (;;){
+        for (; first != last; ++first){
+            nodePtr node;
+            if (first->color == go::black)
+                node = go::createBlackNode(parent, first->x, first->y);
+            else if (first->color == go::white)
+                node = go::createWhiteNode(parent, first->x, first->y);
+            else
+                node = go::createNode(parent);
 
-    node->comment = first->comment;
+            if (!first->comment.isEmpty())
+                node->setComment( first->comment );
 
-    markerList::const_iterator marker = first->markers.begin();
-    while (marker != first->markers.end()){
-        node->marks.push_back( go::mark(marker->x, marker->y, marker->str) );
-        ++marker;
-    }
+            markerList::const_iterator marker = first->markers.begin();
+            while (marker != first->markers.end()){
+                node->editMarks().push_back( go::mark(marker->x, marker->y, marker->str) );
+                ++marker;
+            }
 
-    stoneList::const_iterator stone = first->stones.begin();
-    while (stone != first->stones.end()){
-        if (stone->color == go::empty)
-            node->emptyStones.push_back( go::stone(stone->x, stone->y, go::empty) );
-        else if (stone->color == go::black)
-            node->blackStones.push_back( go::stone(stone->x, stone->y, go::black) );
-        else if (stone->color == go::white)
-            node->whiteStones.push_back( go::stone(stone->x, stone->y, go::white) );
-        ++stone;
-    }
+            stoneList::const_iterator stone = first->stones.begin();
+            while (stone != first->stones.end()){
+                if (stone->color == go::empty)
+                    node->editEmptyStones().push_back( go::stone(stone->x, stone->y, go::empty) );
+                else if (stone->color == go::black)
+                    node->editBlackStones().push_back( go::stone(stone->x, stone->y, go::black) );
+                else if (stone->color == go::white)
+                    node->editWhiteStones().push_back( go::stone(stone->x, stone->y, go::white) );
+                ++stone;
+            }
+
+            parent->childNodes().push_back(node);
 
-    parent->childNodes.push_back(node);
+            for (int i=first->branches.size()-1; i>=0; --i)
+                branches.push_back( qMakePair(node, &first->branches[i]) );
 
-    get(first+1, last, node);
+            parent = node;
+        }
+
+        if (branches.empty())
+            break;
 
-    branchList::const_iterator b_first = first->branches.begin();
-    branchList::const_iterator b_last  = first->branches.end();
-    while (b_first != b_last){
-        get(b_first->begin(), b_first->end(), node);
-        ++b_first;
+        parent = branches.back().first;
+        first  = branches.back().second->begin();
+        last   = branches.back().second->end();
+        branches.pop_back();
     }
 
     return true;
@@ -70,22 +70,23 @@ public:
     typedef data::branchList branchList;
 
 
-    virtual bool readStream(QString::iterator& first, QString::iterator last);
+    virtual bool readText(textReader& reader);
     virtual bool saveStream(QTextStream& stream);
     virtual QTextCodec* getCodec(const QByteArray&) const;
+    static int probe(const QByteArray& head);
 
     virtual bool get(go::data& data) const;
     virtual bool set(const go::data& data);
 
 private:
-    bool    readHeader(QString::iterator& first, QString::iterator& last);
-    bool    readRemote(QString::iterator& first, QString::iterator& last);
-    bool    readFiles(QString::iterator& first, QString::iterator& last);
-    bool    readData(QString::iterator& first, QString::iterator& last);
-    bool    readFigure(QString::iterator& first, QString::iterator& last);
-    bool    readComment(QString::iterator& first, QString::iterator& last);
-    bool    readFig(QString::iterator& first, QString::iterator& last, int index);
-    bool    readText(QString::iterator& first, QString::iterator& last, int index);
+    bool    readHeader(textReader& reader);
+    bool    readRemote(textReader& reader);
+    bool    readFiles(textReader& reader);
+    bool    readData(textReader& reader);
+    bool    readFigure(textReader& reader);
+    bool    readComment(textReader& reader);
+    bool    readFig(textReader& reader, int index);
+    bool    readText(textReader& reader, int index);
     void    replaceStone(stoneList& stones, const data& d);
 
     bool get(dataList::const_iterator first, dataList::const_iterator last, go::nodePtr parent) const;